@@ -0,0 +1,93 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace ComLight.IO
+{
+	/// <summary>Type of the array elements, must match eElementType in arrays.h</summary>
+	/// <remarks>Struct for everything else than numbers: only the size is validated for these.</remarks>
+	public enum eElementType: byte
+	{
+		/// <summary>Structures, booleans, and anything else</summary>
+		Struct = 0,
+		/// <summary>sbyte</summary>
+		Int8 = 1,
+		/// <summary>byte</summary>
+		UInt8 = 2,
+		/// <summary>short</summary>
+		Int16 = 3,
+		/// <summary>ushort or char</summary>
+		UInt16 = 4,
+		/// <summary>int</summary>
+		Int32 = 5,
+		/// <summary>uint</summary>
+		UInt32 = 6,
+		/// <summary>long</summary>
+		Int64 = 7,
+		/// <summary>ulong</summary>
+		UInt64 = 8,
+		/// <summary>float</summary>
+		Float32 = 9,
+		/// <summary>double</summary>
+		Float64 = 10,
+	}
+
+	/// <summary>Who keeps the memory of the array alive</summary>
+	public enum eArrayOwnership: byte
+	{
+		/// <summary>The memory is only valid during the call, e.g. a pinned .NET array</summary>
+		Borrowed = 0,
+		/// <summary>The memory is kept alive by the owner object. The callee can AddRef the owner to keep using the elements after the call returns.</summary>
+		Owned = 1,
+	}
+
+	/// <summary>One-dimensional array, the ABI of ArraySpan and StridedSpan in arrays.h</summary>
+	/// <remarks>Pass these to C++ as <c>[In] ref ArrayDescriptor</c>, for <c>const ArraySpan&lt;T&gt;&amp;</c> parameters. Use <see cref="ArrayMarshal" /> to create them.</remarks>
+	[StructLayout( LayoutKind.Sequential )]
+	public struct ArrayDescriptor
+	{
+		/// <summary>Address of the first element</summary>
+		public IntPtr data;
+		/// <summary>IUnknown pointer of the object which owns the memory, or null for borrowed arrays</summary>
+		public IntPtr owner;
+		/// <summary>Count of elements</summary>
+		public long length;
+		/// <summary>Distance between elements in bytes: equal to the element size when contiguous, it can be larger or negative.</summary>
+		public long stride;
+		/// <summary>Size of one element in bytes</summary>
+		public uint elementSize;
+		/// <summary>Type of the elements</summary>
+		public eElementType elementType;
+		/// <summary>Borrowed or owned</summary>
+		public eArrayOwnership ownership;
+		/// <summary>Must be 0</summary>
+		public ushort reserved;
+	}
+
+	/// <summary>Multi-dimensional array up to 4 dimensions, the ABI of NdSpan in arrays.h</summary>
+	/// <remarks>The strides are in bytes, the unused dimensions have size 1 and stride 0. The first index is the outermost one.</remarks>
+	[StructLayout( LayoutKind.Sequential )]
+	public unsafe struct NdArrayDescriptor
+	{
+		/// <summary>Maximum count of dimensions</summary>
+		public const int maxDimensions = 4;
+
+		/// <summary>Address of the first element</summary>
+		public IntPtr data;
+		/// <summary>IUnknown pointer of the object which owns the memory, or null for borrowed arrays</summary>
+		public IntPtr owner;
+		/// <summary>Size of one element in bytes</summary>
+		public uint elementSize;
+		/// <summary>Type of the elements</summary>
+		public eElementType elementType;
+		/// <summary>Borrowed or owned</summary>
+		public eArrayOwnership ownership;
+		/// <summary>Count of dimensions, from 0 to 4</summary>
+		public byte dimensions;
+		/// <summary>Must be 0</summary>
+		public byte reserved;
+		/// <summary>Count of elements in every dimension</summary>
+		public fixed long shape[ maxDimensions ];
+		/// <summary>Distance in bytes between adjacent elements in every dimension</summary>
+		public fixed long strides[ maxDimensions ];
+	}
+}
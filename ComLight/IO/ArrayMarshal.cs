@@ -0,0 +1,152 @@
+﻿using System;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+
+namespace ComLight.IO
+{
+	/// <summary>Array pinned for the duration of a native call, dispose to unpin</summary>
+	public sealed class PinnedArray: IDisposable
+	{
+		GCHandle handle;
+		/// <summary>Borrowed descriptor of the complete array</summary>
+		public readonly ArrayDescriptor descriptor;
+
+		internal PinnedArray( GCHandle handle, ArrayDescriptor descriptor )
+		{
+			this.handle = handle;
+			this.descriptor = descriptor;
+		}
+
+		/// <summary>Unpin the array. Native code must not use the descriptor after that.</summary>
+		public void Dispose()
+		{
+			if( handle.IsAllocated )
+				handle.Free();
+		}
+	}
+
+	/// <summary>Create array descriptors for the C++ methods which take ArraySpan, StridedSpan or NdSpan, and access the elements of the descriptors received from C++.</summary>
+	/// <remarks>The descriptors only point to the memory, they don't copy the elements.</remarks>
+	public static class ArrayMarshal
+	{
+		/// <summary>Element type code for the C# type, same values as elementTypeOf&lt;T&gt; in arrays.h</summary>
+		public static eElementType elementType<T>() where T : unmanaged
+		{
+			Type t = typeof( T );
+			if( t == typeof( float ) ) return eElementType.Float32;
+			if( t == typeof( double ) ) return eElementType.Float64;
+			if( t == typeof( sbyte ) ) return eElementType.Int8;
+			if( t == typeof( byte ) ) return eElementType.UInt8;
+			if( t == typeof( short ) ) return eElementType.Int16;
+			if( t == typeof( ushort ) || t == typeof( char ) ) return eElementType.UInt16;
+			if( t == typeof( int ) ) return eElementType.Int32;
+			if( t == typeof( uint ) ) return eElementType.UInt32;
+			if( t == typeof( long ) ) return eElementType.Int64;
+			if( t == typeof( ulong ) ) return eElementType.UInt64;
+			if( t == typeof( IntPtr ) ) return IntPtr.Size == 8 ? eElementType.Int64 : eElementType.Int32;
+			if( t == typeof( UIntPtr ) ) return IntPtr.Size == 8 ? eElementType.UInt64 : eElementType.UInt32;
+			return eElementType.Struct;
+		}
+
+		/// <summary>Borrowed descriptor of memory which doesn't move, e.g. stackalloc, native memory, or a span the caller has pinned with the <c>fixed</c> statement.</summary>
+		public static unsafe ArrayDescriptor borrow<T>( Span<T> span ) where T : unmanaged
+		{
+			ArrayDescriptor ad = new ArrayDescriptor();
+			ad.data = (IntPtr)Unsafe.AsPointer( ref MemoryMarshal.GetReference( span ) );
+			ad.length = span.Length;
+			ad.stride = sizeof( T );
+			ad.elementSize = (uint)sizeof( T );
+			ad.elementType = elementType<T>();
+			ad.ownership = eArrayOwnership.Borrowed;
+			return ad;
+		}
+
+		/// <summary>Borrowed descriptor of a dense multi-dimensional array in row-major order, i.e. the last index is contiguous.</summary>
+		/// <remarks>Same requirement as for <see cref="borrow{T}(Span{T})" />, the memory must not move.</remarks>
+		public static unsafe NdArrayDescriptor borrow<T>( Span<T> span, params long[] shape ) where T : unmanaged
+		{
+			if( shape.Length > NdArrayDescriptor.maxDimensions )
+				throw new ArgumentOutOfRangeException( nameof( shape ), $"Arrays can have up to { NdArrayDescriptor.maxDimensions } dimensions" );
+			long count = 1;
+			foreach( long s in shape )
+			{
+				if( s < 0 )
+					throw new ArgumentOutOfRangeException( nameof( shape ) );
+				count *= s;
+			}
+			if( count != span.Length )
+				throw new ArgumentException( "The shape doesn't match the length of the span" );
+
+			NdArrayDescriptor nd = new NdArrayDescriptor();
+			nd.data = (IntPtr)Unsafe.AsPointer( ref MemoryMarshal.GetReference( span ) );
+			nd.elementSize = (uint)sizeof( T );
+			nd.elementType = elementType<T>();
+			nd.ownership = eArrayOwnership.Borrowed;
+			nd.dimensions = (byte)shape.Length;
+			long stride = sizeof( T );
+			for( int i = NdArrayDescriptor.maxDimensions - 1; i >= 0; i-- )
+			{
+				if( i >= shape.Length )
+				{
+					nd.shape[ i ] = 1;
+					nd.strides[ i ] = 0;
+					continue;
+				}
+				nd.shape[ i ] = shape[ i ];
+				nd.strides[ i ] = stride;
+				stride *= shape[ i ];
+			}
+			return nd;
+		}
+
+		/// <summary>Pin the array, and create a borrowed descriptor of it. Dispose the result after the native call.</summary>
+		public static PinnedArray pin<T>( T[] array ) where T : unmanaged
+		{
+			GCHandle handle = GCHandle.Alloc( array, GCHandleType.Pinned );
+			ArrayDescriptor ad = borrow<T>( array );
+			// Empty arrays have no elements to point to
+			ad.data = ( array.Length > 0 ) ? handle.AddrOfPinnedObject() : IntPtr.Zero;
+			return new PinnedArray( handle, ad );
+		}
+
+		/// <summary>Access the elements of a contiguous array received from C++. The span is only valid while the memory is, i.e. during the call for borrowed arrays.</summary>
+		/// <exception cref="ArgumentException">The descriptor is not a contiguous array of T</exception>
+		public static unsafe Span<T> span<T>( in ArrayDescriptor ad ) where T : unmanaged
+		{
+			if( ad.elementSize != sizeof( T ) || ad.elementType != elementType<T>() )
+				throw new ArgumentException( $"The array doesn't contain { typeof( T ).Name } elements" );
+			if( ad.length < 0 || ad.length > int.MaxValue || ad.stride != sizeof( T ) )
+				throw new ArgumentException( "The array is not contiguous, or too large for a span" );
+			if( IntPtr.Zero == ad.data && 0 != ad.length )
+				throw new ArgumentNullException( nameof( ad ) );
+			return new Span<T>( (void*)ad.data, (int)ad.length );
+		}
+
+		/// <summary>Access the elements of a dense multi-dimensional array received from C++, flattened in row-major order.</summary>
+		/// <exception cref="ArgumentException">The descriptor is not a dense array of T</exception>
+		public static unsafe Span<T> span<T>( in NdArrayDescriptor nd ) where T : unmanaged
+		{
+			if( nd.elementSize != sizeof( T ) || nd.elementType != elementType<T>() )
+				throw new ArgumentException( $"The array doesn't contain { typeof( T ).Name } elements" );
+			if( nd.dimensions > NdArrayDescriptor.maxDimensions )
+				throw new ArgumentException( "Too many dimensions" );
+			long count = 1;
+			long stride = sizeof( T );
+			for( int i = nd.dimensions - 1; i >= 0; i-- )
+			{
+				long s = nd.shape[ i ];
+				if( s < 0 )
+					throw new ArgumentException( "Negative size" );
+				if( s > 1 && nd.strides[ i ] != stride )
+					throw new ArgumentException( "The array is not dense" );
+				stride *= s;
+				count *= s;
+			}
+			if( count > int.MaxValue )
+				throw new ArgumentException( "The array is too large for a span" );
+			if( IntPtr.Zero == nd.data && 0 != count )
+				throw new ArgumentNullException( nameof( nd ) );
+			return new Span<T>( (void*)nd.data, (int)count );
+		}
+	}
+}
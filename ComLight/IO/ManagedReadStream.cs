@@ -1,18 +1,25 @@
 ﻿using System;
+using System.Buffers;
 using System.IO;
 
 namespace ComLight.IO
 {
 	/// <summary>Implement .NET readonly stream on top of native iReadStream</summary>
+	/// <remarks>When the native stream implements iReadStreamBatch, <see cref="StreamBatch.read" /> fills all the buffers with a single native call.</remarks>
 	class ManagedReadStream: Stream
 	{
 		readonly IntPtr com;
 		readonly iReadStream native;
+		/// <summary>Null when the native stream doesn't support batched reads</summary>
+		readonly iReadStreamBatch batch;
 
-		ManagedReadStream( IntPtr com, iReadStream native )
+		internal bool isBatched => null != batch;
+
+		ManagedReadStream( IntPtr com, iReadStream native, iReadStreamBatch batch )
 		{
 			this.com = com;
 			this.native = native;
+			this.batch = batch;
 		}
 		~ManagedReadStream()
 		{
@@ -77,10 +84,42 @@ namespace ComLight.IO
 			throw new NotSupportedException();
 		}
 
+		/// <summary>Read into all the buffers with a single call of iReadStreamBatch. Returns false when the native stream doesn't implement that interface.</summary>
+		internal unsafe bool tryReadBatch( Memory<byte>[] buffers, out long bytesRead )
+		{
+			bytesRead = 0;
+			if( null == batch )
+				return false;
+			ReadBuffer[] descriptors = new ReadBuffer[ buffers.Length ];
+			MemoryHandle[] pins = new MemoryHandle[ buffers.Length ];
+			try
+			{
+				for( int i = 0; i < buffers.Length; i++ )
+				{
+					pins[ i ] = buffers[ i ].Pin();
+					descriptors[ i ].data = (IntPtr)pins[ i ].Pointer;
+					descriptors[ i ].length = buffers[ i ].Length;
+				}
+				batch.readBatch( descriptors, descriptors.Length, out bytesRead );
+			}
+			finally
+			{
+				foreach( MemoryHandle mh in pins )
+					mh.Dispose();
+			}
+			return true;
+		}
+
+		static readonly Guid batchIid = typeof( iReadStreamBatch ).getComInterfaceId();
+
 		static ManagedReadStream factory( IntPtr nativeComPointer )
 		{
 			iReadStream irs = NativeWrapper.wrap<iReadStream>( nativeComPointer );
-			return new ManagedReadStream( nativeComPointer, irs );
+			// The native stream may support batched reads, query once per wrapper
+			iReadStreamBatch batch = irs as iReadStreamBatch;
+			if( null == batch && irs is RuntimeClass rc )
+				batch = NativeWrapper.wrap<iReadStreamBatch>( rc.tryQueryInterface( batchIid ) );
+			return new ManagedReadStream( nativeComPointer, irs, batch );
 		}
 		static readonly NativeWrapperCache<ManagedReadStream> cache = new NativeWrapperCache<ManagedReadStream>( factory );
 
@@ -1,18 +1,25 @@
 ﻿using System;
+using System.Buffers;
 using System.IO;
 
 namespace ComLight.IO
 {
 	/// <summary>Implement .NET write only stream on top of native iWriteStream</summary>
+	/// <remarks>When the native stream implements iWriteStreamBatch, <see cref="StreamBatch.write" /> writes all the buffers with a single native call.</remarks>
 	class ManagedWriteStream: Stream
 	{
 		readonly IntPtr com;
 		readonly iWriteStream native;
+		/// <summary>Null when the native stream doesn't support batched writes</summary>
+		readonly iWriteStreamBatch batch;
 
-		ManagedWriteStream( IntPtr com, iWriteStream native )
+		internal bool isBatched => null != batch;
+
+		ManagedWriteStream( IntPtr com, iWriteStream native, iWriteStreamBatch batch )
 		{
 			this.com = com;
 			this.native = native;
+			this.batch = batch;
 		}
 		~ManagedWriteStream()
 		{
@@ -58,10 +65,41 @@ namespace ComLight.IO
 			native.write( ref span.GetPinnableReference(), count );
 		}
 
+		/// <summary>Write all the buffers with a single call of iWriteStreamBatch. Returns false when the native stream doesn't implement that interface.</summary>
+		internal unsafe bool tryWriteBatch( ReadOnlyMemory<byte>[] buffers )
+		{
+			if( null == batch )
+				return false;
+			WriteBuffer[] descriptors = new WriteBuffer[ buffers.Length ];
+			MemoryHandle[] pins = new MemoryHandle[ buffers.Length ];
+			try
+			{
+				for( int i = 0; i < buffers.Length; i++ )
+				{
+					pins[ i ] = buffers[ i ].Pin();
+					descriptors[ i ].data = (IntPtr)pins[ i ].Pointer;
+					descriptors[ i ].length = buffers[ i ].Length;
+				}
+				batch.writeBatch( descriptors, descriptors.Length );
+			}
+			finally
+			{
+				foreach( MemoryHandle mh in pins )
+					mh.Dispose();
+			}
+			return true;
+		}
+
+		static readonly Guid batchIid = typeof( iWriteStreamBatch ).getComInterfaceId();
+
 		static ManagedWriteStream factory( IntPtr nativeComPointer )
 		{
 			iWriteStream iws = NativeWrapper.wrap<iWriteStream>( nativeComPointer );
-			return new ManagedWriteStream( nativeComPointer, iws );
+			// The native stream may support batched writes, query once per wrapper
+			iWriteStreamBatch batch = iws as iWriteStreamBatch;
+			if( null == batch && iws is RuntimeClass rc )
+				batch = NativeWrapper.wrap<iWriteStreamBatch>( rc.tryQueryInterface( batchIid ) );
+			return new ManagedWriteStream( nativeComPointer, iws, batch );
 		}
 		static readonly NativeWrapperCache<ManagedWriteStream> cache = new NativeWrapperCache<ManagedWriteStream>( factory );
 
@@ -6,7 +6,8 @@ using System.Runtime.InteropServices;
 namespace ComLight.IO
 {
 	/// <summary>Wraps .NET stream into native iReadStream</summary>
-	class NativeReadStream: iReadStream, IDisposable, iComDisposable
+	/// <remarks>Also implements iReadStreamBatch, C++ code can fill many buffers with a single call across the interop.</remarks>
+	class NativeReadStream: iReadStreamBatch, IDisposable, iComDisposable
 	{
 		readonly Stream stream;
 
@@ -15,7 +16,7 @@ namespace ComLight.IO
 			this.stream = stream;
 		}
 
-		void iReadStream.getLength( out long length )
+		public void getLength( out long length )
 		{
 			length = stream.Length;
 		}
@@ -23,7 +24,7 @@ namespace ComLight.IO
 #if !NETCOREAPP
 		unsafe
 #endif
-		void iReadStream.read( ref byte lpBuffer, int nNumberOfBytesToRead, out int lpNumberOfBytesRead )
+		public void read( ref byte lpBuffer, int nNumberOfBytesToRead, out int lpNumberOfBytesRead )
 		{
 #if NETCOREAPP
 			var span = MemoryMarshal.CreateSpan( ref lpBuffer, nNumberOfBytesToRead );
@@ -33,11 +34,30 @@ namespace ComLight.IO
 			lpNumberOfBytesRead = stream.Read( span );
 		}
 
-		void iReadStream.seek( long offset, eSeekOrigin origin )
+		public void seek( long offset, eSeekOrigin origin )
 		{
 			stream.Seek( offset, (SeekOrigin)(byte)origin );
 		}
 
+		public unsafe void readBatch( ReadBuffer[] buffers, int count, out long bytesRead )
+		{
+			bytesRead = 0;
+			for( int i = 0; i < count; i++ )
+			{
+				byte* pb = (byte*)buffers[ i ].data;
+				long remaining = buffers[ i ].length;
+				while( remaining > 0 )
+				{
+					int cb = stream.Read( new Span<byte>( pb, (int)Math.Min( remaining, int.MaxValue ) ) );
+					if( cb <= 0 )
+						return;
+					bytesRead += cb;
+					pb += cb;
+					remaining -= cb;
+				}
+			}
+		}
+
 		private bool disposedValue = false; // To detect redundant calls
 
 		protected virtual void Dispose( bool disposing )
@@ -59,7 +79,7 @@ namespace ComLight.IO
 			Dispose( true );
 		}
 
-		void iReadStream.getPosition( out long length )
+		public void getPosition( out long length )
 		{
 			length = stream.Position;
 		}
@@ -67,7 +87,7 @@ namespace ComLight.IO
 		static ManagedWrapperCache<Stream, NativeReadStream>.Entry factory( Stream managed, bool addRef )
 		{
 			NativeReadStream wrapper = new NativeReadStream( managed );
-			IntPtr native = ManagedWrapper.wrap<iReadStream>( wrapper, addRef );
+			IntPtr native = ManagedWrapper.wrap<iReadStreamBatch>( wrapper, addRef );
 			return new ManagedWrapperCache<Stream, NativeReadStream>.Entry( native, wrapper );
 		}
 		static readonly ManagedWrapperCache<Stream, NativeReadStream> cache = new ManagedWrapperCache<Stream, NativeReadStream>( factory );
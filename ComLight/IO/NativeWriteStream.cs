@@ -6,7 +6,8 @@ using System.Runtime.InteropServices;
 namespace ComLight.IO
 {
 	/// <summary>Wraps .NET stream into native iWriteStream</summary>
-	class NativeWriteStream: iWriteStream, iComDisposable
+	/// <remarks>Also implements iWriteStreamBatch, C++ code can write many buffers with a single call across the interop.</remarks>
+	class NativeWriteStream: iWriteStreamBatch, iComDisposable
 	{
 		readonly Stream stream;
 
@@ -15,7 +16,7 @@ namespace ComLight.IO
 			this.stream = stream;
 		}
 
-		void iWriteStream.flush()
+		public void flush()
 		{
 			stream.Flush();
 		}
@@ -28,7 +29,7 @@ namespace ComLight.IO
 #if !NETCOREAPP
 		unsafe
 #endif
-		void iWriteStream.write( ref byte lpBuffer, int nNumberOfBytesToWrite )
+		public void write( ref byte lpBuffer, int nNumberOfBytesToWrite )
 		{
 #if NETCOREAPP
 			var span = MemoryMarshal.CreateReadOnlySpan( ref lpBuffer, nNumberOfBytesToWrite );
@@ -38,10 +39,26 @@ namespace ComLight.IO
 			stream.Write( span );
 		}
 
+		public unsafe void writeBatch( WriteBuffer[] buffers, int count )
+		{
+			for( int i = 0; i < count; i++ )
+			{
+				byte* pb = (byte*)buffers[ i ].data;
+				long remaining = buffers[ i ].length;
+				while( remaining > 0 )
+				{
+					int cb = (int)Math.Min( remaining, int.MaxValue );
+					stream.Write( new ReadOnlySpan<byte>( pb, cb ) );
+					pb += cb;
+					remaining -= cb;
+				}
+			}
+		}
+
 		static ManagedWrapperCache<Stream, NativeWriteStream>.Entry factory( Stream managed, bool addRef )
 		{
 			NativeWriteStream wrapper = new NativeWriteStream( managed );
-			IntPtr native = ManagedWrapper.wrap<iWriteStream>( wrapper, addRef );
+			IntPtr native = ManagedWrapper.wrap<iWriteStreamBatch>( wrapper, addRef );
 			return new ManagedWrapperCache<Stream, NativeWriteStream>.Entry( native, wrapper );
 		}
 		static readonly ManagedWrapperCache<Stream, NativeWriteStream> cache = new ManagedWrapperCache<Stream, NativeWriteStream>( factory );
@@ -0,0 +1,53 @@
+﻿using System;
+using System.IO;
+
+namespace ComLight.IO
+{
+	/// <summary>Scatter reads and gather writes for streams, with a single native call when the stream is a native one which implements iReadStreamBatch or iWriteStreamBatch.</summary>
+	/// <remarks>Other streams, including those implemented in .NET, fall back to one Read or Write call per buffer.</remarks>
+	public static class StreamBatch
+	{
+		/// <summary>True if the stream was marshaled from C++, and supports batched reads</summary>
+		public static bool isReadBatched( Stream stream )
+		{
+			return stream is ManagedReadStream mrs && mrs.isBatched;
+		}
+
+		/// <summary>True if the stream was marshaled from C++, and supports batched writes</summary>
+		public static bool isWriteBatched( Stream stream )
+		{
+			return stream is ManagedWriteStream mws && mws.isBatched;
+		}
+
+		/// <summary>Fill the buffers in order, return the count of bytes read. Only reads less than the total length of the buffers when the stream has ended.</summary>
+		public static long read( Stream stream, params Memory<byte>[] buffers )
+		{
+			if( stream is ManagedReadStream mrs && mrs.tryReadBatch( buffers, out long cbBatch ) )
+				return cbBatch;
+
+			long result = 0;
+			foreach( Memory<byte> mem in buffers )
+			{
+				Span<byte> span = mem.Span;
+				while( !span.IsEmpty )
+				{
+					int cb = stream.Read( span );
+					if( cb <= 0 )
+						return result;
+					result += cb;
+					span = span.Slice( cb );
+				}
+			}
+			return result;
+		}
+
+		/// <summary>Write all the buffers, in order.</summary>
+		public static void write( Stream stream, params ReadOnlyMemory<byte>[] buffers )
+		{
+			if( stream is ManagedWriteStream mws && mws.tryWriteBatch( buffers ) )
+				return;
+			foreach( ReadOnlyMemory<byte> mem in buffers )
+				stream.Write( mem.Span );
+		}
+	}
+}
@@ -0,0 +1,16 @@
+﻿using System;
+
+namespace ComLight.IO
+{
+	/// <summary>Block of memory owned by a COM object, to share large data across the interop without copying.</summary>
+	/// <remarks>Whoever holds a reference can access the memory, the pointer and the length never change. Producers and consumers on both sides of the interop pass these, transferring megabytes of data with only reference counting.</remarks>
+	[ComInterface( "b5e1d7a3-2c4f-4a96-8e0b-7f3d9c1a6e58" )]
+	public interface iBuffer: IDisposable
+	{
+		/// <summary>Get the address and the length in bytes of the memory.</summary>
+		void getData( out IntPtr data, out long length );
+		/// <summary>Create a buffer for a range of this one. The slice keeps the memory alive, the caller can dispose this buffer.</summary>
+		/// <remarks>Fails with E_BOUNDS when the range is outside of this buffer.</remarks>
+		void slice( long offset, long length, out iBuffer result );
+	}
+}
@@ -0,0 +1,33 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace ComLight.IO
+{
+	/// <summary>Buffer descriptor for scatter reads</summary>
+	[StructLayout( LayoutKind.Sequential )]
+	public struct ReadBuffer
+	{
+		/// <summary>Address of the memory, must stay valid during the call</summary>
+		public IntPtr data;
+		/// <summary>Length in bytes</summary>
+		public long length;
+	}
+
+	/// <summary>Readonly stream which can read into multiple buffers with a single call, similar to readv() in POSIX.</summary>
+	/// <remarks>The methods of the base interface are repeated, this defines the layout of the vtable.</remarks>
+	[ComInterface( "a3a42cd4-4d51-4f0e-b0a5-7d1bb2bf2f5d" )]
+	public interface iReadStreamBatch: iReadStream
+	{
+		/// <summary>Read a sequence of bytes from the current stream and advances the position within the stream by the number of bytes read.</summary>
+		new void read( ref byte lpBuffer, int nNumberOfBytesToRead, out int lpNumberOfBytesRead );
+		/// <summary>Set the position within the current stream.</summary>
+		new void seek( long offset, eSeekOrigin origin );
+		/// <summary>Get the position within the current stream.</summary>
+		new void getPosition( out long length );
+		/// <summary>Get the length in bytes of the stream.</summary>
+		new void getLength( out long length );
+
+		/// <summary>Fill the buffers in order. Only stops before the end of the last buffer when the stream has ended.</summary>
+		void readBatch( [In, MarshalAs( UnmanagedType.LPArray, SizeParamIndex = 1 )] ReadBuffer[] buffers, int count, out long bytesRead );
+	}
+}
@@ -0,0 +1,29 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace ComLight.IO
+{
+	/// <summary>Buffer descriptor for gather writes</summary>
+	[StructLayout( LayoutKind.Sequential )]
+	public struct WriteBuffer
+	{
+		/// <summary>Address of the memory, must stay valid during the call</summary>
+		public IntPtr data;
+		/// <summary>Length in bytes</summary>
+		public long length;
+	}
+
+	/// <summary>Write stream which can write multiple buffers with a single call, similar to writev() in POSIX.</summary>
+	/// <remarks>The methods of the base interface are repeated, this defines the layout of the vtable.</remarks>
+	[ComInterface( "5e0c8f6a-2f7e-4c43-9b8e-63c1a1e4f0b7" )]
+	public interface iWriteStreamBatch: iWriteStream
+	{
+		/// <summary>write a sequence of bytes to the current stream and advance the current position within this stream by the number of bytes written.</summary>
+		new void write( [In] ref byte lpBuffer, int nNumberOfBytesToWrite );
+		/// <summary>Clear all buffers for this stream and causes any buffered data to be written to the underlying device.</summary>
+		new void flush();
+
+		/// <summary>Write all the buffers, in order.</summary>
+		void writeBatch( [In, MarshalAs( UnmanagedType.LPArray, SizeParamIndex = 1 )] WriteBuffer[] buffers, int count );
+	}
+}
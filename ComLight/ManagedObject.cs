@@ -27,12 +27,15 @@ namespace ComLight
 		readonly IUnknown.Release release;
 
 		readonly Guid iid;
+		/// <summary>IIDs of the base COM interfaces, implemented by the same vtable</summary>
+		readonly Guid[] baseIids;
 		readonly Delegate[] delegates;
 
-		public ManagedObject( object managed, Guid iid, Delegate[] delegates )
+		public ManagedObject( object managed, Guid iid, Guid[] baseIids, Delegate[] delegates )
 		{
 			this.managed = managed;
 			this.iid = iid;
+			this.baseIids = baseIids;
 
 			IntPtr[] nativeTable = new IntPtr[ delegates.Length + 4 ];
 			gchNativeData = GCHandle.Alloc( nativeTable, GCHandleType.Pinned );
@@ -63,10 +66,10 @@ namespace ComLight
 
 		int implQueryInterface( [In] ref Guid ii, out IntPtr result )
 		{
-			if( ii == iid || ii == IUnknown.iid )
+			if( ii == iid || ii == IUnknown.iid || Array.IndexOf( baseIids, ii ) >= 0 )
 			{
-				// From native code point of view, this COM object only supports 2 COM interfaces: IUnknown, and the one with the IID that was passed to the constructor.
-				// In both cases, besides just returning the native pointer, we need to increment the ref.counter.
+				// From native code point of view, this COM object only supports IUnknown, the one with the IID that was passed to the constructor, and the base interfaces of that one.
+				// In all cases, besides just returning the native pointer, we need to increment the ref.counter.
 				result = address;
 				implAddRef();
 				return IUnknown.S_OK;
@@ -37,6 +37,7 @@ namespace ComLight
 			// The builder gets captured by the lambda.
 			// This is what we want, the constructor takes noticeable time, the code outside the lambda runs once per interface type, the code inside lambda runs once per object instance.
 			InterfaceBuilder builder = new InterfaceBuilder( typeof( I ) );
+			Guid[] baseIids = typeof( I ).getBaseInterfaceIds();
 
 			return ( object obj, bool addRef ) =>
 			{
@@ -69,7 +70,7 @@ namespace ComLight
 					return wrapped.Value;
 
 				Delegate[] delegates = builder.compile( managed );
-				ManagedObject wrapper = new ManagedObject( managed, iid, delegates );
+				ManagedObject wrapper = new ManagedObject( managed, iid, baseIids, delegates );
 				WrappersCache<I>.add( managed, wrapper );
 				if( addRef )
 					wrapper.callAddRef();
@@ -83,6 +84,7 @@ namespace ComLight
 			// The builder gets captured by the lambda.
 			// This is what we want, the constructor takes noticeable time, the code outside the lambda runs once per interface type, the code inside lambda runs once per object instance.
 			InterfaceBuilder builder = new InterfaceBuilder( typeof( I ) );
+			Guid[] baseIids = typeof( I ).getBaseInterfaceIds();
 
 			return ( object obj, bool addRef ) =>
 			{
@@ -100,7 +102,7 @@ namespace ComLight
 					return wrapped.Value;
 
 				Delegate[] delegates = builder.compile( managed );
-				ManagedObject wrapper = new ManagedObject( managed, iid, delegates );
+				ManagedObject wrapper = new ManagedObject( managed, iid, baseIids, delegates );
 				WrappersCache<I>.add( managed, wrapper );
 				if( addRef )
 					wrapper.callAddRef();
@@ -79,6 +79,13 @@ namespace ComLight
 			return result;
 		}
 
+		/// <summary>Query another interface, return IntPtr.Zero when the object doesn't implement it. On success, the caller owns a reference to the result.</summary>
+		internal IntPtr tryQueryInterface( Guid iid )
+		{
+			int hr = QueryInterface( m_nativePointer, ref iid, out IntPtr result );
+			return ( hr >= 0 ) ? result : IntPtr.Zero;
+		}
+
 		internal void addRef()
 		{
 			AddRef( m_nativePointer );
@@ -48,6 +48,26 @@ namespace ComLight
 			return attribute.iid;
 		}
 
+		/// <summary>IID of the COM interface, from the [ComInterface] attribute</summary>
+		public static Guid getComInterfaceId( this Type tp )
+		{
+			ComInterfaceAttribute attribute = tp.GetCustomAttribute<ComInterfaceAttribute>();
+			if( null == attribute )
+				throw new ArgumentException( $"COM interface { tp.FullName } doesn't have [ComInterface] attribute applied" );
+			return attribute.iid;
+		}
+
+		/// <summary>IIDs of the COM interfaces the interface derives from.</summary>
+		/// <remarks>Derived COM interfaces repeat the methods of the base ones at the start, the same vtable implements the base interfaces.</remarks>
+		public static Guid[] getBaseInterfaceIds( this Type tp )
+		{
+			return tp.GetInterfaces()
+				.Select( i => i.GetCustomAttribute<ComInterfaceAttribute>() )
+				.Where( a => null != a )
+				.Select( a => a.iid )
+				.ToArray();
+		}
+
 		/// <summary>true if the type inherits from System.Delegate</summary>
 		public static bool isDelegate( this Type tp )
 		{
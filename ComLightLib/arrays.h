@@ -0,0 +1,312 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <initializer_list>
+#include <algorithm>
+#include <type_traits>
+#include "comLightCommon.h"
+#include "client/CComPtr.hpp"
+
+// Descriptors of arrays, to pass bulk data to interface methods with a single call and without per-element marshalling.
+// The descriptors are plain structures with a fixed layout, pass them by const reference. They describe the memory, they don't copy the elements.
+namespace ComLight
+{
+	// Type of the array elements. Struct for everything else than numbers: only the size is validated for these.
+	enum struct eElementType : uint8_t
+	{
+		Struct = 0,
+		Int8 = 1,
+		UInt8 = 2,
+		Int16 = 3,
+		UInt16 = 4,
+		Int32 = 5,
+		UInt32 = 6,
+		Int64 = 7,
+		UInt64 = 8,
+		Float32 = 9,
+		Float64 = 10,
+	};
+
+	enum struct eArrayOwnership : uint8_t
+	{
+		// The memory is only valid during the call, e.g. a pinned .NET array or a local vector of the caller
+		Borrowed = 0,
+		// The memory is kept alive by the owner object. The callee can AddRef the owner to keep using the elements after the call returns.
+		Owned = 1,
+	};
+
+	// One-dimensional array. The stride is the distance between elements in bytes: equal to the element size when contiguous, it can be larger or negative.
+	struct ArrayDescriptor
+	{
+		void* data;
+		IUnknown* owner;
+		int64_t length;
+		int64_t stride;
+		uint32_t elementSize;
+		eElementType elementType;
+		eArrayOwnership ownership;
+		uint16_t reserved;
+	};
+
+	constexpr int maxArrayDimensions = 4;
+	// Set by NdSpan constructors when the shape has more dimensions than supported, validate() fails for these descriptors
+	constexpr uint8_t invalidArrayDimensions = 0xFF;
+
+	// Multi-dimensional array, up to 4 dimensions. The strides are in bytes, the unused dimensions have size 1 and stride 0.
+	struct NdArrayDescriptor
+	{
+		void* data;
+		IUnknown* owner;
+		uint32_t elementSize;
+		eElementType elementType;
+		eArrayOwnership ownership;
+		uint8_t dimensions;
+		uint8_t reserved;
+		int64_t shape[ maxArrayDimensions ];
+		int64_t strides[ maxArrayDimensions ];
+	};
+
+	namespace details
+	{
+		template<class T>
+		constexpr eElementType elementTypeOf()
+		{
+			using E = typename std::remove_cv<T>::type;
+			if( std::is_floating_point<E>::value )
+				return 4 == sizeof( E ) ? eElementType::Float32 : ( 8 == sizeof( E ) ? eElementType::Float64 : eElementType::Struct );
+			if( !std::is_integral<E>::value || std::is_same<E, bool>::value )
+				return eElementType::Struct;
+			// Signed integers have odd codes, the unsigned ones are next to them
+			const uint8_t offset = std::is_signed<E>::value ? 0 : 1;
+			switch( sizeof( E ) )
+			{
+			case 1: return (eElementType)( 1 + offset );
+			case 2: return (eElementType)( 3 + offset );
+			case 4: return (eElementType)( 5 + offset );
+			case 8: return (eElementType)( 7 + offset );
+			}
+			return eElementType::Struct;
+		}
+
+		// Validate the fields common to all descriptors, against the element type the callee expects
+		template<class T>
+		inline HRESULT validateElements( const void* data, IUnknown* owner, uint32_t elementSize, eElementType elementType, eArrayOwnership ownership, bool empty )
+		{
+			if( sizeof( T ) != elementSize || elementTypeOf<T>() != elementType )
+				return E_INVALIDARG;
+			if( nullptr == data && !empty )
+				return E_POINTER;
+			switch( ownership )
+			{
+			case eArrayOwnership::Borrowed:
+				return S_OK;
+			case eArrayOwnership::Owned:
+				return ( nullptr != owner ) ? S_OK : E_POINTER;
+			}
+			return E_INVALIDARG;
+		}
+
+		template<class T>
+		inline ArrayDescriptor makeArrayDescriptor( T* data, int64_t length, int64_t stride, IUnknown* owner )
+		{
+			static_assert( std::is_trivially_copyable<T>::value, "Arrays can only contain trivially copyable elements" );
+			ArrayDescriptor ad;
+			ad.data = const_cast<typename std::remove_cv<T>::type*>( data );
+			ad.owner = owner;
+			ad.length = length;
+			ad.stride = stride;
+			ad.elementSize = (uint32_t)sizeof( T );
+			ad.elementType = elementTypeOf<T>();
+			ad.ownership = ( nullptr != owner ) ? eArrayOwnership::Owned : eArrayOwnership::Borrowed;
+			ad.reserved = 0;
+			return ad;
+		}
+	}
+
+	// Typed view of a contiguous one-dimensional array. Use const T for read-only arrays. Usage in interfaces:
+	// virtual HRESULT COMLIGHTCALL sum( const ArraySpan<const float>& values, double& result ) = 0;
+	template<class T>
+	struct ArraySpan : public ArrayDescriptor
+	{
+		ArraySpan() : ArrayDescriptor( details::makeArrayDescriptor<T>( nullptr, 0, sizeof( T ), nullptr ) ) { }
+
+		// Borrowed array, unless the owner is specified
+		ArraySpan( T* data, int64_t length, IUnknown* owner = nullptr ) :
+			ArrayDescriptor( details::makeArrayDescriptor<T>( data, length, sizeof( T ), owner ) ) { }
+
+		template<class E>
+		ArraySpan( std::vector<E>& vec ) : ArraySpan( vec.data(), (int64_t)vec.size() ) { }
+
+		template<class E>
+		ArraySpan( const std::vector<E>& vec ) : ArraySpan( vec.data(), (int64_t)vec.size() ) { }
+
+		// The callee must validate the arrays it receives, they may come from another module or from .NET
+		HRESULT validate() const
+		{
+			if( length < 0 || stride != (int64_t)sizeof( T ) )
+				return E_INVALIDARG;
+			return details::validateElements<T>( data, owner, elementSize, elementType, ownership, 0 == length );
+		}
+
+		T* begin() const { return (T*)data; }
+		T* end() const { return (T*)data + length; }
+		int64_t size() const { return length; }
+		T& operator[]( int64_t i ) const { return ( (T*)data )[ i ]; }
+	};
+
+	// Typed view of a one-dimensional array with arbitrary distance between elements, e.g. a column of a matrix, or a field of an array of structures
+	template<class T>
+	struct StridedSpan : public ArrayDescriptor
+	{
+		StridedSpan() : ArrayDescriptor( details::makeArrayDescriptor<T>( nullptr, 0, sizeof( T ), nullptr ) ) { }
+
+		StridedSpan( T* data, int64_t length, int64_t stride, IUnknown* owner = nullptr ) :
+			ArrayDescriptor( details::makeArrayDescriptor<T>( data, length, stride, owner ) ) { }
+
+		StridedSpan( const ArraySpan<T>& span ) : ArrayDescriptor( span ) { }
+
+		// The stride must keep the elements aligned
+		HRESULT validate() const
+		{
+			if( length < 0 || 0 != stride % (int64_t)alignof( T ) )
+				return E_INVALIDARG;
+			return details::validateElements<T>( data, owner, elementSize, elementType, ownership, 0 == length );
+		}
+
+		int64_t size() const { return length; }
+		T& operator[]( int64_t i ) const { return *(T*)( (uint8_t*)data + i * stride ); }
+		bool isContiguous() const { return stride == (int64_t)sizeof( T ); }
+	};
+
+	// Typed view of a multi-dimensional array, the first index is the outermost one
+	template<class T>
+	struct NdSpan : public NdArrayDescriptor
+	{
+		NdSpan()
+		{
+			initialize( nullptr, 0, nullptr );
+		}
+
+		// Dense array in row-major order, i.e. the last index is contiguous
+		NdSpan( T* data, std::initializer_list<int64_t> shape, IUnknown* owner = nullptr )
+		{
+			if( !initialize( data, (int)shape.size(), owner ) )
+				return;
+			int i = 0;
+			for( int64_t s : shape )
+				this->shape[ i++ ] = s;
+			int64_t stride = sizeof( T );
+			for( i = dimensions - 1; i >= 0; i-- )
+			{
+				strides[ i ] = stride;
+				stride *= this->shape[ i ];
+			}
+		}
+
+		// Arbitrary strides in bytes, e.g. a sub-matrix or a transposed view
+		NdSpan( T* data, int dims, const int64_t* shape, const int64_t* strides, IUnknown* owner = nullptr )
+		{
+			if( !initialize( data, dims, owner ) )
+				return;
+			for( int i = 0; i < dimensions; i++ )
+			{
+				this->shape[ i ] = shape[ i ];
+				this->strides[ i ] = strides[ i ];
+			}
+		}
+
+		HRESULT validate() const
+		{
+			if( dimensions > maxArrayDimensions )
+				return E_INVALIDARG;
+			bool empty = false;
+			for( int i = 0; i < maxArrayDimensions; i++ )
+			{
+				if( shape[ i ] < 0 || 0 != strides[ i ] % (int64_t)alignof( T ) )
+					return E_INVALIDARG;
+				empty = empty || 0 == shape[ i ];
+			}
+			return details::validateElements<T>( data, owner, elementSize, elementType, ownership, empty );
+		}
+
+		// Total count of elements, 0 when the dimensions are invalid
+		int64_t size() const
+		{
+			if( dimensions > maxArrayDimensions )
+				return 0;
+			int64_t res = 1;
+			for( int i = 0; i < dimensions; i++ )
+				res *= shape[ i ];
+			return res;
+		}
+
+		T& at( int64_t i0, int64_t i1 = 0, int64_t i2 = 0, int64_t i3 = 0 ) const
+		{
+			const int64_t offset = i0 * strides[ 0 ] + i1 * strides[ 1 ] + i2 * strides[ 2 ] + i3 * strides[ 3 ];
+			return *(T*)( (uint8_t*)data + offset );
+		}
+
+		// True when the elements are dense in row-major order, and the array can be processed as a single ArraySpan
+		bool isContiguous() const
+		{
+			if( dimensions > maxArrayDimensions )
+				return false;
+			int64_t stride = sizeof( T );
+			for( int i = dimensions - 1; i >= 0; i-- )
+			{
+				if( shape[ i ] > 1 && strides[ i ] != stride )
+					return false;
+				stride *= shape[ i ];
+			}
+			return true;
+		}
+
+		// One-dimensional view of a contiguous array
+		ArraySpan<T> flatten() const
+		{
+			ArraySpan<T> res{ (T*)data, size(), owner };
+			res.ownership = ownership;
+			return res;
+		}
+
+	private:
+
+		// Returns false when the count of dimensions is unsupported, the descriptor is then marked invalid
+		bool initialize( T* data, int dims, IUnknown* owner )
+		{
+			static_assert( std::is_trivially_copyable<T>::value, "Arrays can only contain trivially copyable elements" );
+			this->data = const_cast<typename std::remove_cv<T>::type*>( data );
+			this->owner = owner;
+			elementSize = (uint32_t)sizeof( T );
+			elementType = details::elementTypeOf<T>();
+			ownership = ( nullptr != owner ) ? eArrayOwnership::Owned : eArrayOwnership::Borrowed;
+			const bool valid = dims >= 0 && dims <= maxArrayDimensions;
+			dimensions = valid ? (uint8_t)dims : invalidArrayDimensions;
+			reserved = 0;
+			for( int i = 0; i < maxArrayDimensions; i++ )
+			{
+				shape[ i ] = 1;
+				strides[ i ] = 0;
+			}
+			return valid;
+		}
+	};
+
+	// Get a reference to the owner of the array, to use the elements after the call returns. Fails with E_ACCESSDENIED for borrowed arrays.
+	template<class D>
+	inline HRESULT retainArray( const D& desc, CComPtr<IUnknown>& result )
+	{
+		static_assert( std::is_base_of<ArrayDescriptor, D>::value || std::is_base_of<NdArrayDescriptor, D>::value, "Expected an array descriptor" );
+		if( eArrayOwnership::Owned != desc.ownership || nullptr == desc.owner )
+			return E_ACCESSDENIED;
+		result = desc.owner;
+		return S_OK;
+	}
+
+#if defined( _WIN64 ) || defined( __LP64__ )
+	static_assert( sizeof( ArrayDescriptor ) == 40, "ArrayDescriptor layout is part of the ABI" );
+	static_assert( sizeof( NdArrayDescriptor ) == 88, "NdArrayDescriptor layout is part of the ABI" );
+#endif
+	static_assert( sizeof( ArraySpan<float> ) == sizeof( ArrayDescriptor ), "Typed spans must not add fields" );
+	static_assert( sizeof( NdSpan<float> ) == sizeof( NdArrayDescriptor ), "Typed spans must not add fields" );
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+#include "comLightCommon.h"
+
+// COM interfaces for asynchronous stream I/O, with many requests in flight.
+namespace ComLight
+{
+	// Completion callback of asynchronous I/O requests. Called on a thread of the I/O thread pool, keep the implementation fast and thread safe.
+	struct DECLSPEC_NOVTABLE iAsyncCompletion : public IUnknown
+	{
+		DEFINE_INTERFACE_ID( "3b0d9e57-8f41-4a6c-b3e2-5d7a9c1f0e64" );
+
+		// The request identifier is whatever the caller passed when starting the request. The status is S_OK, E_EOF when the read was truncated by the end of the stream, or an error code.
+		virtual HRESULT COMLIGHTCALL completed( uint64_t requestId, HRESULT status, int64_t bytesTransferred ) = 0;
+	};
+
+	// Asynchronous readonly stream. Reads are positional, multiple requests can be in flight and they may complete in any order.
+	struct DECLSPEC_NOVTABLE iAsyncReadStream : public IUnknown
+	{
+		DEFINE_INTERFACE_ID( "c6e2f4a1-7b3d-4e85-9a0c-1f5e8d2b6c37" );
+
+		// Start reading the specified count of bytes at the specified offset. The buffer must stay alive until the completion is called.
+		// When this method fails, the completion will not be called.
+		virtual HRESULT COMLIGHTCALL readAsync( int64_t offset, void* buffer, int64_t length, iAsyncCompletion* completion, uint64_t requestId ) = 0;
+
+		virtual HRESULT COMLIGHTCALL getLength( int64_t& length ) = 0;
+	};
+
+	// Asynchronous write stream. Writes are appended to the stream in the order they were started, and they complete in the same order.
+	struct DECLSPEC_NOVTABLE iAsyncWriteStream : public IUnknown
+	{
+		DEFINE_INTERFACE_ID( "9f1a7c3e-2d8b-4b60-8e4f-a3c5d7e9b102" );
+
+		// Start writing the buffer. The buffer must stay alive until the completion is called.
+		// When this method fails, the completion will not be called.
+		virtual HRESULT COMLIGHTCALL writeAsync( const void* buffer, int64_t length, iAsyncCompletion* completion, uint64_t requestId ) = 0;
+
+		// Start flushing the stream. Completes after all previously started writes, and the flush itself.
+		virtual HRESULT COMLIGHTCALL flushAsync( iAsyncCompletion* completion, uint64_t requestId ) = 0;
+	};
+}
\ No newline at end of file
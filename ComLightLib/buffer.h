@@ -0,0 +1,35 @@
+#pragma once
+#include "comLightCommon.h"
+#include "arrays.h"
+
+// COM interface for reference-counted memory buffers, to share large data across the interop without copying.
+namespace ComLight
+{
+	// Block of memory owned by a COM object. Whoever holds a reference can access the memory, the pointer and the length never change.
+	// Producers and consumers on both sides of the interop pass these, transferring megabytes of data with only reference counting.
+	struct DECLSPEC_NOVTABLE iBuffer : public IUnknown
+	{
+		DEFINE_INTERFACE_ID( "b5e1d7a3-2c4f-4a96-8e0b-7f3d9c1a6e58" );
+
+		virtual HRESULT COMLIGHTCALL getData( void** ppData, int64_t& length ) = 0;
+
+		// Create a buffer for a range of this one. The slice keeps the memory alive, the caller can release this buffer.
+		// Fails with E_BOUNDS when the range is outside of this buffer.
+		virtual HRESULT COMLIGHTCALL slice( int64_t offset, int64_t length, iBuffer** pp ) = 0;
+	};
+
+	// Typed view of the buffer, owned by the buffer: the receiver of the span can keep the memory alive with retainArray()
+	template<class T>
+	inline HRESULT bufferSpan( iBuffer* buffer, ArraySpan<T>& span )
+	{
+		if( nullptr == buffer )
+			return E_POINTER;
+		void* pv;
+		int64_t length;
+		CHECK( buffer->getData( &pv, length ) );
+		if( 0 != length % (int64_t)sizeof( T ) || 0 != (uintptr_t)pv % alignof( T ) )
+			return E_INVALIDARG;
+		span = ArraySpan<T>( (T*)pv, length / (int64_t)sizeof( T ), buffer );
+		return S_OK;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,259 @@
+#pragma once
+#include <stdint.h>
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+#include "CComPtr.hpp"
+
+namespace ComLight
+{
+	// COM smart pointer which can be loaded and replaced concurrently by multiple threads, for shared objects like the current configuration.
+	// Implements split reference counting: the pointer is packed into a 64-bit word together with a 16-bit count of reservations, i.e. threads in progress.
+	// Readers reserve with a single fetch_add, AddRef the object, then give back the reservation; they never lock and never wait for writers.
+	// Writers reserve the same way, add a reference for every reservation in the word, then replace the word with CAS. Every thread which finds the word replaced calls Release instead of giving back the reservation.
+	// When a writer stores the same object again, a late thread may give back its reservation to the newer word. That's harmless, the reservations of the same object are interchangeable.
+	// Loads are lock-free, but not wait-free: the CAS which gives back the reservation retries when other threads change the count at the same time.
+	// On 64-bit platforms the pointers must fit in 48 bits. Pointers with tags in the high bits (ARM64 TBI / MTE) or from 57-bit address spaces don't fit:
+	// the first time such a pointer is stored, the instance permanently switches to a mutex-protected pointer, and all later calls take the mutex.
+	template<class I>
+	class AtomicComPtr
+	{
+		static constexpr unsigned countShift = sizeof( void* ) == 8 ? 48 : 32;
+		static constexpr uint64_t countOne = (uint64_t)1 << countShift;
+		static constexpr uint64_t pointerMask = countOne - 1;
+
+		mutable std::atomic<uint64_t> m_word;
+		// Used after the switch to the locked mode, when the word contains lockedMarker()
+		mutable std::mutex m_lock;
+		I* m_locked = nullptr;
+
+		enum struct eReplace : uint8_t
+		{
+			Replaced,
+			Mismatch,
+			// The instance is in the locked mode, nothing was changed
+			Locked,
+		};
+
+		// Objects are at least 4 bytes aligned, this value is never a valid pointer
+		static I* lockedMarker()
+		{
+			return (I*)(uintptr_t)1;
+		}
+
+		static bool fits( I* p )
+		{
+			return 0 == ( (uint64_t)(uintptr_t)p & ~pointerMask );
+		}
+
+		static I* pointer( uint64_t w )
+		{
+			return (I*)(uintptr_t)( w & pointerMask );
+		}
+
+		static uint64_t pack( I* p )
+		{
+			const uint64_t v = (uint64_t)(uintptr_t)p;
+			assert( 0 == ( v & ~pointerMask ) );
+			return v;
+		}
+
+		// Returns the word with the new reservation included
+		uint64_t reserve() const
+		{
+			const uint64_t w = m_word.fetch_add( countOne, std::memory_order_acquire ) + countOne;
+			assert( 0 != ( w >> countShift ) );
+			return w;
+		}
+
+		void giveBack( I* p ) const
+		{
+			// The CAS only retries when other threads changed the count at the same time
+			uint64_t cur = m_word.load( std::memory_order_acquire );
+			while( pointer( cur ) == p && 0 != ( cur >> countShift ) )
+			{
+				if( m_word.compare_exchange_weak( cur, cur - countOne, std::memory_order_acquire ) )
+					return;
+			}
+			// A writer replaced the word, after adding a reference for our reservation
+			if( nullptr != p )
+				p->Release();
+		}
+
+		// The marker is never replaced, the reservation can always be given back to the word
+		void giveBackMarker() const
+		{
+			m_word.fetch_sub( countOne, std::memory_order_release );
+		}
+
+		static void addReferences( I* p, uint64_t& added, uint64_t count )
+		{
+			if( nullptr == p )
+				return;
+			for( ; added < count; added++ )
+				p->AddRef();
+			for( ; added > count; added-- )
+				p->Release();
+		}
+
+		// Replace the word unless compare is true and the current object is not expected. On success, the caller owns the reference to the old object.
+		eReplace replace( I* desired, I*& old, bool compare, I* expected )
+		{
+			uint64_t cur = reserve();
+			uint64_t added = 0;
+			while( true )
+			{
+				I* const p = pointer( cur );
+				if( p == lockedMarker() )
+				{
+					giveBackMarker();
+					return eReplace::Locked;
+				}
+				if( compare && p != expected )
+				{
+					addReferences( p, added, 0 );
+					giveBack( p );
+					return eReplace::Mismatch;
+				}
+				// Our reservation keeps the object alive while we add the references
+				addReferences( p, added, cur >> countShift );
+				if( m_word.compare_exchange_weak( cur, pack( desired ), std::memory_order_acq_rel, std::memory_order_acquire ) )
+				{
+					// One of the added references was for our own reservation
+					if( nullptr != p )
+						p->Release();
+					old = p;
+					return eReplace::Replaced;
+				}
+				if( pointer( cur ) != p )
+				{
+					// Another writer replaced the word, and added a reference for our reservation
+					addReferences( p, added, 0 );
+					if( nullptr != p )
+						p->Release();
+					cur = reserve();
+				}
+			}
+		}
+
+		// Switch to the locked mode unless already there, the caller must hold the mutex. The reference held by the word moves to m_locked.
+		void lockedMode()
+		{
+			I* old = nullptr;
+			if( eReplace::Replaced == replace( lockedMarker(), old, false, nullptr ) )
+				m_locked = old;
+		}
+
+	public:
+
+		AtomicComPtr() : m_word( 0 ) { }
+
+		AtomicComPtr( I* p ) : m_word( 0 )
+		{
+			if( nullptr != p )
+				p->AddRef();
+			if( fits( p ) )
+				m_word.store( pack( p ), std::memory_order_relaxed );
+			else
+			{
+				m_word.store( pack( lockedMarker() ), std::memory_order_relaxed );
+				m_locked = p;
+			}
+		}
+
+		AtomicComPtr( const AtomicComPtr& ) = delete;
+		void operator=( const AtomicComPtr& ) = delete;
+
+		// Must not run concurrently with other methods
+		~AtomicComPtr()
+		{
+			I* p = pointer( m_word.load( std::memory_order_relaxed ) );
+			if( p == lockedMarker() )
+				p = m_locked;
+			if( nullptr != p )
+				p->Release();
+		}
+
+		// Switch to the mutex-protected pointer now, instead of on the first pointer which doesn't fit. Can be called concurrently with other methods.
+		// For testing the locked mode on platforms where every pointer fits.
+		void switchToLockedMode()
+		{
+			std::lock_guard<std::mutex> guard( m_lock );
+			lockedMode();
+		}
+
+		// Get a new reference to the current object
+		CComPtr<I> load() const
+		{
+			I* const p = pointer( reserve() );
+			if( p == lockedMarker() )
+			{
+				giveBackMarker();
+				std::lock_guard<std::mutex> guard( m_lock );
+				return CComPtr<I>{ m_locked };
+			}
+			if( nullptr != p )
+				p->AddRef();
+			CComPtr<I> result;
+			result.attach( p );
+			giveBack( p );
+			return result;
+		}
+
+		// Replace the object, release the old one
+		void store( I* desired )
+		{
+			CComPtr<I> old = exchange( desired );
+		}
+
+		// Replace the object, return the old one
+		CComPtr<I> exchange( I* desired )
+		{
+			if( nullptr != desired )
+				desired->AddRef();
+			I* old = nullptr;
+			if( !fits( desired ) || eReplace::Replaced != replace( desired, old, false, nullptr ) )
+			{
+				std::lock_guard<std::mutex> guard( m_lock );
+				lockedMode();
+				old = m_locked;
+				m_locked = desired;
+			}
+			CComPtr<I> result;
+			result.attach( old );
+			return result;
+		}
+
+		// Replace the object if the current one is expected. On failure, load the current object into expected and return false.
+		bool compare_exchange( CComPtr<I>& expected, I* desired )
+		{
+			if( nullptr != desired )
+				desired->AddRef();
+			I* old = nullptr;
+			eReplace r = fits( desired ) ? replace( desired, old, true, expected ) : eReplace::Locked;
+			if( eReplace::Locked == r )
+			{
+				std::lock_guard<std::mutex> guard( m_lock );
+				lockedMode();
+				r = eReplace::Mismatch;
+				if( m_locked == (I*)expected )
+				{
+					old = m_locked;
+					m_locked = desired;
+					r = eReplace::Replaced;
+				}
+			}
+			if( eReplace::Replaced == r )
+			{
+				// The caller still has a reference in expected, release the one held by this pointer
+				if( nullptr != old )
+					old->Release();
+				return true;
+			}
+			if( nullptr != desired )
+				desired->Release();
+			expected = load();
+			return false;
+		}
+	};
+}
\ No newline at end of file
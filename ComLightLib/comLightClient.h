@@ -20,4 +20,4 @@ namespace ComLight
 #undef IID_PPV_ARGS
 #endif
 
-#define IID_PPV_ARGS( pp ) decltype( **pp )::iid, ::ComLight::details::castDoublePointerToVoid( pp )
\ No newline at end of file
+#define IID_PPV_ARGS( pp ) std::remove_reference<decltype( **pp )>::type::iid(), ::ComLight::details::castDoublePointerToVoid( pp )
\ No newline at end of file
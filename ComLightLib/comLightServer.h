@@ -4,8 +4,10 @@
 
 #include "server/ObjectRoot.hpp"
 #include "server/interfaceMap.h"
+#include "server/interfaceTable.hpp"
 #include "server/Object.hpp"
 #include "server/freeThreadedMarshaller.h"
+#include "server/instrumentation.hpp"
 
 #ifdef _MSC_VER
 // On Windows, it's controlled by library.def module definition file. There's __declspec(dllexport), but it adds underscore, I don't like that.
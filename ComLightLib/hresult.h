@@ -17,10 +17,15 @@ inline constexpr HRESULT HRESULT_FROM_WIN32( int c )
 
 constexpr HRESULT OLE_E_BLANK = _HRESULT_TYPEDEF_( 0x80040007 );
 constexpr HRESULT E_BOUNDS = _HRESULT_TYPEDEF_( 0x8000000BL ); 
+constexpr HRESULT RPC_E_DISCONNECTED = _HRESULT_TYPEDEF_( 0x80010108L );
 
 constexpr int ERROR_HANDLE_EOF = 38;
+constexpr int ERROR_BROKEN_PIPE = 109;
 constexpr int ERROR_ALREADY_INITIALIZED = 1247;
+constexpr int ERROR_TIMEOUT = 1460;
 #endif
 
 constexpr HRESULT E_EOF = HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
-constexpr HRESULT E_ALREADY_INITIALIZED = HRESULT_FROM_WIN32( ERROR_ALREADY_INITIALIZED );
\ No newline at end of file
+constexpr HRESULT E_ALREADY_INITIALIZED = HRESULT_FROM_WIN32( ERROR_ALREADY_INITIALIZED );
+constexpr HRESULT E_BROKEN_PIPE = HRESULT_FROM_WIN32( ERROR_BROKEN_PIPE );
+constexpr HRESULT E_TIMEOUT = HRESULT_FROM_WIN32( ERROR_TIMEOUT );
\ No newline at end of file
@@ -0,0 +1,263 @@
+#pragma once
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include "../comLightServer.h"
+#include "../streams.h"
+#include "../asyncStreams.h"
+#include "IoThreadPool.hpp"
+
+namespace ComLight
+{
+	// Implements iAsyncReadStream over a synchronous iReadStream, the reads are executed by an I/O thread pool.
+	// When the source implements iPositionalReadStream, the requests are executed concurrently with readAt calls.
+	// Otherwise the source stream has a single cursor, and the requests are executed one at a time.
+	class AsyncReadStream : public ObjectRoot<iAsyncReadStream>
+	{
+		CComPtr<iReadStream> m_source;
+		// nullptr when the source doesn't implement the interface
+		CComPtr<iPositionalReadStream> m_positional;
+		IoThreadPool* m_pool = nullptr;
+		// Serializes seek + read pairs on the source stream, unused for positional sources
+		std::mutex m_lock;
+
+		HRESULT readSync( int64_t offset, void* buffer, int64_t length, int64_t& bytesRead )
+		{
+			bytesRead = 0;
+			if( m_positional )
+			{
+				CHECK( m_positional->readAt( offset, buffer, length, bytesRead ) );
+				return ( bytesRead >= length ) ? S_OK : E_EOF;
+			}
+
+			std::lock_guard<std::mutex> lock( m_lock );
+			CHECK( m_source->seek( offset, eSeekOrigin::Begin ) );
+			const ReadBuffer rb{ buffer, length };
+			CHECK( details::readBuffers( m_source, &rb, 1, bytesRead ) );
+			return ( bytesRead >= length ) ? S_OK : E_EOF;
+		}
+
+	public:
+
+		// When the pool is nullptr, the stream uses IoThreadPool::shared(). Otherwise the pool must outlive the stream.
+		HRESULT initialize( iReadStream* source, IoThreadPool* pool = nullptr )
+		{
+			if( nullptr == source )
+				return E_POINTER;
+			if( m_source )
+				return E_ALREADY_INITIALIZED;
+			m_source = source;
+			source->QueryInterface( iPositionalReadStream::iid(), (void**)&m_positional );
+			m_pool = ( nullptr != pool ) ? pool : &IoThreadPool::shared();
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL readAsync( int64_t offset, void* buffer, int64_t length, iAsyncCompletion* completion, uint64_t requestId ) override
+		{
+			if( !m_source )
+				return OLE_E_BLANK;
+			if( nullptr == completion || ( nullptr == buffer && 0 != length ) )
+				return E_POINTER;
+			if( offset < 0 || length < 0 )
+				return E_INVALIDARG;
+
+			// The job keeps both this object and the completion alive until the request is complete
+			CComPtr<AsyncReadStream> self{ this };
+			CComPtr<iAsyncCompletion> callback{ completion };
+			try
+			{
+				m_pool->post( [ self, callback, offset, buffer, length, requestId ]()
+				{
+					int64_t bytesRead = 0;
+					const HRESULT hr = self->readSync( offset, buffer, length, bytesRead );
+					callback->completed( requestId, hr, bytesRead );
+				} );
+			}
+			catch( const std::bad_alloc& )
+			{
+				return E_OUTOFMEMORY;
+			}
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			if( !m_source )
+				return OLE_E_BLANK;
+			if( m_positional )
+				return m_positional->getLength( length );
+			std::lock_guard<std::mutex> lock( m_lock );
+			return m_source->getLength( length );
+		}
+	};
+
+	// Implements iAsyncWriteStream over a synchronous iWriteStream, the writes are executed by an I/O thread pool.
+	// Requests are queued, at most one thread of the pool drains the queue at any given time, this keeps the order of the writes.
+	// After a request fails, the stream doesn't write anything else: the later requests complete with the status of the first failure, instead of leaving a hole in the output.
+	class AsyncWriteStream : public ObjectRoot<iAsyncWriteStream>
+	{
+		CComPtr<iWriteStream> m_dest;
+		IoThreadPool* m_pool = nullptr;
+
+		struct Request
+		{
+			const void* buffer;
+			int64_t length;
+			CComPtr<iAsyncCompletion> completion;
+			uint64_t requestId;
+			bool isFlush;
+		};
+
+		std::mutex m_lock;
+		std::deque<Request> m_queue;
+		// True while a job is draining the queue
+		bool m_draining = false;
+		// Status of the first failed request, only accessed by the draining job
+		HRESULT m_failure = S_OK;
+
+		HRESULT execute( const Request& rq )
+		{
+			if( rq.isFlush )
+				return m_dest->flush();
+			const WriteBuffer wb{ rq.buffer, rq.length };
+			return details::writeBuffers( m_dest, &wb, 1 );
+		}
+
+		void drainQueue()
+		{
+			while( true )
+			{
+				Request rq;
+				{
+					std::lock_guard<std::mutex> lock( m_lock );
+					if( m_queue.empty() )
+					{
+						m_draining = false;
+						return;
+					}
+					rq = std::move( m_queue.front() );
+					m_queue.pop_front();
+				}
+				HRESULT hr = m_failure;
+				if( SUCCEEDED( hr ) )
+				{
+					hr = execute( rq );
+					if( FAILED( hr ) )
+						m_failure = hr;
+				}
+				rq.completion->completed( rq.requestId, hr, SUCCEEDED( hr ) ? rq.length : 0 );
+			}
+		}
+
+		HRESULT enqueue( Request&& rq )
+		{
+			if( !m_dest )
+				return OLE_E_BLANK;
+			{
+				std::lock_guard<std::mutex> lock( m_lock );
+				try
+				{
+					m_queue.emplace_back( std::move( rq ) );
+				}
+				catch( const std::bad_alloc& )
+				{
+					return E_OUTOFMEMORY;
+				}
+				if( m_draining )
+					return S_OK;
+				m_draining = true;
+			}
+			CComPtr<AsyncWriteStream> self{ this };
+			try
+			{
+				m_pool->post( [ self ]() { self->drainQueue(); } );
+			}
+			catch( const std::bad_alloc& )
+			{
+				// Nothing drains the queue. The queue was empty when this request was added, take it back from the front.
+				// Requests added by other threads in the meantime were already accepted, fail them with their completions.
+				std::deque<Request> accepted;
+				{
+					std::lock_guard<std::mutex> lock( m_lock );
+					m_queue.pop_front();
+					accepted.swap( m_queue );
+					m_draining = false;
+				}
+				for( const Request& r : accepted )
+					r.completion->completed( r.requestId, E_OUTOFMEMORY, 0 );
+				return E_OUTOFMEMORY;
+			}
+			return S_OK;
+		}
+
+	public:
+
+		// When the pool is nullptr, the stream uses IoThreadPool::shared(). Otherwise the pool must outlive the stream.
+		HRESULT initialize( iWriteStream* dest, IoThreadPool* pool = nullptr )
+		{
+			if( nullptr == dest )
+				return E_POINTER;
+			if( m_dest )
+				return E_ALREADY_INITIALIZED;
+			m_dest = dest;
+			m_pool = ( nullptr != pool ) ? pool : &IoThreadPool::shared();
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL writeAsync( const void* buffer, int64_t length, iAsyncCompletion* completion, uint64_t requestId ) override
+		{
+			if( nullptr == completion || ( nullptr == buffer && 0 != length ) )
+				return E_POINTER;
+			if( length < 0 )
+				return E_INVALIDARG;
+			return enqueue( Request{ buffer, length, completion, requestId, false } );
+		}
+
+		HRESULT COMLIGHTCALL flushAsync( iAsyncCompletion* completion, uint64_t requestId ) override
+		{
+			if( nullptr == completion )
+				return E_POINTER;
+			return enqueue( Request{ nullptr, 0, completion, requestId, true } );
+		}
+	};
+
+	// Completion callback which counts completed requests, and lets a thread wait for them. Keeps the first failed status.
+	class CompletionCounter : public ObjectRoot<iAsyncCompletion>
+	{
+		std::mutex m_lock;
+		std::condition_variable m_cv;
+		uint64_t m_completed = 0;
+		int64_t m_bytes = 0;
+		HRESULT m_status = S_OK;
+
+		HRESULT COMLIGHTCALL completed( uint64_t requestId, HRESULT status, int64_t bytesTransferred ) override
+		{
+			{
+				std::lock_guard<std::mutex> lock( m_lock );
+				m_completed++;
+				m_bytes += bytesTransferred;
+				if( FAILED( status ) && SUCCEEDED( m_status ) )
+					m_status = status;
+			}
+			m_cv.notify_all();
+			return S_OK;
+		}
+
+	public:
+
+		// Wait until the specified count of requests have completed. Returns the first failed status, or S_OK.
+		HRESULT wait( uint64_t count )
+		{
+			std::unique_lock<std::mutex> lock( m_lock );
+			m_cv.wait( lock, [ this, count ]() { return m_completed >= count; } );
+			return m_status;
+		}
+
+		// Total count of bytes transferred by the completed requests
+		int64_t bytesTransferred()
+		{
+			std::lock_guard<std::mutex> lock( m_lock );
+			return m_bytes;
+		}
+	};
+}
\ No newline at end of file
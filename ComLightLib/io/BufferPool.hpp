@@ -0,0 +1,354 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#ifdef _MSC_VER
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "../comLightServer.h"
+#include "../server/ObjectPool.hpp"
+#include "../buffer.h"
+
+namespace ComLight
+{
+	enum struct eBufferPages : uint8_t
+	{
+		Normal = 0,
+		// Buffers of 2MB and larger are backed by huge pages when the OS has them, for fewer TLB misses on large data.
+		// On Linux that's MAP_HUGETLB with a fallback to transparent huge pages, on Windows MEM_LARGE_PAGES which requires SeLockMemoryPrivilege.
+		Huge = 1,
+	};
+
+	namespace details
+	{
+		// Page-aligned memory blocks straight from the OS, sizes are powers of 2 from 4KB to 64MB
+		class PageBlockPool
+		{
+			static constexpr uint32_t minSizeClassBits = 12;
+			static constexpr uint32_t maxSizeClassBits = 26;
+			static constexpr uint32_t sizeClasses = maxSizeClassBits - minSizeClassBits + 1;
+			static constexpr size_t hugePageSize = 2 * 1024 * 1024;
+			// Free blocks above that total size are returned to the OS instead of being cached
+			static constexpr size_t maxCachedBytes = 256 * 1024 * 1024;
+
+			struct Block
+			{
+				void* pointer;
+				bool huge;
+			};
+
+			std::mutex m_lock;
+			// Free blocks, separate lists for normal and huge pages
+			std::vector<Block> m_free[ sizeClasses ][ 2 ];
+			size_t m_cachedBytes = 0;
+
+			static void* osAllocate( size_t cb, bool& huge )
+			{
+#ifdef _MSC_VER
+				if( huge )
+				{
+					const size_t largePage = GetLargePageMinimum();
+					if( 0 != largePage && 0 == cb % largePage )
+					{
+						void* const p = VirtualAlloc( nullptr, cb, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE );
+						if( nullptr != p )
+							return p;
+					}
+					huge = false;
+				}
+				return VirtualAlloc( nullptr, cb, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+#else
+#ifdef MAP_HUGETLB
+				if( huge )
+				{
+					// Fails unless the administrator has reserved huge pages, vm.nr_hugepages sysctl
+					void* const p = mmap( nullptr, cb, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+					if( MAP_FAILED != p )
+						return p;
+				}
+#endif
+				void* const p = mmap( nullptr, cb, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+				if( MAP_FAILED == p )
+					return nullptr;
+#ifdef MADV_HUGEPAGE
+				// Ask for transparent huge pages instead
+				if( huge )
+					madvise( p, cb, MADV_HUGEPAGE );
+#else
+				huge = false;
+#endif
+				return p;
+#endif
+			}
+
+			static void osFree( void* p, size_t cb )
+			{
+#ifdef _MSC_VER
+				VirtualFree( p, 0, MEM_RELEASE );
+#else
+				munmap( p, cb );
+#endif
+			}
+
+			// Index of the smallest size class which fits the length, or -1 when the length is too large for the pool
+			static int sizeClass( size_t cb )
+			{
+				uint32_t bits = minSizeClassBits;
+				while( ( (size_t)1 << bits ) < cb )
+				{
+					bits++;
+					if( bits > maxSizeClassBits )
+						return -1;
+				}
+				return (int)( bits - minSizeClassBits );
+			}
+
+			static size_t classSize( int sc )
+			{
+				return (size_t)1 << ( sc + minSizeClassBits );
+			}
+
+			static size_t pageSize()
+			{
+#ifdef _MSC_VER
+				SYSTEM_INFO si;
+				GetSystemInfo( &si );
+				return si.dwPageSize;
+#else
+				return (size_t)sysconf( _SC_PAGESIZE );
+#endif
+			}
+
+		public:
+
+			// Allocate a page-aligned block of at least the specified size, return the actual size in capacity
+			void* allocate( size_t cb, bool& huge, size_t& capacity )
+			{
+				const int sc = sizeClass( cb );
+				if( sc < 0 )
+				{
+					// Too large to cache, round up to pages and allocate directly
+					const size_t page = huge ? hugePageSize : pageSize();
+					capacity = ( cb + page - 1 ) / page * page;
+					return osAllocate( capacity, huge );
+				}
+
+				capacity = classSize( sc );
+				// Huge pages only make sense when the block has at least one of them
+				if( capacity < hugePageSize )
+					huge = false;
+
+				{
+					std::lock_guard<std::mutex> guard( m_lock );
+					std::vector<Block>& list = m_free[ sc ][ huge ? 1 : 0 ];
+					if( !list.empty() )
+					{
+						const Block b = list.back();
+						list.pop_back();
+						m_cachedBytes -= capacity;
+						huge = b.huge;
+						return b.pointer;
+					}
+				}
+				return osAllocate( capacity, huge );
+			}
+
+			void deallocate( void* p, size_t capacity, bool huge )
+			{
+				const int sc = sizeClass( capacity );
+				if( sc >= 0 && classSize( sc ) == capacity )
+				{
+					std::lock_guard<std::mutex> guard( m_lock );
+					if( m_cachedBytes + capacity <= maxCachedBytes )
+					{
+						try
+						{
+							m_free[ sc ][ huge ? 1 : 0 ].push_back( Block{ p, huge } );
+							m_cachedBytes += capacity;
+							return;
+						}
+						catch( const std::bad_alloc& )
+						{
+						}
+					}
+				}
+				osFree( p, capacity );
+			}
+
+			// Return all cached free blocks to the OS
+			void trim()
+			{
+				std::lock_guard<std::mutex> guard( m_lock );
+				for( int sc = 0; sc < (int)sizeClasses; sc++ )
+				{
+					for( auto& list : m_free[ sc ] )
+					{
+						for( const Block& b : list )
+							osFree( b.pointer, classSize( sc ) );
+						list.clear();
+						list.shrink_to_fit();
+					}
+				}
+				m_cachedBytes = 0;
+			}
+
+			// Created on first use and never destroyed, buffers can be released by other static destructors while the process is shutting down
+			static PageBlockPool& instance()
+			{
+				static PageBlockPool* const pool = new PageBlockPool();
+				return *pool;
+			}
+		};
+
+		// Sub-range of another buffer, keeps a reference to the buffer which owns the memory
+		class BufferSlice : public ObjectRoot<iBuffer>
+		{
+			DECLARE_POOLED_ALLOCATION()
+
+			CComPtr<iBuffer> m_owner;
+			uint8_t* m_data = nullptr;
+			int64_t m_length = 0;
+
+		public:
+
+			void initialize( iBuffer* owner, uint8_t* data, int64_t length )
+			{
+				m_owner = owner;
+				m_data = data;
+				m_length = length;
+			}
+
+			HRESULT COMLIGHTCALL getData( void** ppData, int64_t& length ) override;
+
+			HRESULT COMLIGHTCALL slice( int64_t offset, int64_t length, iBuffer** pp ) override;
+		};
+
+		// Slices reference the buffer which owns the memory, not the one they were sliced from, so the chains of references never grow.
+		inline HRESULT sliceBuffer( iBuffer* owner, uint8_t* data, int64_t length, int64_t sliceOffset, int64_t sliceLength, iBuffer** pp )
+		{
+			if( nullptr == pp )
+				return E_POINTER;
+			if( sliceOffset < 0 || sliceLength < 0 || sliceOffset > length || sliceLength > length - sliceOffset )
+				return E_BOUNDS;
+
+			CComPtr<Object<BufferSlice>> result;
+			CHECK( Object<BufferSlice>::create( result ) );
+			result->initialize( owner, data + sliceOffset, sliceLength );
+			result.detach( pp );
+			return S_OK;
+		}
+
+		inline HRESULT COMLIGHTCALL BufferSlice::getData( void** ppData, int64_t& length )
+		{
+			if( nullptr == ppData )
+				return E_POINTER;
+			*ppData = m_data;
+			length = m_length;
+			return S_OK;
+		}
+
+		inline HRESULT COMLIGHTCALL BufferSlice::slice( int64_t offset, int64_t length, iBuffer** pp )
+		{
+			return sliceBuffer( m_owner, m_data, m_length, offset, length, pp );
+		}
+	}
+
+	// Buffer with page-aligned memory from a size-class pool. The content of new buffers is uninitialized.
+	// Released buffers return the memory to the pool, recycled by the next buffers of the same size class. Use trimBufferPool() to give the cached memory back to the OS.
+	class PooledBuffer : public ObjectRoot<iBuffer>
+	{
+		DECLARE_POOLED_ALLOCATION()
+
+		uint8_t* m_data = nullptr;
+		int64_t m_length = 0;
+		size_t m_capacity = 0;
+		bool m_huge = false;
+
+	public:
+
+		~PooledBuffer()
+		{
+			if( nullptr != m_data )
+				details::PageBlockPool::instance().deallocate( m_data, m_capacity, m_huge );
+		}
+
+		HRESULT initialize( int64_t length, eBufferPages pages = eBufferPages::Normal )
+		{
+			if( nullptr != m_data )
+				return E_ALREADY_INITIALIZED;
+			if( length < 0 || (uint64_t)length > SIZE_MAX / 2 )
+				return E_INVALIDARG;
+
+			bool huge = eBufferPages::Huge == pages;
+			size_t capacity;
+			void* const p = details::PageBlockPool::instance().allocate( (std::max)( (size_t)length, (size_t)1 ), huge, capacity );
+			if( nullptr == p )
+				return E_OUTOFMEMORY;
+			m_data = (uint8_t*)p;
+			m_length = length;
+			m_capacity = capacity;
+			m_huge = huge;
+			return S_OK;
+		}
+
+		// True when the memory is backed by huge pages, or was advised to be
+		bool hugePages() const { return m_huge; }
+
+		HRESULT COMLIGHTCALL getData( void** ppData, int64_t& length ) override
+		{
+			if( nullptr == ppData )
+				return E_POINTER;
+			*ppData = m_data;
+			length = m_length;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL slice( int64_t offset, int64_t length, iBuffer** pp ) override
+		{
+			return details::sliceBuffer( this, m_data, m_length, offset, length, pp );
+		}
+	};
+
+	// Create a new buffer of the specified length
+	inline HRESULT createBuffer( int64_t length, iBuffer** pp, eBufferPages pages = eBufferPages::Normal )
+	{
+		if( nullptr == pp )
+			return E_POINTER;
+		CComPtr<Object<PooledBuffer>> buffer;
+		CHECK( Object<PooledBuffer>::create( buffer ) );
+		CHECK( buffer->initialize( length, pages ) );
+		buffer.detach( pp );
+		return S_OK;
+	}
+
+	// Create a new buffer with a copy of the data
+	inline HRESULT createBuffer( const void* data, int64_t length, iBuffer** pp, eBufferPages pages = eBufferPages::Normal )
+	{
+		if( nullptr == data && 0 != length )
+			return E_INVALIDARG;
+		if( nullptr == pp )
+			return E_POINTER;
+		CComPtr<Object<PooledBuffer>> buffer;
+		CHECK( Object<PooledBuffer>::create( buffer ) );
+		CHECK( buffer->initialize( length, pages ) );
+		void* pv;
+		int64_t cb;
+		CHECK( buffer->getData( &pv, cb ) );
+		if( cb > 0 )
+			memcpy( pv, data, (size_t)cb );
+		buffer.detach( pp );
+		return S_OK;
+	}
+
+	// Return the memory cached by the pool of released buffers to the OS
+	inline void trimBufferPool()
+	{
+		details::PageBlockPool::instance().trim();
+	}
+}
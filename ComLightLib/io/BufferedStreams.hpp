@@ -0,0 +1,353 @@
+#pragma once
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#include <vector>
+#include "../comLightServer.h"
+#include "../streams.h"
+
+namespace ComLight
+{
+	namespace details
+	{
+		constexpr size_t defaultStreamBufferSize = 64 * 1024;
+	}
+
+	// Wraps an arbitrary readonly stream, typically implemented in .NET, with a buffer.
+	// Small reads are served from the buffer, reads larger than the buffer go straight to the source stream.
+	// Reduces the count of calls to the source by orders of magnitude for workloads which read small records.
+	class BufferedReadStream : public ObjectRoot<iReadStreamLending>
+	{
+		CComPtr<iReadStream> m_source;
+		std::vector<uint8_t> m_buffer;
+		// The buffered data is in [ m_begin .. m_end ) range of the vector
+		size_t m_begin = 0, m_end = 0;
+		// Position of the source stream, which is at the end of the buffered data. Negative when not known yet.
+		int64_t m_sourcePosition = -1;
+		bool m_acquired = false;
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iReadStream )
+			COM_INTERFACE_ENTRY( iReadStreamLending )
+		END_COM_MAP()
+
+		void discardBuffer()
+		{
+			m_begin = m_end = 0;
+		}
+
+		HRESULT readSource( void* pv, size_t cb, size_t& cbRead )
+		{
+			int n = 0;
+			CHECK( m_source->read( pv, (int)(std::min)( cb, (size_t)INT_MAX ), n ) );
+			if( n < 0 )
+				return E_UNEXPECTED;
+			cbRead = (size_t)n;
+			if( m_sourcePosition >= 0 )
+				m_sourcePosition += n;
+			return S_OK;
+		}
+
+		HRESULT fillBuffer()
+		{
+			discardBuffer();
+			size_t cb = 0;
+			CHECK( readSource( m_buffer.data(), m_buffer.size(), cb ) );
+			m_end = cb;
+			return S_OK;
+		}
+
+		HRESULT sourcePosition( int64_t& pos )
+		{
+			if( m_sourcePosition < 0 )
+				CHECK( m_source->getPosition( m_sourcePosition ) );
+			pos = m_sourcePosition;
+			return S_OK;
+		}
+
+	public:
+
+		HRESULT initialize( iReadStream* source, size_t bufferSize = details::defaultStreamBufferSize )
+		{
+			if( nullptr == source )
+				return E_POINTER;
+			if( m_source )
+				return E_ALREADY_INITIALIZED;
+			if( 0 == bufferSize || bufferSize > INT_MAX )
+				return E_INVALIDARG;
+			m_buffer.resize( bufferSize );
+			m_source = source;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			if( !m_source )
+				return OLE_E_BLANK;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			if( nNumberOfBytesToRead < 0 )
+				return E_INVALIDARG;
+
+			uint8_t* pb = (uint8_t*)lpBuffer;
+			size_t remaining = (size_t)nNumberOfBytesToRead;
+			while( remaining > 0 )
+			{
+				if( m_begin < m_end )
+				{
+					const size_t cb = (std::min)( remaining, m_end - m_begin );
+					memcpy( pb, m_buffer.data() + m_begin, cb );
+					m_begin += cb;
+					pb += cb;
+					remaining -= cb;
+					continue;
+				}
+
+				size_t cb = 0;
+				if( remaining >= m_buffer.size() )
+				{
+					// Large read, bypass the buffer
+					discardBuffer();
+					CHECK( readSource( pb, remaining, cb ) );
+					pb += cb;
+					remaining -= cb;
+				}
+				else
+				{
+					CHECK( fillBuffer() );
+					cb = m_end;
+				}
+				if( 0 == cb )
+					break;	// End of stream
+			}
+			lpNumberOfBytesRead = nNumberOfBytesToRead - (int)remaining;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override
+		{
+			if( !m_source )
+				return OLE_E_BLANK;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+
+			const int64_t buffered = (int64_t)( m_end - m_begin );
+			switch( origin )
+			{
+			case eSeekOrigin::Begin:
+				if( m_sourcePosition >= 0 && m_end > 0 )
+				{
+					// The buffer contains the [ m_sourcePosition - m_end .. m_sourcePosition ) range of the source stream
+					const int64_t bufferStart = m_sourcePosition - (int64_t)m_end;
+					if( offset >= bufferStart && offset <= m_sourcePosition )
+					{
+						m_begin = (size_t)( offset - bufferStart );
+						return S_OK;
+					}
+				}
+				break;
+			case eSeekOrigin::Current:
+				if( offset >= -(int64_t)m_begin && offset <= buffered )
+				{
+					// Seeking within the buffer, no need to call the source
+					m_begin = (size_t)( (int64_t)m_begin + offset );
+					return S_OK;
+				}
+				// The source position is ahead of the stream position by the count of buffered bytes
+				offset -= buffered;
+				break;
+			case eSeekOrigin::End:
+				break;
+			default:
+				return E_INVALIDARG;
+			}
+
+			discardBuffer();
+			m_sourcePosition = -1;
+			CHECK( m_source->seek( offset, origin ) );
+			if( eSeekOrigin::Begin == origin )
+				m_sourcePosition = offset;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override
+		{
+			if( !m_source )
+				return OLE_E_BLANK;
+			int64_t pos;
+			CHECK( sourcePosition( pos ) );
+			position = pos - (int64_t)( m_end - m_begin );
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			if( !m_source )
+				return OLE_E_BLANK;
+			return m_source->getLength( length );
+		}
+
+		HRESULT COMLIGHTCALL acquireRead( const void** ppData, int64_t& length ) override
+		{
+			if( nullptr == ppData )
+				return E_POINTER;
+			if( !m_source )
+				return OLE_E_BLANK;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			if( m_begin >= m_end )
+				CHECK( fillBuffer() );
+			*ppData = m_buffer.data() + m_begin;
+			length = (int64_t)( m_end - m_begin );
+			m_acquired = true;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL releaseRead( int64_t consumed ) override
+		{
+			if( !m_acquired )
+				return E_UNEXPECTED;
+			if( consumed < 0 || consumed > (int64_t)( m_end - m_begin ) )
+				return E_BOUNDS;
+			m_begin += (size_t)consumed;
+			m_acquired = false;
+			return S_OK;
+		}
+	};
+
+	// Wraps an arbitrary write-only stream, typically implemented in .NET, with a buffer.
+	// Small writes are accumulated in the buffer, writes larger than the buffer go straight to the destination stream.
+	// The buffered data is written on flush(), and when the object is destroyed. Call flush() explicitly if you need the status code.
+	class BufferedWriteStream : public ObjectRoot<iWriteStreamLending>
+	{
+		CComPtr<iWriteStream> m_dest;
+		std::vector<uint8_t> m_buffer;
+		// Count of bytes in the buffer which are not yet written to the destination
+		size_t m_length = 0;
+		bool m_acquired = false;
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iWriteStream )
+			COM_INTERFACE_ENTRY( iWriteStreamLending )
+		END_COM_MAP()
+
+		HRESULT writeDest( const void* pv, size_t cb )
+		{
+			const uint8_t* pb = (const uint8_t*)pv;
+			while( cb > 0 )
+			{
+				const size_t chunk = (std::min)( cb, (size_t)INT_MAX );
+				CHECK( m_dest->write( pb, (int)chunk ) );
+				pb += chunk;
+				cb -= chunk;
+			}
+			return S_OK;
+		}
+
+		HRESULT flushBuffer()
+		{
+			const size_t cb = m_length;
+			m_length = 0;
+			return writeDest( m_buffer.data(), cb );
+		}
+
+	public:
+
+		~BufferedWriteStream()
+		{
+			if( m_dest )
+				flushBuffer();
+		}
+
+		HRESULT initialize( iWriteStream* dest, size_t bufferSize = details::defaultStreamBufferSize )
+		{
+			if( nullptr == dest )
+				return E_POINTER;
+			if( m_dest )
+				return E_ALREADY_INITIALIZED;
+			if( 0 == bufferSize )
+				return E_INVALIDARG;
+			m_buffer.resize( bufferSize );
+			m_dest = dest;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL write( const void* lpBuffer, int nNumberOfBytesToWrite ) override
+		{
+			if( !m_dest )
+				return OLE_E_BLANK;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			if( nNumberOfBytesToWrite < 0 )
+				return E_INVALIDARG;
+			const size_t cb = (size_t)nNumberOfBytesToWrite;
+			if( m_length + cb <= m_buffer.size() )
+			{
+				memcpy( m_buffer.data() + m_length, lpBuffer, cb );
+				m_length += cb;
+				return S_OK;
+			}
+			CHECK( flushBuffer() );
+			if( cb >= m_buffer.size() )
+				return writeDest( lpBuffer, cb );
+			memcpy( m_buffer.data(), lpBuffer, cb );
+			m_length = cb;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL flush() override
+		{
+			if( !m_dest )
+				return OLE_E_BLANK;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			CHECK( flushBuffer() );
+			return m_dest->flush();
+		}
+
+		HRESULT COMLIGHTCALL acquireWrite( int64_t minLength, void** ppData, int64_t& length ) override
+		{
+			if( nullptr == ppData )
+				return E_POINTER;
+			if( !m_dest )
+				return OLE_E_BLANK;
+			if( minLength < 0 )
+				return E_INVALIDARG;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			const size_t cbMin = (std::max)( (size_t)minLength, (size_t)1 );
+			if( m_buffer.size() - m_length < cbMin )
+			{
+				CHECK( flushBuffer() );
+				if( m_buffer.size() < cbMin )
+				{
+					try
+					{
+						m_buffer.resize( cbMin );
+					}
+					catch( const std::bad_alloc& )
+					{
+						return E_OUTOFMEMORY;
+					}
+				}
+			}
+			*ppData = m_buffer.data() + m_length;
+			length = (int64_t)( m_buffer.size() - m_length );
+			m_acquired = true;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL commitWrite( int64_t written ) override
+		{
+			if( !m_acquired )
+				return E_UNEXPECTED;
+			if( written < 0 || (size_t)written > m_buffer.size() - m_length )
+				return E_BOUNDS;
+			m_length += (size_t)written;
+			m_acquired = false;
+			if( m_length >= m_buffer.size() )
+				return flushBuffer();
+			return S_OK;
+		}
+	};
+}
\ No newline at end of file
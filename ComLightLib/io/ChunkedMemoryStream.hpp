@@ -0,0 +1,339 @@
+#pragma once
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "../comLightServer.h"
+#include "../streams.h"
+
+namespace ComLight
+{
+	namespace details
+	{
+		constexpr size_t defaultChunkSize = 64 * 1024;
+
+		// Read-only zeros, for the chunks of the gaps which were never written
+		inline const uint8_t* zeroBytes()
+		{
+			static const uint8_t zeros[ defaultChunkSize ] = {};
+			return zeros;
+		}
+
+		// Bytes of a stream stored in fixed-size chunks. The chunks are reference counted: copying the list doesn't copy the data.
+		// The chunks of the gaps left by seeking past the end and writing there are null, and read as zeros.
+		class ChunkList
+		{
+			using Chunk = std::shared_ptr<std::vector<uint8_t>>;
+			std::vector<Chunk> m_chunks;
+			size_t m_chunkSize = defaultChunkSize;
+			int64_t m_length = 0;
+
+			// Get the chunk for writing. Allocates the chunk when it's missing, and copies it when it's shared with snapshots.
+			uint8_t* writableChunk( size_t idx )
+			{
+				if( m_chunks.size() <= idx )
+					m_chunks.resize( idx + 1 );
+				Chunk& c = m_chunks[ idx ];
+				if( !c )
+					c = std::make_shared<std::vector<uint8_t>>( m_chunkSize );
+				else if( c.use_count() > 1 )
+					c = std::make_shared<std::vector<uint8_t>>( *c );
+				else
+				{
+					// The last snapshot which shared the chunk may have been released by another thread, after reading it.
+					// use_count() is a relaxed load, the fence orders these reads before our writes.
+					std::atomic_thread_fence( std::memory_order_acquire );
+				}
+				return c->data();
+			}
+
+		public:
+
+			size_t chunkSize() const { return m_chunkSize; }
+			int64_t length() const { return m_length; }
+			bool empty() const { return m_chunks.empty(); }
+
+			void setChunkSize( size_t cb ) { m_chunkSize = cb; }
+
+			// Read up to cb bytes starting at the offset
+			int64_t read( int64_t offset, void* pv, int64_t cb ) const
+			{
+				cb = (std::min)( cb, m_length - offset );
+				if( cb <= 0 )
+					return 0;
+				uint8_t* pb = (uint8_t*)pv;
+				int64_t remaining = cb;
+				while( remaining > 0 )
+				{
+					const size_t idx = (size_t)( offset / (int64_t)m_chunkSize );
+					const size_t off = (size_t)( offset % (int64_t)m_chunkSize );
+					const size_t chunk = (size_t)(std::min)( remaining, (int64_t)( m_chunkSize - off ) );
+					const Chunk& c = m_chunks[ idx ];
+					if( c )
+						memcpy( pb, c->data() + off, chunk );
+					else
+						memset( pb, 0, chunk );
+					pb += chunk;
+					offset += (int64_t)chunk;
+					remaining -= (int64_t)chunk;
+				}
+				return cb;
+			}
+
+			// Write the data at the offset, growing the list as needed. Gaps after the previous end of the data read as zeros.
+			HRESULT write( int64_t offset, const void* pv, int64_t cb )
+			{
+				const uint8_t* pb = (const uint8_t*)pv;
+				try
+				{
+					while( cb > 0 )
+					{
+						const size_t idx = (size_t)( offset / (int64_t)m_chunkSize );
+						const size_t off = (size_t)( offset % (int64_t)m_chunkSize );
+						const size_t chunk = (size_t)(std::min)( cb, (int64_t)( m_chunkSize - off ) );
+						memcpy( writableChunk( idx ) + off, pb, chunk );
+						pb += chunk;
+						offset += (int64_t)chunk;
+						cb -= (int64_t)chunk;
+					}
+				}
+				catch( const std::bad_alloc& )
+				{
+					return E_OUTOFMEMORY;
+				}
+				m_length = (std::max)( m_length, offset );
+				return S_OK;
+			}
+
+			// Descriptors of the chunks, the last one is truncated to the length of the data. The gaps are described by pieces of zeroBytes().
+			void buffers( std::vector<WriteBuffer>& result ) const
+			{
+				result.clear();
+				int64_t remaining = m_length;
+				for( const Chunk& c : m_chunks )
+				{
+					if( remaining <= 0 )
+						break;
+					int64_t cb = (std::min)( remaining, (int64_t)m_chunkSize );
+					remaining -= cb;
+					if( c )
+					{
+						result.push_back( WriteBuffer{ c->data(), cb } );
+						continue;
+					}
+					while( cb > 0 )
+					{
+						const int64_t piece = (std::min)( cb, (int64_t)defaultChunkSize );
+						result.push_back( WriteBuffer{ zeroBytes(), piece } );
+						cb -= piece;
+					}
+				}
+			}
+
+			HRESULT writeTo( iWriteStream* dest ) const
+			{
+				if( nullptr == dest )
+					return E_POINTER;
+				WriteBatch batch{ dest };
+				std::vector<WriteBuffer> list;
+				buffers( list );
+				for( const WriteBuffer& wb : list )
+					batch.add( wb.data, wb.length );
+				return batch.write();
+			}
+		};
+
+		inline HRESULT seekPosition( int64_t& position, int64_t length, int64_t offset, eSeekOrigin origin )
+		{
+			int64_t pos;
+			switch( origin )
+			{
+			case eSeekOrigin::Begin: pos = offset; break;
+			case eSeekOrigin::Current: pos = position + offset; break;
+			case eSeekOrigin::End: pos = length + offset; break;
+			default: return E_INVALIDARG;
+			}
+			if( pos < 0 )
+				return E_INVALIDARG;
+			position = pos;
+			return S_OK;
+		}
+	}
+
+	// Immutable copy of a ChunkedMemoryStream. Shares the chunks with the stream, the stream copies a chunk before modifying it.
+	// Positional reads are thread safe, the cursor methods of iReadStream are not.
+	class ChunkedMemorySnapshot : public ObjectRoot<iReadStream>, public iPositionalReadStream
+	{
+		details::ChunkList m_data;
+		int64_t m_position = 0;
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iReadStream )
+			COM_INTERFACE_ENTRY( iPositionalReadStream )
+		END_COM_MAP()
+
+	public:
+
+		void initialize( const details::ChunkList& data ) { m_data = data; }
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			if( nNumberOfBytesToRead < 0 )
+				return E_INVALIDARG;
+			const int64_t cb = m_data.read( m_position, lpBuffer, nNumberOfBytesToRead );
+			m_position += cb;
+			lpNumberOfBytesRead = (int)cb;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override
+		{
+			return details::seekPosition( m_position, m_data.length(), offset, origin );
+		}
+
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override
+		{
+			position = m_position;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			length = m_data.length();
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL readAt( int64_t offset, void* buffer, int64_t length, int64_t& bytesRead ) override
+		{
+			if( offset < 0 || length < 0 )
+				return E_INVALIDARG;
+			bytesRead = m_data.read( offset, buffer, length );
+			return S_OK;
+		}
+
+		// Pointers to the chunks, valid while the snapshot is alive
+		void getBuffers( std::vector<WriteBuffer>& buffers ) const { m_data.buffers( buffers ); }
+
+		// Write the data to another stream, with a single call when it implements iWriteStreamBatch
+		HRESULT writeTo( iWriteStream* dest ) const { return m_data.writeTo( dest ); }
+	};
+
+	// Growable memory stream, readable and writable, with a single cursor shared by both interfaces.
+	// The data is stored in fixed-size chunks, growing the stream never reallocates or copies the existing data.
+	// Implements iReadStreamBatch and iWriteStreamBatch, a batch of buffers is moved with a single call.
+	class ChunkedMemoryStream : public ObjectRoot<iReadStreamBatch>, public iWriteStreamBatch
+	{
+		details::ChunkList m_data;
+		int64_t m_position = 0;
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iReadStream )
+			COM_INTERFACE_ENTRY( iReadStreamBatch )
+			COM_INTERFACE_ENTRY( iWriteStream )
+			COM_INTERFACE_ENTRY( iWriteStreamBatch )
+		END_COM_MAP()
+
+	public:
+
+		// Optional, the default chunk size is 64kb. Must be called before writing anything to the stream.
+		HRESULT initialize( size_t chunkSize )
+		{
+			if( !m_data.empty() )
+				return E_ALREADY_INITIALIZED;
+			if( 0 == chunkSize )
+				return E_INVALIDARG;
+			m_data.setChunkSize( chunkSize );
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			if( nNumberOfBytesToRead < 0 )
+				return E_INVALIDARG;
+			const int64_t cb = m_data.read( m_position, lpBuffer, nNumberOfBytesToRead );
+			m_position += cb;
+			lpNumberOfBytesRead = (int)cb;
+			return S_OK;
+		}
+
+		// Seeking past the end is allowed, the gap reads as zeros after writing there. The memory for the gap is not allocated.
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override
+		{
+			return details::seekPosition( m_position, m_data.length(), offset, origin );
+		}
+
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override
+		{
+			position = m_position;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			length = m_data.length();
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL write( const void* lpBuffer, int nNumberOfBytesToWrite ) override
+		{
+			if( nNumberOfBytesToWrite < 0 )
+				return E_INVALIDARG;
+			CHECK( m_data.write( m_position, lpBuffer, nNumberOfBytesToWrite ) );
+			m_position += nNumberOfBytesToWrite;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL flush() override
+		{
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL readBatch( const ReadBuffer* buffers, int count, int64_t& bytesRead ) override
+		{
+			CHECK( details::validateBuffers( buffers, count ) );
+			bytesRead = 0;
+			for( int i = 0; i < count; i++ )
+			{
+				const int64_t cb = m_data.read( m_position, buffers[ i ].data, buffers[ i ].length );
+				m_position += cb;
+				bytesRead += cb;
+				if( cb < buffers[ i ].length )
+					break;
+			}
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL writeBatch( const WriteBuffer* buffers, int count ) override
+		{
+			CHECK( details::validateBuffers( buffers, count ) );
+			for( int i = 0; i < count; i++ )
+			{
+				CHECK( m_data.write( m_position, buffers[ i ].data, buffers[ i ].length ) );
+				m_position += buffers[ i ].length;
+			}
+			return S_OK;
+		}
+
+		// Create a readonly snapshot of the current content. Doesn't copy the data, the chunks are shared until the stream modifies them.
+		HRESULT createSnapshot( iReadStream** pp ) const
+		{
+			if( nullptr == pp )
+				return E_POINTER;
+			CComPtr<Object<ChunkedMemorySnapshot>> snapshot;
+			CHECK( Object<ChunkedMemorySnapshot>::create( snapshot ) );
+			snapshot->initialize( m_data );
+			iReadStream* const result = snapshot;
+			result->AddRef();
+			*pp = result;
+			return S_OK;
+		}
+
+		// Pointers to the chunks, valid until the stream is modified or destroyed. Use a snapshot to keep them longer.
+		void getBuffers( std::vector<WriteBuffer>& buffers ) const { m_data.buffers( buffers ); }
+
+		// Write the data to another stream, with a single call when it implements iWriteStreamBatch
+		HRESULT writeTo( iWriteStream* dest ) const { return m_data.writeTo( dest ); }
+	};
+}
\ No newline at end of file
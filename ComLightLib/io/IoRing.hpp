@@ -0,0 +1,355 @@
+#pragma once
+#ifndef _MSC_VER
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <vector>
+#include "../hresult.h"
+#include "../utils/posixErrors.hpp"
+
+// io_uring is used through raw system calls, liburing is not required. Without the kernel headers, or when the kernel refuses to create the ring, the queue falls back to pread / pwrite.
+#if defined( __has_include )
+#if __has_include( <linux/io_uring.h> ) && defined( __NR_io_uring_setup )
+#include <linux/io_uring.h>
+#define COMLIGHT_IO_URING 1
+#endif
+#endif
+
+namespace ComLight
+{
+	namespace details
+	{
+#ifdef COMLIGHT_IO_URING
+		// Minimal io_uring: a submission queue and a completion queue, mapped into the process
+		class IoRing
+		{
+			int m_fd = -1;
+			void* m_sqRing = nullptr;
+			size_t m_sqRingSize = 0;
+			void* m_cqRing = nullptr;
+			size_t m_cqRingSize = 0;
+			io_uring_sqe* m_sqes = nullptr;
+			size_t m_sqesSize = 0;
+
+			unsigned* m_sqHead = nullptr;
+			unsigned* m_sqTail = nullptr;
+			unsigned m_sqMask = 0;
+			unsigned m_sqEntries = 0;
+			unsigned* m_sqArray = nullptr;
+			unsigned* m_cqHead = nullptr;
+			unsigned* m_cqTail = nullptr;
+			unsigned m_cqMask = 0;
+			io_uring_cqe* m_cqes = nullptr;
+			// Count of prepared entries not yet passed to the kernel
+			unsigned m_toSubmit = 0;
+
+			void destroy()
+			{
+				if( nullptr != m_sqes )
+					munmap( m_sqes, m_sqesSize );
+				if( nullptr != m_cqRing && m_cqRing != m_sqRing )
+					munmap( m_cqRing, m_cqRingSize );
+				if( nullptr != m_sqRing )
+					munmap( m_sqRing, m_sqRingSize );
+				if( m_fd >= 0 )
+					close( m_fd );
+				m_fd = -1;
+				m_sqRing = m_cqRing = nullptr;
+				m_sqes = nullptr;
+			}
+
+			static void* mapRing( int fd, size_t size, off_t offset )
+			{
+				void* const p = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset );
+				return ( MAP_FAILED == p ) ? nullptr : p;
+			}
+
+		public:
+
+			IoRing() = default;
+			IoRing( const IoRing& ) = delete;
+			~IoRing() { destroy(); }
+
+			bool isOpen() const { return m_fd >= 0; }
+
+			// Returns false if io_uring is not available: old kernel, disabled by sysctl, blocked by seccomp, etc.
+			bool initialize( unsigned entries )
+			{
+				io_uring_params p;
+				memset( &p, 0, sizeof( p ) );
+				const long fd = syscall( __NR_io_uring_setup, entries, &p );
+				if( fd < 0 )
+					return false;
+				m_fd = (int)fd;
+
+				m_sqRingSize = p.sq_off.array + p.sq_entries * sizeof( unsigned );
+				m_cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof( io_uring_cqe );
+				const bool singleMap = 0 != ( p.features & IORING_FEAT_SINGLE_MMAP );
+				if( singleMap )
+					m_sqRingSize = m_cqRingSize = std::max( m_sqRingSize, m_cqRingSize );
+
+				m_sqRing = mapRing( m_fd, m_sqRingSize, IORING_OFF_SQ_RING );
+				if( nullptr == m_sqRing )
+				{
+					destroy();
+					return false;
+				}
+				m_cqRing = singleMap ? m_sqRing : mapRing( m_fd, m_cqRingSize, IORING_OFF_CQ_RING );
+				m_sqesSize = p.sq_entries * sizeof( io_uring_sqe );
+				m_sqes = (io_uring_sqe*)mapRing( m_fd, m_sqesSize, IORING_OFF_SQES );
+				if( nullptr == m_cqRing || nullptr == m_sqes )
+				{
+					destroy();
+					return false;
+				}
+
+				uint8_t* const sq = (uint8_t*)m_sqRing;
+				m_sqHead = (unsigned*)( sq + p.sq_off.head );
+				m_sqTail = (unsigned*)( sq + p.sq_off.tail );
+				m_sqMask = *(unsigned*)( sq + p.sq_off.ring_mask );
+				m_sqEntries = p.sq_entries;
+				m_sqArray = (unsigned*)( sq + p.sq_off.array );
+				uint8_t* const cq = (uint8_t*)m_cqRing;
+				m_cqHead = (unsigned*)( cq + p.cq_off.head );
+				m_cqTail = (unsigned*)( cq + p.cq_off.tail );
+				m_cqMask = *(unsigned*)( cq + p.cq_off.ring_mask );
+				m_cqes = (io_uring_cqe*)( cq + p.cq_off.cqes );
+				return true;
+			}
+
+			// Queue a read or write. It's not passed to the kernel until submit(). Returns false when the submission queue is full.
+			bool prepare( bool write, int fd, void* buffer, uint32_t length, uint64_t offset, uint64_t userData )
+			{
+				const unsigned tail = *m_sqTail;
+				if( tail - __atomic_load_n( m_sqHead, __ATOMIC_ACQUIRE ) >= m_sqEntries )
+					return false;
+				const unsigned idx = tail & m_sqMask;
+				io_uring_sqe& sqe = m_sqes[ idx ];
+				memset( &sqe, 0, sizeof( sqe ) );
+				sqe.opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+				sqe.fd = fd;
+				sqe.addr = (uint64_t)(uintptr_t)buffer;
+				sqe.len = length;
+				sqe.off = offset;
+				sqe.user_data = userData;
+				m_sqArray[ idx ] = idx;
+				__atomic_store_n( m_sqTail, tail + 1, __ATOMIC_RELEASE );
+				m_toSubmit++;
+				return true;
+			}
+
+			// Pass the prepared entries to the kernel with a single system call, optionally waiting for the specified count of completions
+			HRESULT submit( unsigned waitCount = 0 )
+			{
+				if( 0 == m_toSubmit && 0 == waitCount )
+					return S_OK;
+				while( true )
+				{
+					const long res = syscall( __NR_io_uring_enter, m_fd, m_toSubmit, waitCount, ( waitCount > 0 ) ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0 );
+					if( res >= 0 )
+					{
+						m_toSubmit -= std::min( m_toSubmit, (unsigned)res );
+						return S_OK;
+					}
+					if( EINTR != errno )
+						return hresultFromErrno();
+				}
+			}
+
+			// Consume a completion if there's one
+			bool peek( uint64_t& userData, int32_t& result )
+			{
+				const unsigned head = *m_cqHead;
+				if( head == __atomic_load_n( m_cqTail, __ATOMIC_ACQUIRE ) )
+					return false;
+				const io_uring_cqe& cqe = m_cqes[ head & m_cqMask ];
+				userData = cqe.user_data;
+				result = cqe.res;
+				__atomic_store_n( m_cqHead, head + 1, __ATOMIC_RELEASE );
+				return true;
+			}
+		};
+#endif
+
+		// Asynchronous positional reads and writes of a single file, over a fixed set of slots, one operation in flight per slot.
+		// Uses io_uring when available, otherwise the operations are executed synchronously by start().
+		class FileIoQueue
+		{
+			struct Slot
+			{
+				bool inFlight = false;
+				bool write = false;
+				void* buffer = nullptr;
+				size_t length = 0;
+				int64_t offset = 0;
+				// Bytes transferred, or negative errno
+				int64_t result = 0;
+			};
+
+			int m_fd = -1;
+			std::vector<Slot> m_slots;
+#ifdef COMLIGHT_IO_URING
+			IoRing m_ring;
+			bool m_useRing = false;
+#endif
+
+			// Complete the whole operation with pread / pwrite, retrying short transfers, stopping at end of file
+			void executeSync( Slot& s, size_t done = 0 )
+			{
+				while( done < s.length )
+				{
+					uint8_t* const pb = (uint8_t*)s.buffer + done;
+					const off_t off = (off_t)( s.offset + (int64_t)done );
+					const ssize_t cb = s.write ? pwrite( m_fd, pb, s.length - done, off ) : pread( m_fd, pb, s.length - done, off );
+					if( cb < 0 )
+					{
+						if( EINTR == errno )
+							continue;
+						s.result = -errno;
+						return;
+					}
+					if( 0 == cb )
+						break;
+					done += (size_t)cb;
+				}
+				s.result = (int64_t)done;
+			}
+
+#ifdef COMLIGHT_IO_URING
+			HRESULT reap( bool wait )
+			{
+				uint64_t userData;
+				int32_t res;
+				while( !m_ring.peek( userData, res ) )
+				{
+					if( !wait )
+						return S_OK;
+					CHECK( m_ring.submit( 1 ) );
+				}
+				do
+				{
+					if( userData >= m_slots.size() )
+						continue;
+					Slot& s = m_slots[ userData ];
+					s.inFlight = false;
+					if( -EINVAL == res || -EOPNOTSUPP == res )
+					{
+						// The kernel supports io_uring, but not these opcodes: do this one synchronously, and stop using the ring
+						m_useRing = false;
+						executeSync( s );
+					}
+					else if( res >= 0 && (size_t)res < s.length && s.write )
+						executeSync( s, (size_t)res );	// Short write, complete it synchronously
+					else
+						s.result = res;
+				}
+				while( m_ring.peek( userData, res ) );
+				return S_OK;
+			}
+#endif
+
+		public:
+
+			// The queue doesn't own the file descriptor
+			void initialize( int fd, size_t slots, bool tryRing = true )
+			{
+				m_fd = fd;
+				m_slots.resize( slots );
+#ifdef COMLIGHT_IO_URING
+				unsigned entries = 1;
+				while( entries < slots )
+					entries *= 2;
+				m_useRing = tryRing && m_ring.initialize( entries );
+#endif
+			}
+
+			// True when io_uring is used
+			bool isAsync() const
+			{
+#ifdef COMLIGHT_IO_URING
+				return m_useRing;
+#else
+				return false;
+#endif
+			}
+
+			bool inFlight( size_t slot ) const { return m_slots[ slot ].inFlight; }
+
+			// Start an operation in the slot, which must be idle. With io_uring, it's not passed to the kernel until submit() or wait().
+			HRESULT start( size_t slot, bool write, void* buffer, size_t length, int64_t offset )
+			{
+				Slot& s = m_slots[ slot ];
+				if( s.inFlight )
+					return E_UNEXPECTED;
+				s.write = write;
+				s.buffer = buffer;
+				s.length = length;
+				s.offset = offset;
+				s.result = 0;
+#ifdef COMLIGHT_IO_URING
+				if( m_useRing && length <= UINT32_MAX )
+				{
+					if( !m_ring.prepare( write, m_fd, buffer, (uint32_t)length, (uint64_t)offset, slot ) )
+					{
+						// Submission queue is full, pass the entries to the kernel and retry
+						CHECK( m_ring.submit() );
+						if( !m_ring.prepare( write, m_fd, buffer, (uint32_t)length, (uint64_t)offset, slot ) )
+							return E_UNEXPECTED;
+					}
+					s.inFlight = true;
+					return S_OK;
+				}
+#endif
+				executeSync( s );
+				return S_OK;
+			}
+
+			// Pass the started operations to the kernel, with a single system call
+			HRESULT submit()
+			{
+#ifdef COMLIGHT_IO_URING
+				if( m_useRing )
+					return m_ring.submit();
+#endif
+				return S_OK;
+			}
+
+			// Wait for the operation in the slot, get bytes transferred. Fails if the operation failed.
+			HRESULT wait( size_t slot, size_t& transferred )
+			{
+				Slot& s = m_slots[ slot ];
+#ifdef COMLIGHT_IO_URING
+				while( s.inFlight )
+					CHECK( reap( true ) );
+#endif
+				if( s.result < 0 )
+				{
+					const int e = (int)-s.result;
+					s.result = 0;
+					return hresultFromErrno( e );
+				}
+				transferred = (size_t)s.result;
+				return S_OK;
+			}
+
+			// Wait for all operations in flight. Returns the first failure.
+			HRESULT waitAll()
+			{
+				HRESULT result = S_OK;
+				for( size_t i = 0; i < m_slots.size(); i++ )
+				{
+					size_t cb;
+					const HRESULT hr = wait( i, cb );
+					if( FAILED( hr ) && SUCCEEDED( result ) )
+						result = hr;
+				}
+				return result;
+			}
+		};
+	}
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+namespace ComLight
+{
+	// Small fixed-size thread pool for blocking I/O. Jobs run in FIFO order, on whichever thread is free.
+	class IoThreadPool
+	{
+		std::mutex m_lock;
+		std::condition_variable m_wake;
+		std::deque<std::function<void()>> m_jobs;
+		std::vector<std::thread> m_threads;
+		bool m_shuttingDown = false;
+
+		void threadMain()
+		{
+			while( true )
+			{
+				std::function<void()> job;
+				{
+					std::unique_lock<std::mutex> lock( m_lock );
+					m_wake.wait( lock, [ this ]() { return m_shuttingDown || !m_jobs.empty(); } );
+					if( m_jobs.empty() )
+						return;
+					job = std::move( m_jobs.front() );
+					m_jobs.pop_front();
+				}
+				job();
+			}
+		}
+
+	public:
+
+		IoThreadPool( size_t threadsCount )
+		{
+			threadsCount = (std::max)( threadsCount, (size_t)1 );
+			m_threads.reserve( threadsCount );
+			for( size_t i = 0; i < threadsCount; i++ )
+				m_threads.emplace_back( &IoThreadPool::threadMain, this );
+		}
+
+		IoThreadPool( const IoThreadPool& ) = delete;
+
+		// Runs the jobs which are still queued, then joins the threads.
+		~IoThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock( m_lock );
+				m_shuttingDown = true;
+			}
+			m_wake.notify_all();
+			for( auto& t : m_threads )
+				t.join();
+		}
+
+		size_t threadsCount() const { return m_threads.size(); }
+
+		// Queue a job. The job must not throw exceptions.
+		void post( std::function<void()>&& job )
+		{
+			{
+				std::lock_guard<std::mutex> lock( m_lock );
+				m_jobs.emplace_back( std::move( job ) );
+			}
+			m_wake.notify_one();
+		}
+
+		// The pool shared by all asynchronous streams created without an explicit pool. Created on first use, 4 threads.
+		// Intentionally never destroyed: objects using the pool may be released by the threads of that pool, or by static destructors.
+		static IoThreadPool& shared()
+		{
+			static IoThreadPool* const pool = new IoThreadPool( 4 );
+			return *pool;
+		}
+	};
+}
\ No newline at end of file
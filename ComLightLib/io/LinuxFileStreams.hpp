@@ -0,0 +1,524 @@
+#pragma once
+#ifndef _MSC_VER
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "../comLightServer.h"
+#include "../streams.h"
+#include "IoRing.hpp"
+
+namespace ComLight
+{
+	// When the data written to LinuxFileWriteStream is made durable with fdatasync()
+	enum struct eDurability : uint8_t
+	{
+		// Never, the OS writes the page cache to disk whenever it wants. O_DIRECT writes still bypass the cache, but the drive's own cache isn't flushed.
+		None = 0,
+		// On every flush() call, and when the stream is closed
+		OnFlush = 1,
+		// Group commit: flush() writes the data, but only calls fdatasync when enough bytes or time have accumulated since the last sync, and when the stream is closed.
+		// Many small commits share a single sync. The thresholds are only checked by flush(), there's no timer: after the last flush() which skipped the sync,
+		// the data can be lost on power failure until the next flush() or until the stream is closed, however long that takes.
+		GroupCommit = 2,
+	};
+
+	struct FileReadOptions
+	{
+		// Open with O_DIRECT, bypassing the page cache. The buffer size is rounded up to the block size.
+		bool directIo = false;
+		size_t bufferSize = 1024 * 1024;
+		// Count of buffers, reads ahead are issued for all of them
+		size_t queueDepth = 4;
+		// Set to false to use pread even when io_uring is available
+		bool useIoUring = true;
+	};
+
+	struct FileWriteOptions
+	{
+		// Open with O_DIRECT, bypassing the page cache. The buffer size is rounded up to the block size.
+		bool directIo = false;
+		size_t bufferSize = 1024 * 1024;
+		// Count of buffers, up to this many writes are in flight
+		size_t queueDepth = 4;
+		// Set to false to use pwrite even when io_uring is available
+		bool useIoUring = true;
+		// When positive, reserve this many bytes of disk space with fallocate() when the file is created. Reduces fragmentation, and guarantees space.
+		int64_t preallocate = 0;
+		eDurability durability = eDurability::OnFlush;
+		// Group commit thresholds, a flush() syncs when either is exceeded
+		int64_t groupCommitBytes = 16 * 1024 * 1024;
+		uint32_t groupCommitMilliseconds = 100;
+	};
+
+	namespace details
+	{
+		// Alignment of buffers, offsets and lengths for O_DIRECT. 4kb works for all current Linux file systems and block devices.
+		constexpr size_t directIoAlignment = 4096;
+
+		struct FreeDeleter
+		{
+			void operator()( void* p ) const { free( p ); }
+		};
+		using AlignedBuffer = std::unique_ptr<uint8_t, FreeDeleter>;
+
+		inline HRESULT allocateAligned( AlignedBuffer& result, size_t cb )
+		{
+			void* p = nullptr;
+			if( 0 != posix_memalign( &p, directIoAlignment, cb ) )
+				return E_OUTOFMEMORY;
+			result.reset( (uint8_t*)p );
+			return S_OK;
+		}
+
+		inline size_t alignUp( size_t cb )
+		{
+			return ( cb + directIoAlignment - 1 ) & ~( directIoAlignment - 1 );
+		}
+
+		// State shared by the file streams: file descriptor, I/O queue, aligned buffers
+		class LinuxFileBase
+		{
+		protected:
+			int m_file = -1;
+			FileIoQueue m_queue;
+			std::vector<AlignedBuffer> m_buffers;
+			size_t m_bufferSize = 0;
+
+			HRESULT openImpl( LPCTSTR path, int flags, bool directIo, size_t bufferSize, size_t queueDepth, bool useIoUring )
+			{
+				if( m_file >= 0 )
+					return E_ALREADY_INITIALIZED;
+				if( 0 == bufferSize || 0 == queueDepth || bufferSize > ( (size_t)1 << 30 ) )
+					return E_INVALIDARG;
+				m_bufferSize = directIo ? alignUp( bufferSize ) : bufferSize;
+				m_buffers.resize( queueDepth );
+				for( auto& b : m_buffers )
+					CHECK( allocateAligned( b, m_bufferSize ) );
+
+				if( directIo )
+					flags |= O_DIRECT;
+				m_file = open( path, flags | O_CLOEXEC, 0666 );
+				if( m_file < 0 )
+					return hresultFromErrno();
+				m_queue.initialize( m_file, queueDepth, useIoUring );
+				return S_OK;
+			}
+
+			// Wait for the I/O in flight before the buffers are freed.
+			// When the wait fails with operations still in flight, the kernel may write into their buffers later: these are leaked instead of freed.
+			void waitBeforeDestroy()
+			{
+				if( SUCCEEDED( m_queue.waitAll() ) )
+					return;
+				for( size_t i = 0; i < m_buffers.size(); i++ )
+					if( m_queue.inFlight( i ) )
+						m_buffers[ i ].release();
+			}
+
+			~LinuxFileBase()
+			{
+				if( m_file >= 0 )
+					close( m_file );
+			}
+
+		public:
+
+			// True when the stream uses io_uring, false when it falls back to pread / pwrite
+			bool isAsync() const { return m_queue.isAsync(); }
+		};
+	}
+
+	// Readonly file stream for Linux. Reads ahead with up to queueDepth reads in flight, submitted to io_uring with a single system call.
+	// Buffers are cached by file offset: seeking back within the buffered window doesn't read the file again.
+	// Implements iReadStreamBatch, the buffers of a batch are filled with a single call.
+	class LinuxFileReadStream : public ObjectRoot<iReadStreamBatch>, public details::LinuxFileBase
+	{
+		// Index of the block held by each buffer, negative when the buffer is empty. Block i is the [ i * bufferSize .. ( i + 1 ) * bufferSize ) range of the file.
+		std::vector<int64_t> m_blocks;
+		// Count of valid bytes in each buffer, less than bufferSize at the end of the file
+		std::vector<size_t> m_valid;
+		int64_t m_position = 0;
+		int64_t m_length = 0;
+
+		HRESULT refreshLength()
+		{
+			struct stat st;
+			if( 0 != fstat( m_file, &st ) )
+				return details::hresultFromErrno();
+			m_length = (int64_t)st.st_size;
+			return S_OK;
+		}
+
+		// Start the read of the block into its buffer, unless it's already there or past the end of the file. Increments the counter when it started a read.
+		HRESULT schedule( int64_t block, size_t& started )
+		{
+			const size_t slot = (size_t)( block % (int64_t)m_buffers.size() );
+			if( m_blocks[ slot ] == block )
+				return S_OK;
+			const int64_t offset = block * (int64_t)m_bufferSize;
+			if( offset >= m_length )
+				return S_OK;
+			if( m_queue.inFlight( slot ) )
+			{
+				// The buffer is still receiving an older block, which we no longer need
+				size_t cb;
+				m_queue.wait( slot, cb );
+			}
+			m_blocks[ slot ] = block;
+			CHECK( m_queue.start( slot, false, m_buffers[ slot ].get(), m_bufferSize, offset ) );
+			started++;
+			return S_OK;
+		}
+
+		// Make sure the block is in the buffer, and start reading the next ones. Returns the slot, or -1 past the end of the file.
+		HRESULT loadBlock( int64_t block, int& slot )
+		{
+			slot = -1;
+			if( block * (int64_t)m_bufferSize >= m_length )
+			{
+				// The file may have grown since the last check
+				CHECK( refreshLength() );
+				if( block * (int64_t)m_bufferSize >= m_length )
+					return S_OK;
+			}
+			const int64_t count = (int64_t)m_buffers.size();
+			size_t started = 0;
+			for( int64_t i = 0; i < count; i++ )
+			{
+				const HRESULT hr = schedule( block + i, started );
+				if( FAILED( hr ) )
+				{
+					m_blocks[ (size_t)( ( block + i ) % count ) ] = -1;
+					return hr;
+				}
+			}
+			// Sequential reads mostly find the blocks already loaded or in flight, no system call for them
+			if( 0 != started )
+				CHECK( m_queue.submit() );
+
+			const size_t s = (size_t)( block % count );
+			size_t cb = 0;
+			const HRESULT hr = m_queue.wait( s, cb );
+			if( FAILED( hr ) )
+			{
+				m_blocks[ s ] = -1;
+				return hr;
+			}
+			if( m_queue.inFlight( s ) )
+				return E_UNEXPECTED;
+			m_valid[ s ] = cb;
+			slot = (int)s;
+			return S_OK;
+		}
+
+		// Copy the data from the buffers, loading them as needed. Only reads less than requested at the end of the file.
+		HRESULT readImpl( uint8_t* pb, size_t length, size_t& cbRead )
+		{
+			size_t remaining = length;
+			while( remaining > 0 )
+			{
+				const int64_t block = m_position / (int64_t)m_bufferSize;
+				const size_t offset = (size_t)( m_position % (int64_t)m_bufferSize );
+				int slot;
+				CHECK( loadBlock( block, slot ) );
+				if( slot >= 0 && offset >= m_valid[ slot ] && m_valid[ slot ] < m_bufferSize )
+				{
+					// Short read of the tail block. The file may have grown since then, read that block again.
+					m_blocks[ slot ] = -1;
+					CHECK( refreshLength() );
+					slot = -1;
+					if( m_position < m_length )
+						CHECK( loadBlock( block, slot ) );
+				}
+				if( slot < 0 || offset >= m_valid[ slot ] )
+					break;	// End of file
+				const size_t cb = std::min( remaining, m_valid[ slot ] - offset );
+				memcpy( pb, m_buffers[ slot ].get() + offset, cb );
+				pb += cb;
+				remaining -= cb;
+				m_position += (int64_t)cb;
+			}
+			cbRead = length - remaining;
+			return S_OK;
+		}
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iReadStream )
+			COM_INTERFACE_ENTRY( iReadStreamBatch )
+		END_COM_MAP()
+
+	public:
+
+		~LinuxFileReadStream()
+		{
+			waitBeforeDestroy();
+		}
+
+		HRESULT openFile( LPCTSTR path, const FileReadOptions& options = FileReadOptions{} )
+		{
+			CHECK( openImpl( path, O_RDONLY, options.directIo, options.bufferSize, options.queueDepth, options.useIoUring ) );
+			m_blocks.assign( m_buffers.size(), -1 );
+			m_valid.assign( m_buffers.size(), 0 );
+			if( !options.directIo )
+				posix_fadvise( m_file, 0, 0, POSIX_FADV_SEQUENTIAL );
+			return refreshLength();
+		}
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			if( m_file < 0 )
+				return OLE_E_BLANK;
+			if( nNumberOfBytesToRead < 0 )
+				return E_INVALIDARG;
+			size_t cb = 0;
+			CHECK( readImpl( (uint8_t*)lpBuffer, (size_t)nNumberOfBytesToRead, cb ) );
+			lpNumberOfBytesRead = (int)cb;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL readBatch( const ReadBuffer* buffers, int count, int64_t& bytesRead ) override
+		{
+			if( m_file < 0 )
+				return OLE_E_BLANK;
+			CHECK( details::validateBuffers( buffers, count ) );
+			bytesRead = 0;
+			for( int i = 0; i < count; i++ )
+			{
+				size_t cb = 0;
+				CHECK( readImpl( (uint8_t*)buffers[ i ].data, (size_t)buffers[ i ].length, cb ) );
+				bytesRead += (int64_t)cb;
+				if( cb < (size_t)buffers[ i ].length )
+					break;
+			}
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override
+		{
+			if( m_file < 0 )
+				return OLE_E_BLANK;
+			int64_t pos;
+			switch( origin )
+			{
+			case eSeekOrigin::Begin: pos = offset; break;
+			case eSeekOrigin::Current: pos = m_position + offset; break;
+			case eSeekOrigin::End:
+				CHECK( refreshLength() );
+				pos = m_length + offset;
+				break;
+			default: return E_INVALIDARG;
+			}
+			if( pos < 0 )
+				return E_INVALIDARG;
+			m_position = pos;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override
+		{
+			position = m_position;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			if( m_file < 0 )
+				return OLE_E_BLANK;
+			CHECK( refreshLength() );
+			length = m_length;
+			return S_OK;
+		}
+	};
+
+	// Write-only file stream for Linux. Full buffers are written asynchronously, up to queueDepth writes in flight, while the caller fills the next buffer.
+	// Optionally uses O_DIRECT, preallocates disk space, and syncs according to the durability policy.
+	// Implements iWriteStreamBatch, the buffers of a batch are written with a single call.
+	class LinuxFileWriteStream : public ObjectRoot<iWriteStreamBatch>, public details::LinuxFileBase
+	{
+		FileWriteOptions m_options;
+		// The buffer being filled, and count of bytes in it
+		size_t m_current = 0;
+		size_t m_fill = 0;
+		// File offset of the current buffer
+		int64_t m_offset = 0;
+		int64_t m_unsyncedBytes = 0;
+		std::chrono::steady_clock::time_point m_lastSync;
+		// First failure of an asynchronous write, reported by the next call
+		HRESULT m_status = S_OK;
+
+		// Make sure the write which used the buffer before is complete
+		HRESULT reclaim( size_t slot )
+		{
+			size_t cb;
+			const HRESULT hr = m_queue.wait( slot, cb );
+			if( FAILED( hr ) && SUCCEEDED( m_status ) )
+				m_status = hr;
+			return m_status;
+		}
+
+		HRESULT submitCurrent( size_t length )
+		{
+			CHECK( m_queue.start( m_current, true, m_buffers[ m_current ].get(), length, m_offset ) );
+			return m_queue.submit();
+		}
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iWriteStream )
+			COM_INTERFACE_ENTRY( iWriteStreamBatch )
+		END_COM_MAP()
+
+		HRESULT sync()
+		{
+			if( 0 != fdatasync( m_file ) )
+				return details::hresultFromErrno();
+			m_unsyncedBytes = 0;
+			m_lastSync = std::chrono::steady_clock::now();
+			return S_OK;
+		}
+
+		// Write the partially filled buffer, wait for all writes
+		HRESULT drain()
+		{
+			CHECK( m_status );
+			if( m_fill > 0 )
+			{
+				if( m_options.directIo )
+				{
+					// O_DIRECT needs complete blocks: write the tail padded with zeros, keep the data in the buffer, the next write of this buffer replaces the padding.
+					// The file is truncated to the correct length when closed.
+					const size_t cb = details::alignUp( m_fill );
+					memset( m_buffers[ m_current ].get() + m_fill, 0, cb - m_fill );
+					CHECK( submitCurrent( cb ) );
+					CHECK( reclaim( m_current ) );
+					if( m_fill == cb )
+					{
+						m_offset += (int64_t)m_fill;
+						m_fill = 0;
+						m_current = ( m_current + 1 ) % m_buffers.size();
+					}
+				}
+				else
+				{
+					CHECK( submitCurrent( m_fill ) );
+					m_offset += (int64_t)m_fill;
+					m_fill = 0;
+					m_current = ( m_current + 1 ) % m_buffers.size();
+				}
+			}
+			const HRESULT hr = m_queue.waitAll();
+			if( FAILED( hr ) && SUCCEEDED( m_status ) )
+				m_status = hr;
+			return m_status;
+		}
+
+		// Copy the data into the buffers, start writing the full ones
+		HRESULT writeImpl( const uint8_t* pb, size_t length )
+		{
+			size_t remaining = length;
+			while( remaining > 0 )
+			{
+				if( 0 == m_fill )
+					CHECK( reclaim( m_current ) );
+				const size_t cb = std::min( remaining, m_bufferSize - m_fill );
+				memcpy( m_buffers[ m_current ].get() + m_fill, pb, cb );
+				m_fill += cb;
+				pb += cb;
+				remaining -= cb;
+				if( m_fill < m_bufferSize )
+					break;
+
+				// The buffer is full, start writing it and move to the next one
+				CHECK( submitCurrent( m_bufferSize ) );
+				m_offset += (int64_t)m_bufferSize;
+				m_fill = 0;
+				m_current = ( m_current + 1 ) % m_buffers.size();
+			}
+			m_unsyncedBytes += (int64_t)length;
+			return S_OK;
+		}
+
+		HRESULT finish()
+		{
+			HRESULT hr = drain();
+			if( m_options.directIo && SUCCEEDED( hr ) && 0 != ftruncate( m_file, m_offset + (int64_t)m_fill ) )
+				hr = details::hresultFromErrno();
+			if( eDurability::None != m_options.durability && SUCCEEDED( hr ) && ( m_unsyncedBytes > 0 || m_options.directIo ) )
+				hr = sync();
+			return hr;
+		}
+
+	public:
+
+		~LinuxFileWriteStream()
+		{
+			if( m_file >= 0 )
+				finish();
+			waitBeforeDestroy();
+		}
+
+		HRESULT createFile( LPCTSTR path, const FileWriteOptions& options = FileWriteOptions{} )
+		{
+			if( options.preallocate < 0 || options.groupCommitBytes < 0 )
+				return E_INVALIDARG;
+			CHECK( openImpl( path, O_WRONLY | O_CREAT | O_TRUNC, options.directIo, options.bufferSize, options.queueDepth, options.useIoUring ) );
+			m_options = options;
+			m_options.bufferSize = m_bufferSize;
+			m_lastSync = std::chrono::steady_clock::now();
+			if( options.preallocate > 0 && 0 != fallocate( m_file, FALLOC_FL_KEEP_SIZE, 0, (off_t)options.preallocate ) )
+			{
+				// Not all file systems support it, the preallocation is only an optimization
+				if( EOPNOTSUPP != errno && ENOSYS != errno )
+					return details::hresultFromErrno();
+			}
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL write( const void* lpBuffer, int nNumberOfBytesToWrite ) override
+		{
+			if( m_file < 0 )
+				return OLE_E_BLANK;
+			if( nNumberOfBytesToWrite < 0 )
+				return E_INVALIDARG;
+			CHECK( m_status );
+			return writeImpl( (const uint8_t*)lpBuffer, (size_t)nNumberOfBytesToWrite );
+		}
+
+		HRESULT COMLIGHTCALL writeBatch( const WriteBuffer* buffers, int count ) override
+		{
+			if( m_file < 0 )
+				return OLE_E_BLANK;
+			CHECK( details::validateBuffers( buffers, count ) );
+			CHECK( m_status );
+			for( int i = 0; i < count; i++ )
+				CHECK( writeImpl( (const uint8_t*)buffers[ i ].data, (size_t)buffers[ i ].length ) );
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL flush() override
+		{
+			if( m_file < 0 )
+				return OLE_E_BLANK;
+			CHECK( drain() );
+			switch( m_options.durability )
+			{
+			case eDurability::OnFlush:
+				return sync();
+			case eDurability::GroupCommit:
+			{
+				const auto elapsed = std::chrono::steady_clock::now() - m_lastSync;
+				if( m_unsyncedBytes >= m_options.groupCommitBytes || elapsed >= std::chrono::milliseconds( m_options.groupCommitMilliseconds ) )
+					return sync();
+				return S_OK;
+			}
+			default:
+				return S_OK;
+			}
+		}
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,215 @@
+#pragma once
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include "../comLightServer.h"
+#include "../streams.h"
+#include "../utils/posixErrors.hpp"
+
+namespace ComLight
+{
+	// Access pattern hint for memory mapped streams, passed to madvise()
+	enum struct eAccessPattern : uint8_t
+	{
+		Normal = 0,
+		Sequential = 1,
+		Random = 2,
+		// Ask the kernel to start reading the complete file in background
+		WillNeed = 3,
+	};
+
+	namespace details
+	{
+		inline int madviseFlag( eAccessPattern pattern )
+		{
+			switch( pattern )
+			{
+			case eAccessPattern::Sequential: return MADV_SEQUENTIAL;
+			case eAccessPattern::Random: return MADV_RANDOM;
+			case eAccessPattern::WillNeed: return MADV_WILLNEED;
+			default: return MADV_NORMAL;
+			}
+		}
+	}
+
+	// Readonly stream over a memory mapped file. Linux only.
+	// Reading is a memcpy from the page cache, without a system call per chunk. Length and position are O(1), 64-bit offsets are supported.
+	// Also implements iReadStreamLending, acquireRead returns the complete remaining portion of the mapping, and iPositionalReadStream for concurrent reads.
+	class MappedReadStream : public ObjectRoot<iReadStreamLending>, public iPositionalReadStream
+	{
+		const uint8_t* m_data = nullptr;
+		int64_t m_length = 0;
+		int64_t m_position = 0;
+		bool m_acquired = false;
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iReadStream )
+			COM_INTERFACE_ENTRY( iReadStreamLending )
+			COM_INTERFACE_ENTRY( iPositionalReadStream )
+		END_COM_MAP()
+
+		void unmap()
+		{
+			if( nullptr != m_data )
+				munmap( (void*)m_data, (size_t)m_length );
+			m_data = nullptr;
+			m_length = 0;
+			m_position = 0;
+		}
+
+	public:
+
+		~MappedReadStream()
+		{
+			unmap();
+		}
+
+		HRESULT openFile( LPCTSTR path, eAccessPattern pattern = eAccessPattern::Sequential )
+		{
+			if( nullptr != m_data )
+				return E_ALREADY_INITIALIZED;
+
+			const int fd = open( path, O_RDONLY | O_CLOEXEC );
+			if( fd < 0 )
+				return details::hresultFromErrno();
+
+			struct stat st;
+			if( 0 != fstat( fd, &st ) )
+			{
+				const int e = errno;
+				close( fd );
+				return details::hresultFromErrno( e );
+			}
+
+			if( st.st_size > 0 )
+			{
+				void* const p = mmap( nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+				if( MAP_FAILED == p )
+				{
+					const int e = errno;
+					close( fd );
+					return details::hresultFromErrno( e );
+				}
+				m_data = (const uint8_t*)p;
+				m_length = (int64_t)st.st_size;
+			}
+			// The mapping keeps the file referenced, the descriptor is no longer needed
+			close( fd );
+			return adviseAccess( pattern );
+		}
+
+		// Change the access pattern hint for the whole file
+		HRESULT adviseAccess( eAccessPattern pattern )
+		{
+			return adviseAccess( pattern, 0, m_length );
+		}
+
+		// Change the access pattern hint for a range of the file
+		HRESULT adviseAccess( eAccessPattern pattern, int64_t offset, int64_t length )
+		{
+			if( nullptr == m_data )
+				return S_FALSE;
+			if( offset < 0 || length < 0 || offset + length > m_length )
+				return E_BOUNDS;
+			if( 0 == length )
+				return S_FALSE;
+			// madvise wants page-aligned address
+			const int64_t pageMask = (int64_t)sysconf( _SC_PAGESIZE ) - 1;
+			const int64_t alignedOffset = offset & ~pageMask;
+			length += offset - alignedOffset;
+			if( 0 != madvise( (void*)( m_data + alignedOffset ), (size_t)length, details::madviseFlag( pattern ) ) )
+				return details::hresultFromErrno();
+			return S_OK;
+		}
+
+		// The complete content of the file
+		const uint8_t* data() const { return m_data; }
+		int64_t size() const { return m_length; }
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			if( nNumberOfBytesToRead < 0 )
+				return E_INVALIDARG;
+			const int64_t cb = std::max( std::min( (int64_t)nNumberOfBytesToRead, m_length - m_position ), (int64_t)0 );
+			if( cb > 0 )
+			{
+				memcpy( lpBuffer, m_data + m_position, (size_t)cb );
+				m_position += cb;
+			}
+			lpNumberOfBytesRead = (int)cb;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override
+		{
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			int64_t pos;
+			switch( origin )
+			{
+			case eSeekOrigin::Begin: pos = offset; break;
+			case eSeekOrigin::Current: pos = m_position + offset; break;
+			case eSeekOrigin::End: pos = m_length + offset; break;
+			default: return E_INVALIDARG;
+			}
+			if( pos < 0 )
+				return E_INVALIDARG;
+			m_position = pos;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override
+		{
+			position = m_position;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			length = m_length;
+			return S_OK;
+		}
+
+		// Doesn't use the cursor, safe to call concurrently from multiple threads
+		HRESULT COMLIGHTCALL readAt( int64_t offset, void* buffer, int64_t length, int64_t& bytesRead ) override
+		{
+			if( offset < 0 || length < 0 )
+				return E_INVALIDARG;
+			const int64_t cb = std::max( std::min( length, m_length - offset ), (int64_t)0 );
+			if( cb > 0 )
+				memcpy( buffer, m_data + offset, (size_t)cb );
+			bytesRead = cb;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL acquireRead( const void** ppData, int64_t& length ) override
+		{
+			if( nullptr == ppData )
+				return E_POINTER;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			const int64_t cb = std::max( m_length - m_position, (int64_t)0 );
+			*ppData = ( cb > 0 ) ? m_data + m_position : nullptr;
+			length = cb;
+			m_acquired = true;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL releaseRead( int64_t consumed ) override
+		{
+			if( !m_acquired )
+				return E_UNEXPECTED;
+			if( consumed < 0 || consumed > std::max( m_length - m_position, (int64_t)0 ) )
+				return E_BOUNDS;
+			m_position += consumed;
+			m_acquired = false;
+			return S_OK;
+		}
+	};
+}
+#endif
\ No newline at end of file
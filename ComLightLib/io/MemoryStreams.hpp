@@ -0,0 +1,271 @@
+#pragma once
+#include <string.h>
+#include "../comLightServer.h"
+#include "../streams.h"
+#include "StreamBatchTearOffs.hpp"
+
+namespace ComLight
+{
+	// Readonly stream over a block of memory. Lends pointers into that memory, iReadStreamLending::acquireRead returns all the remaining data at once.
+	// Also implements iPositionalReadStream, readAt calls are thread safe, the memory is never modified, and iReadStreamBatch with a tear-off.
+	class MemoryReadStream : public ObjectRoot<iReadStreamLending>, public iPositionalReadStream
+	{
+		std::vector<uint8_t> m_owned;
+		CComPtr<IUnknown> m_owner;
+		const uint8_t* m_data = nullptr;
+		int64_t m_length = 0;
+		int64_t m_position = 0;
+		bool m_acquired = false;
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iReadStream )
+			COM_INTERFACE_ENTRY( iReadStreamLending )
+			COM_INTERFACE_ENTRY( iPositionalReadStream )
+			COM_INTERFACE_ENTRY_TEAR_OFF( iReadStreamBatch, ReadStreamBatchTearOff<MemoryReadStream> )
+		END_COM_MAP()
+
+	public:
+
+		// Take ownership of the vector
+		HRESULT initialize( std::vector<uint8_t>&& data )
+		{
+			m_owned.swap( data );
+			m_owner.release();
+			m_data = m_owned.data();
+			m_length = (int64_t)m_owned.size();
+			m_position = 0;
+			return S_OK;
+		}
+
+		// Wrap external memory without copying. When the owner is not nullptr, the stream keeps a reference to it, otherwise the caller must keep the memory alive.
+		HRESULT initialize( const void* data, int64_t length, IUnknown* owner = nullptr )
+		{
+			if( length < 0 || ( nullptr == data && 0 != length ) )
+				return E_INVALIDARG;
+			std::vector<uint8_t>().swap( m_owned );
+			m_owner = owner;
+			m_data = (const uint8_t*)data;
+			m_length = length;
+			m_position = 0;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			if( nNumberOfBytesToRead < 0 )
+				return E_INVALIDARG;
+			const int64_t cb = (std::min)( (int64_t)nNumberOfBytesToRead, m_length - m_position );
+			if( cb > 0 )
+			{
+				memcpy( lpBuffer, m_data + m_position, (size_t)cb );
+				m_position += cb;
+			}
+			lpNumberOfBytesRead = (int)(std::max)( cb, (int64_t)0 );
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override
+		{
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			int64_t pos;
+			switch( origin )
+			{
+			case eSeekOrigin::Begin: pos = offset; break;
+			case eSeekOrigin::Current: pos = m_position + offset; break;
+			case eSeekOrigin::End: pos = m_length + offset; break;
+			default: return E_INVALIDARG;
+			}
+			if( pos < 0 )
+				return E_INVALIDARG;
+			m_position = pos;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override
+		{
+			position = m_position;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			length = m_length;
+			return S_OK;
+		}
+
+		// Implements iReadStreamBatch::readBatch, called by the tear-off
+		HRESULT readBatch( const ReadBuffer* buffers, int count, int64_t& bytesRead )
+		{
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			CHECK( details::validateBuffers( buffers, count ) );
+			bytesRead = 0;
+			for( int i = 0; i < count; i++ )
+			{
+				const int64_t cb = (std::min)( buffers[ i ].length, (std::max)( m_length - m_position, (int64_t)0 ) );
+				if( cb > 0 )
+				{
+					memcpy( buffers[ i ].data, m_data + m_position, (size_t)cb );
+					m_position += cb;
+					bytesRead += cb;
+				}
+				if( cb < buffers[ i ].length )
+					break;
+			}
+			return S_OK;
+		}
+
+		// Doesn't use the cursor, safe to call concurrently from multiple threads
+		HRESULT COMLIGHTCALL readAt( int64_t offset, void* buffer, int64_t length, int64_t& bytesRead ) override
+		{
+			if( offset < 0 || length < 0 )
+				return E_INVALIDARG;
+			const int64_t cb = (std::max)( (std::min)( length, m_length - offset ), (int64_t)0 );
+			if( cb > 0 )
+				memcpy( buffer, m_data + offset, (size_t)cb );
+			bytesRead = cb;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL acquireRead( const void** ppData, int64_t& length ) override
+		{
+			if( nullptr == ppData )
+				return E_POINTER;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			const int64_t cb = (std::max)( m_length - m_position, (int64_t)0 );
+			*ppData = ( cb > 0 ) ? m_data + m_position : nullptr;
+			length = cb;
+			m_acquired = true;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL releaseRead( int64_t consumed ) override
+		{
+			if( !m_acquired )
+				return E_UNEXPECTED;
+			if( consumed < 0 || consumed > (std::max)( m_length - m_position, (int64_t)0 ) )
+				return E_BOUNDS;
+			m_position += consumed;
+			m_acquired = false;
+			return S_OK;
+		}
+	};
+
+	// Write stream which accumulates the data in memory. Lends pointers into the internal buffer, growing it as needed.
+	// Also implements iWriteStreamBatch with a tear-off, the buffer grows at most once per batch.
+	class MemoryWriteStream : public ObjectRoot<iWriteStreamLending>
+	{
+		std::vector<uint8_t> m_buffer;
+		// Count of bytes written, the vector is usually larger than that
+		size_t m_length = 0;
+		bool m_acquired = false;
+
+		HRESULT ensureCapacity( size_t cb )
+		{
+			if( m_buffer.size() >= cb )
+				return S_OK;
+			try
+			{
+				m_buffer.resize( (std::max)( cb, m_buffer.size() * 2 ) );
+				return S_OK;
+			}
+			catch( const std::bad_alloc& )
+			{
+				return E_OUTOFMEMORY;
+			}
+		}
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iWriteStream )
+			COM_INTERFACE_ENTRY( iWriteStreamLending )
+			COM_INTERFACE_ENTRY_TEAR_OFF( iWriteStreamBatch, WriteStreamBatchTearOff<MemoryWriteStream> )
+		END_COM_MAP()
+
+	public:
+
+		HRESULT COMLIGHTCALL write( const void* lpBuffer, int nNumberOfBytesToWrite ) override
+		{
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			if( nNumberOfBytesToWrite < 0 )
+				return E_INVALIDARG;
+			const size_t cb = (size_t)nNumberOfBytesToWrite;
+			CHECK( ensureCapacity( m_length + cb ) );
+			memcpy( m_buffer.data() + m_length, lpBuffer, cb );
+			m_length += cb;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL flush() override
+		{
+			return S_OK;
+		}
+
+		// Implements iWriteStreamBatch::writeBatch, called by the tear-off
+		HRESULT writeBatch( const WriteBuffer* buffers, int count )
+		{
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			CHECK( details::validateBuffers( buffers, count ) );
+			size_t total = m_length;
+			for( int i = 0; i < count; i++ )
+			{
+				if( (uint64_t)buffers[ i ].length > SIZE_MAX - total )
+					return E_OUTOFMEMORY;
+				total += (size_t)buffers[ i ].length;
+			}
+			CHECK( ensureCapacity( total ) );
+			for( int i = 0; i < count; i++ )
+			{
+				const size_t cb = (size_t)buffers[ i ].length;
+				if( 0 == cb )
+					continue;
+				memcpy( m_buffer.data() + m_length, buffers[ i ].data, cb );
+				m_length += cb;
+			}
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL acquireWrite( int64_t minLength, void** ppData, int64_t& length ) override
+		{
+			if( nullptr == ppData )
+				return E_POINTER;
+			if( minLength < 0 )
+				return E_INVALIDARG;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			CHECK( ensureCapacity( m_length + (std::max)( (size_t)minLength, (size_t)1 ) ) );
+			*ppData = m_buffer.data() + m_length;
+			length = (int64_t)( m_buffer.size() - m_length );
+			m_acquired = true;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL commitWrite( int64_t written ) override
+		{
+			if( !m_acquired )
+				return E_UNEXPECTED;
+			if( written < 0 || (size_t)written > m_buffer.size() - m_length )
+				return E_BOUNDS;
+			m_length += (size_t)written;
+			m_acquired = false;
+			return S_OK;
+		}
+
+		const uint8_t* data() const { return m_buffer.data(); }
+		size_t size() const { return m_length; }
+
+		// Move the data out of the stream, and reset the stream to empty state
+		void detach( std::vector<uint8_t>& result )
+		{
+			m_buffer.resize( m_length );
+			result.swap( m_buffer );
+			std::vector<uint8_t>().swap( m_buffer );
+			m_length = 0;
+		}
+	};
+}
\ No newline at end of file
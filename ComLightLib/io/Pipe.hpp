@@ -0,0 +1,276 @@
+#pragma once
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "../comLightServer.h"
+#include "../streams.h"
+
+namespace ComLight
+{
+	enum struct ePipeMode : uint8_t
+	{
+		// Writes wait for free space, reads wait until the requested count of bytes is available, or the write end is released
+		Blocking = 0,
+		// Writes fail with E_PENDING unless the complete buffer fits, reads fail with E_PENDING when the pipe is empty and the write end is still alive
+		NonBlocking = 1,
+	};
+
+	namespace details
+	{
+		// Bounded single-producer single-consumer ring buffer shared by both ends of a pipe.
+		// Transferring data doesn't lock anything; the mutex and condition variables are only used when one side needs to sleep.
+		class PipeState
+		{
+			std::vector<uint8_t> m_buffer;
+			const uint64_t m_mask;
+
+			// Total count of bytes ever written and read. Each is only modified by one side, padded to separate cache lines to avoid false sharing.
+			// Padding instead of alignas, C++14 operator new doesn't support over-aligned types.
+			uint8_t m_pad0[ 64 ];
+			std::atomic<uint64_t> m_written;
+			uint8_t m_pad1[ 64 ];
+			std::atomic<uint64_t> m_read;
+			uint8_t m_pad2[ 64 ];
+
+			std::atomic_bool m_writerClosed, m_readerClosed;
+			std::atomic_bool m_writerWaiting, m_readerWaiting;
+			std::mutex m_lock;
+			std::condition_variable m_cv;
+
+			void wake( std::atomic_bool& waiting )
+			{
+				if( !waiting.load() )
+					return;
+				std::lock_guard<std::mutex> lock( m_lock );
+				m_cv.notify_all();
+			}
+
+			// Sleep until the predicate returns true. The flag + recheck protocol ensures the other side never skips the notification.
+			template<class Pred>
+			void sleep( std::atomic_bool& waiting, Pred pred )
+			{
+				std::unique_lock<std::mutex> lock( m_lock );
+				waiting.store( true );
+				while( !pred() )
+					m_cv.wait( lock );
+				waiting.store( false );
+			}
+
+		public:
+
+			const ePipeMode mode;
+
+			PipeState( size_t capacity, ePipeMode m ) :
+				m_buffer( capacity ), m_mask( capacity - 1 ),
+				m_written( 0 ), m_read( 0 ),
+				m_writerClosed( false ), m_readerClosed( false ),
+				m_writerWaiting( false ), m_readerWaiting( false ),
+				mode( m )
+			{ }
+
+			size_t capacity() const { return m_buffer.size(); }
+
+			// Write all the data, or fail. Only called by the write end.
+			HRESULT write( const uint8_t* pb, size_t cb )
+			{
+				const size_t cap = m_buffer.size();
+				if( ePipeMode::NonBlocking == mode )
+				{
+					if( cb > cap )
+						return E_BOUNDS;
+					if( m_readerClosed.load() )
+						return E_BROKEN_PIPE;
+					if( cb > cap - (size_t)( m_written.load( std::memory_order_relaxed ) - m_read.load( std::memory_order_acquire ) ) )
+						return E_PENDING;
+				}
+
+				while( cb > 0 )
+				{
+					if( m_readerClosed.load() )
+						return E_BROKEN_PIPE;
+					const uint64_t w = m_written.load( std::memory_order_relaxed );
+					size_t free = cap - (size_t)( w - m_read.load( std::memory_order_acquire ) );
+					if( 0 == free )
+					{
+						sleep( m_writerWaiting, [ this, w, cap ]() { return m_readerClosed.load() || w - m_read.load() < cap; } );
+						continue;
+					}
+
+					const size_t chunk = (std::min)( cb, free );
+					const size_t offset = (size_t)( w & m_mask );
+					const size_t first = (std::min)( chunk, cap - offset );
+					memcpy( m_buffer.data() + offset, pb, first );
+					memcpy( m_buffer.data(), pb + first, chunk - first );
+					m_written.store( w + chunk );
+					wake( m_readerWaiting );
+					pb += chunk;
+					cb -= chunk;
+				}
+				return S_OK;
+			}
+
+			// Read the data. Only called by the read end.
+			HRESULT read( uint8_t* pb, size_t cb, size_t& cbRead )
+			{
+				const size_t cap = m_buffer.size();
+				cbRead = 0;
+				while( cb > 0 )
+				{
+					const uint64_t r = m_read.load( std::memory_order_relaxed );
+					const size_t available = (size_t)( m_written.load( std::memory_order_acquire ) - r );
+					if( 0 == available )
+					{
+						// Check for EOF after observing the empty buffer: the writer publishes the data before it sets the closed flag
+						if( m_writerClosed.load() && r == m_written.load() )
+							return S_OK;
+						if( ePipeMode::NonBlocking == mode )
+							return ( 0 == cbRead ) ? E_PENDING : S_OK;
+						sleep( m_readerWaiting, [ this, r ]() { return m_writerClosed.load() || m_written.load() != r; } );
+						continue;
+					}
+
+					const size_t chunk = (std::min)( cb, available );
+					const size_t offset = (size_t)( r & m_mask );
+					const size_t first = (std::min)( chunk, cap - offset );
+					memcpy( pb, m_buffer.data() + offset, first );
+					memcpy( pb + first, m_buffer.data(), chunk - first );
+					m_read.store( r + chunk );
+					wake( m_writerWaiting );
+					pb += chunk;
+					cb -= chunk;
+					cbRead += chunk;
+				}
+				return S_OK;
+			}
+
+			uint64_t bytesRead() const { return m_read.load( std::memory_order_relaxed ); }
+
+			void closeWriter()
+			{
+				m_writerClosed.store( true );
+				std::lock_guard<std::mutex> lock( m_lock );
+				m_cv.notify_all();
+			}
+
+			void closeReader()
+			{
+				m_readerClosed.store( true );
+				std::lock_guard<std::mutex> lock( m_lock );
+				m_cv.notify_all();
+			}
+		};
+
+		// Write end of the pipe. Releasing the last reference signals end of stream to the reader.
+		class PipeWriteEnd : public ObjectRoot<iWriteStream>
+		{
+			std::shared_ptr<PipeState> m_state;
+
+		public:
+
+			void initialize( const std::shared_ptr<PipeState>& state ) { m_state = state; }
+
+			~PipeWriteEnd()
+			{
+				if( m_state )
+					m_state->closeWriter();
+			}
+
+			HRESULT COMLIGHTCALL write( const void* lpBuffer, int nNumberOfBytesToWrite ) override
+			{
+				if( nNumberOfBytesToWrite < 0 )
+					return E_INVALIDARG;
+				return m_state->write( (const uint8_t*)lpBuffer, (size_t)nNumberOfBytesToWrite );
+			}
+
+			// The written data is visible to the reader as soon as write returns, nothing to flush
+			HRESULT COMLIGHTCALL flush() override
+			{
+				return S_OK;
+			}
+		};
+
+		// Read end of the pipe. Releasing the last reference makes further writes fail with E_BROKEN_PIPE.
+		class PipeReadEnd : public ObjectRoot<iReadStream>
+		{
+			std::shared_ptr<PipeState> m_state;
+
+		public:
+
+			void initialize( const std::shared_ptr<PipeState>& state ) { m_state = state; }
+
+			~PipeReadEnd()
+			{
+				if( m_state )
+					m_state->closeReader();
+			}
+
+			HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+			{
+				if( nNumberOfBytesToRead < 0 )
+					return E_INVALIDARG;
+				size_t cb = 0;
+				const HRESULT hr = m_state->read( (uint8_t*)lpBuffer, (size_t)nNumberOfBytesToRead, cb );
+				lpNumberOfBytesRead = (int)cb;
+				return hr;
+			}
+
+			HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override
+			{
+				return E_NOTIMPL;
+			}
+
+			// Total count of bytes read from the pipe
+			HRESULT COMLIGHTCALL getPosition( int64_t& position ) override
+			{
+				position = (int64_t)m_state->bytesRead();
+				return S_OK;
+			}
+
+			// The length of a pipe is unknown until the writer is done
+			HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+			{
+				return E_NOTIMPL;
+			}
+		};
+	}
+
+	// Create an in-process pipe with bounded memory. Capacity is rounded up to a power of 2.
+	// Each end supports one thread at a time: one producer thread writes, one consumer thread reads, possibly on the other side of the interop.
+	inline HRESULT createPipe( size_t capacity, ePipeMode mode, iWriteStream** ppWrite, iReadStream** ppRead )
+	{
+		if( nullptr == ppWrite || nullptr == ppRead )
+			return E_POINTER;
+		// 1TB, or the largest power of 2 in size_t on 32-bit platforms
+		constexpr uint64_t maxCapacity = (std::min)( (uint64_t)1 << 40, (uint64_t)( SIZE_MAX / 2 ) + 1 );
+		if( 0 == capacity || (uint64_t)capacity > maxCapacity )
+			return E_INVALIDARG;
+		size_t cap = 1;
+		while( cap < capacity )
+			cap *= 2;
+
+		std::shared_ptr<details::PipeState> state;
+		try
+		{
+			state = std::make_shared<details::PipeState>( cap, mode );
+		}
+		catch( const std::bad_alloc& )
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		CComPtr<Object<details::PipeWriteEnd>> writeEnd;
+		CComPtr<Object<details::PipeReadEnd>> readEnd;
+		CHECK( Object<details::PipeWriteEnd>::create( writeEnd ) );
+		CHECK( Object<details::PipeReadEnd>::create( readEnd ) );
+		writeEnd->initialize( state );
+		readEnd->initialize( state );
+		writeEnd.detach( ppWrite );
+		readEnd.detach( ppRead );
+		return S_OK;
+	}
+}
\ No newline at end of file
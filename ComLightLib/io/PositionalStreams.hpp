@@ -0,0 +1,256 @@
+#pragma once
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../utils/posixErrors.hpp"
+#endif
+#include "../comLightServer.h"
+#include "../streams.h"
+
+namespace ComLight
+{
+	// Readonly file which is read with positional reads: pread() on Linux, ReadFile with an offset in OVERLAPPED structure on Windows.
+	// The object has no cursor, any number of threads can read from it concurrently. Use ReadStreamView to get cursors.
+	class PositionalFileStream : public ObjectRoot<iPositionalReadStream>
+	{
+#ifdef _MSC_VER
+		HANDLE m_file = INVALID_HANDLE_VALUE;
+
+		bool isOpen() const { return INVALID_HANDLE_VALUE != m_file; }
+#else
+		int m_file = -1;
+
+		bool isOpen() const { return m_file >= 0; }
+#endif
+
+		// Single read system call, at most 1GB
+		HRESULT readOnce( int64_t offset, void* buffer, size_t length, size_t& cbRead )
+		{
+			length = (std::min)( length, (size_t)1 << 30 );
+#ifdef _MSC_VER
+			// The handle is opened for overlapped I/O, the file pointer isn't used and the concurrent reads don't serialize on the handle.
+			// Each call has its own event: the handle itself is signaled by the completion of any read.
+			OVERLAPPED ov{};
+			ov.Offset = (DWORD)offset;
+			ov.OffsetHigh = (DWORD)( offset >> 32 );
+			ov.hEvent = CreateEventW( nullptr, TRUE, FALSE, nullptr );
+			if( nullptr == ov.hEvent )
+				return HRESULT_FROM_WIN32( GetLastError() );
+			DWORD cb = 0;
+			DWORD err = ERROR_SUCCESS;
+			if( !ReadFile( m_file, buffer, (DWORD)length, nullptr, &ov ) )
+				err = GetLastError();
+			if( ERROR_SUCCESS == err || ERROR_IO_PENDING == err )
+			{
+				err = ERROR_SUCCESS;
+				if( !GetOverlappedResult( m_file, &ov, &cb, TRUE ) )
+					err = GetLastError();
+			}
+			CloseHandle( ov.hEvent );
+			if( ERROR_SUCCESS != err && ERROR_HANDLE_EOF != err )
+				return HRESULT_FROM_WIN32( err );
+			cbRead = cb;
+			return S_OK;
+#else
+			while( true )
+			{
+				const ssize_t cb = pread( m_file, buffer, length, (off_t)offset );
+				if( cb >= 0 )
+				{
+					cbRead = (size_t)cb;
+					return S_OK;
+				}
+				if( EINTR != errno )
+					return details::hresultFromErrno();
+			}
+#endif
+		}
+
+	public:
+
+		~PositionalFileStream()
+		{
+			if( !isOpen() )
+				return;
+#ifdef _MSC_VER
+			CloseHandle( m_file );
+#else
+			close( m_file );
+#endif
+		}
+
+		HRESULT openFile( LPCTSTR path )
+		{
+			if( isOpen() )
+				return E_ALREADY_INITIALIZED;
+#ifdef _MSC_VER
+			m_file = CreateFileW( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr );
+			if( INVALID_HANDLE_VALUE == m_file )
+				return HRESULT_FROM_WIN32( GetLastError() );
+#else
+			m_file = open( path, O_RDONLY | O_CLOEXEC );
+			if( m_file < 0 )
+				return details::hresultFromErrno();
+#endif
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL readAt( int64_t offset, void* buffer, int64_t length, int64_t& bytesRead ) override
+		{
+			if( !isOpen() )
+				return OLE_E_BLANK;
+			if( offset < 0 || length < 0 )
+				return E_INVALIDARG;
+			if( nullptr == buffer && 0 != length )
+				return E_POINTER;
+			bytesRead = 0;
+			uint8_t* pb = (uint8_t*)buffer;
+			while( length > 0 )
+			{
+				size_t cb = 0;
+				CHECK( readOnce( offset, pb, (size_t)length, cb ) );
+				if( 0 == cb )
+					break;
+				bytesRead += (int64_t)cb;
+				offset += (int64_t)cb;
+				pb += cb;
+				length -= (int64_t)cb;
+			}
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			if( !isOpen() )
+				return OLE_E_BLANK;
+#ifdef _MSC_VER
+			LARGE_INTEGER li;
+			if( !GetFileSizeEx( m_file, &li ) )
+				return HRESULT_FROM_WIN32( GetLastError() );
+			length = li.QuadPart;
+#else
+			struct stat st;
+			if( 0 != fstat( m_file, &st ) )
+				return details::hresultFromErrno();
+			length = (int64_t)st.st_size;
+#endif
+			return S_OK;
+		}
+	};
+
+	// Sub-range of a positional stream. Implements iPositionalReadStream relative to the start of the range, and iReadStream with a cursor of its own.
+	// Create one view per thread to consume a shared stream with the sequential API: the cursors are independent, the source is never seeked.
+	// readAt is thread safe if the source is. The methods of iReadStream are not, like any other cursor.
+	class ReadStreamView : public ObjectRoot<iPositionalReadStream>, public iReadStream
+	{
+		CComPtr<iPositionalReadStream> m_source;
+		int64_t m_offset = 0;
+		int64_t m_length = 0;
+		int64_t m_position = 0;
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iPositionalReadStream )
+			COM_INTERFACE_ENTRY( iReadStream )
+		END_COM_MAP()
+
+	public:
+
+		// When the length is negative, the view extends to the end of the source
+		HRESULT initialize( iPositionalReadStream* source, int64_t offset = 0, int64_t length = -1 )
+		{
+			if( nullptr == source )
+				return E_POINTER;
+			if( m_source )
+				return E_ALREADY_INITIALIZED;
+			if( offset < 0 )
+				return E_INVALIDARG;
+			int64_t sourceLength;
+			CHECK( source->getLength( sourceLength ) );
+			if( offset > sourceLength )
+				return E_BOUNDS;
+			if( length < 0 )
+				length = sourceLength - offset;
+			else if( length > sourceLength - offset )
+				return E_BOUNDS;
+			m_source = source;
+			m_offset = offset;
+			m_length = length;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL readAt( int64_t offset, void* buffer, int64_t length, int64_t& bytesRead ) override
+		{
+			if( !m_source )
+				return OLE_E_BLANK;
+			if( offset < 0 || length < 0 )
+				return E_INVALIDARG;
+			bytesRead = 0;
+			if( offset >= m_length )
+				return S_OK;
+			return m_source->readAt( m_offset + offset, buffer, (std::min)( length, m_length - offset ), bytesRead );
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			if( !m_source )
+				return OLE_E_BLANK;
+			length = m_length;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			if( nNumberOfBytesToRead < 0 )
+				return E_INVALIDARG;
+			int64_t cb = 0;
+			CHECK( readAt( m_position, lpBuffer, nNumberOfBytesToRead, cb ) );
+			m_position += cb;
+			lpNumberOfBytesRead = (int)cb;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override
+		{
+			if( !m_source )
+				return OLE_E_BLANK;
+			int64_t pos;
+			switch( origin )
+			{
+			case eSeekOrigin::Begin: pos = offset; break;
+			case eSeekOrigin::Current: pos = m_position + offset; break;
+			case eSeekOrigin::End: pos = m_length + offset; break;
+			default: return E_INVALIDARG;
+			}
+			if( pos < 0 )
+				return E_INVALIDARG;
+			m_position = pos;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override
+		{
+			position = m_position;
+			return S_OK;
+		}
+	};
+
+	// Create a view of the [ offset .. offset + length ) range of the source stream. Negative length means until the end of the source.
+	inline HRESULT createStreamView( iPositionalReadStream* source, int64_t offset, int64_t length, iReadStream** pp )
+	{
+		if( nullptr == pp )
+			return E_POINTER;
+		CComPtr<Object<ReadStreamView>> view;
+		CHECK( Object<ReadStreamView>::create( view ) );
+		CHECK( view->initialize( source, offset, length ) );
+		iReadStream* const result = view;
+		result->AddRef();
+		*pp = result;
+		return S_OK;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,328 @@
+#pragma once
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "../comLightServer.h"
+#include "../streams.h"
+#include "BufferedStreams.hpp"
+
+namespace ComLight
+{
+	// Wraps an arbitrary readonly stream, typically implemented in .NET, with read-ahead on a background thread.
+	// The thread keeps reading blocks of the source into a ring while the consumer processes the previous ones, hiding the latency of the source.
+	// The count of blocks read ahead adapts to the ratio between the time the source takes to deliver a block, and the time the consumer takes to process one.
+	// A successful seek drops the prefetched data, a failed one keeps it. The methods of the wrapper are not thread safe, the source is only called by one thread at a time.
+	class PrefetchReadStream : public ObjectRoot<iReadStream>
+	{
+		using Clock = std::chrono::steady_clock;
+
+		struct Block
+		{
+			std::vector<uint8_t> data;
+			size_t length = 0;
+		};
+
+		CComPtr<iReadStream> m_source;
+		size_t m_blockSize = 0;
+		std::vector<Block> m_blocks;
+
+		std::mutex m_lock;
+		std::condition_variable m_wakeWorker, m_wakeConsumer;
+		std::thread m_thread;
+
+		// The fields below are protected by the lock
+		// Sequence numbers of the first block not yet consumed, and of the next block to read. The blocks in [ m_head .. m_tail ) range are filled.
+		uint64_t m_head = 0, m_tail = 0;
+		// Count of blocks the worker keeps ahead of the consumer
+		size_t m_window = 2;
+		// Exponential moving averages of nanoseconds per block: reading from the source, and processing by the consumer
+		double m_readTime = 0, m_consumeTime = 0;
+		// Set by the worker on end of stream or failure, cleared by seek
+		bool m_sourceDone = false;
+		HRESULT m_status = S_OK;
+		// The worker is calling the source
+		bool m_busy = false;
+		// The consumer needs exclusive access to the source
+		bool m_paused = false;
+		bool m_shutdown = false;
+
+		// The fields below are only used by the consumer
+		// True when the block m_head is being consumed, m_offset is the position inside that block
+		bool m_hasCurrent = false;
+		size_t m_offset = 0;
+		const Block* m_current = nullptr;
+		// When the consumer got the current block, default-constructed after seek
+		Clock::time_point m_acquired;
+
+		static void updateAverage( double& avg, double sample )
+		{
+			avg = ( avg > 0 ) ? avg * 0.75 + sample * 0.25 : sample;
+		}
+
+		// Window size which covers the source latency: while the consumer processes one block, the source needs to deliver readTime / consumeTime blocks
+		void adaptWindow()
+		{
+			if( m_readTime <= 0 || m_consumeTime <= 0 )
+				return;
+			const double ratio = std::ceil( m_readTime / m_consumeTime ) + 1;
+			const double maxBlocks = (double)m_blocks.size();
+			m_window = (size_t)(std::min)( (std::max)( ratio, 2.0 ), maxBlocks );
+		}
+
+		void workerMain()
+		{
+			std::unique_lock<std::mutex> lock( m_lock );
+			while( true )
+			{
+				m_wakeWorker.wait( lock, [ this ]() { return m_shutdown || ( !m_paused && !m_sourceDone && m_tail - m_head < m_window ); } );
+				if( m_shutdown )
+					return;
+
+				const uint64_t seq = m_tail;
+				Block& block = m_blocks[ (size_t)( seq % m_blocks.size() ) ];
+				m_busy = true;
+				lock.unlock();
+
+				HRESULT hr = S_OK;
+				int cb = 0;
+				const auto start = Clock::now();
+				try
+				{
+					if( block.data.empty() )
+						block.data.resize( m_blockSize );
+				}
+				catch( const std::bad_alloc& )
+				{
+					hr = E_OUTOFMEMORY;
+				}
+				if( SUCCEEDED( hr ) )
+					hr = m_source->read( block.data.data(), (int)m_blockSize, cb );
+				const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+
+				lock.lock();
+				m_busy = false;
+				if( FAILED( hr ) )
+				{
+					m_status = hr;
+					m_sourceDone = true;
+				}
+				else if( cb <= 0 )
+					m_sourceDone = true;
+				else
+				{
+					block.length = (size_t)cb;
+					m_tail = seq + 1;
+					// Short reads are not representative of the source latency
+					if( (size_t)cb == m_blockSize )
+						updateAverage( m_readTime, elapsed.count() );
+				}
+				m_wakeConsumer.notify_all();
+			}
+		}
+
+		// Wait for the worker to finish the source call in progress, and prevent it from starting another one
+		void pauseWorker( std::unique_lock<std::mutex>& lock )
+		{
+			m_paused = true;
+			m_wakeConsumer.wait( lock, [ this ]() { return !m_busy; } );
+		}
+
+		void resumeWorker()
+		{
+			m_paused = false;
+			m_wakeWorker.notify_one();
+		}
+
+		// Count of prefetched bytes not yet consumed, the position of the source is ahead of the stream by that amount
+		int64_t bufferedBytes() const
+		{
+			int64_t res = 0;
+			for( uint64_t i = m_head; i < m_tail; i++ )
+				res += (int64_t)m_blocks[ (size_t)( i % m_blocks.size() ) ].length;
+			if( m_hasCurrent )
+				res -= (int64_t)m_offset;
+			return res;
+		}
+
+		// Drop the prefetched data, called with the worker paused
+		void discardBlocks()
+		{
+			m_head = m_tail;
+			m_hasCurrent = false;
+			m_offset = 0;
+			m_current = nullptr;
+			m_sourceDone = false;
+			m_status = S_OK;
+			m_acquired = Clock::time_point{};
+		}
+
+		// Release the consumed block, and wait for the next one. Returns S_FALSE on end of stream.
+		HRESULT nextBlock()
+		{
+			const auto now = Clock::now();
+			std::unique_lock<std::mutex> lock( m_lock );
+			if( m_hasCurrent )
+			{
+				m_head++;
+				m_hasCurrent = false;
+				m_current = nullptr;
+				m_offset = 0;
+				m_wakeWorker.notify_one();
+				if( m_acquired != Clock::time_point{} )
+				{
+					// The time waiting for the source is excluded, the measure is how fast the consumer processes the data
+					const std::chrono::duration<double, std::nano> elapsed = now - m_acquired;
+					updateAverage( m_consumeTime, elapsed.count() );
+					adaptWindow();
+				}
+			}
+
+			m_wakeConsumer.wait( lock, [ this ]() { return m_tail > m_head || m_sourceDone; } );
+			m_acquired = Clock::now();
+			if( m_tail > m_head )
+			{
+				m_current = &m_blocks[ (size_t)( m_head % m_blocks.size() ) ];
+				m_hasCurrent = true;
+				return S_OK;
+			}
+			return FAILED( m_status ) ? m_status : S_FALSE;
+		}
+
+	public:
+
+		~PrefetchReadStream()
+		{
+			if( !m_thread.joinable() )
+				return;
+			{
+				std::lock_guard<std::mutex> lock( m_lock );
+				m_shutdown = true;
+			}
+			m_wakeWorker.notify_one();
+			// When the worker is blocked in a read of the source, e.g. reading from a pipe, this waits for that read to complete
+			m_thread.join();
+		}
+
+		// Start prefetching the source from its current position. The memory use is up to blockSize * maxBlocks.
+		HRESULT initialize( iReadStream* source, size_t blockSize = details::defaultStreamBufferSize, size_t maxBlocks = 16 )
+		{
+			if( nullptr == source )
+				return E_POINTER;
+			if( m_source )
+				return E_ALREADY_INITIALIZED;
+			if( 0 == blockSize || blockSize > INT_MAX || maxBlocks < 2 )
+				return E_INVALIDARG;
+			try
+			{
+				m_blocks.resize( maxBlocks );
+			}
+			catch( const std::bad_alloc& )
+			{
+				return E_OUTOFMEMORY;
+			}
+			m_blockSize = blockSize;
+			m_source = source;
+			try
+			{
+				m_thread = std::thread( &PrefetchReadStream::workerMain, this );
+			}
+			catch( const std::system_error& )
+			{
+				m_source = nullptr;
+				return E_FAIL;
+			}
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			if( !m_source )
+				return OLE_E_BLANK;
+			if( nNumberOfBytesToRead < 0 )
+				return E_INVALIDARG;
+
+			uint8_t* pb = (uint8_t*)lpBuffer;
+			size_t remaining = (size_t)nNumberOfBytesToRead;
+			HRESULT hr = S_OK;
+			while( remaining > 0 )
+			{
+				if( m_hasCurrent && m_offset < m_current->length )
+				{
+					const size_t cb = (std::min)( remaining, m_current->length - m_offset );
+					memcpy( pb, m_current->data.data() + m_offset, cb );
+					m_offset += cb;
+					pb += cb;
+					remaining -= cb;
+					continue;
+				}
+				hr = nextBlock();
+				if( S_OK != hr )
+					break;
+			}
+			lpNumberOfBytesRead = nNumberOfBytesToRead - (int)remaining;
+			// When some data was read, the failure is reported by the next call
+			if( FAILED( hr ) && 0 == lpNumberOfBytesRead )
+				return hr;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override
+		{
+			if( !m_source )
+				return OLE_E_BLANK;
+			if( origin != eSeekOrigin::Begin && origin != eSeekOrigin::Current && origin != eSeekOrigin::End )
+				return E_INVALIDARG;
+
+			std::unique_lock<std::mutex> lock( m_lock );
+			pauseWorker( lock );
+			if( eSeekOrigin::Current == origin )
+				offset -= bufferedBytes();
+			// When the source can't seek, e.g. a pipe, the prefetched data is still valid and the stream keeps reading from where it was
+			const HRESULT hr = m_source->seek( offset, origin );
+			if( SUCCEEDED( hr ) )
+				discardBlocks();
+			resumeWorker();
+			return hr;
+		}
+
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override
+		{
+			if( !m_source )
+				return OLE_E_BLANK;
+			std::unique_lock<std::mutex> lock( m_lock );
+			pauseWorker( lock );
+			int64_t pos = 0;
+			const HRESULT hr = m_source->getPosition( pos );
+			if( SUCCEEDED( hr ) )
+				position = pos - bufferedBytes();
+			resumeWorker();
+			return hr;
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			if( !m_source )
+				return OLE_E_BLANK;
+			std::unique_lock<std::mutex> lock( m_lock );
+			pauseWorker( lock );
+			const HRESULT hr = m_source->getLength( length );
+			resumeWorker();
+			return hr;
+		}
+
+		// Current count of blocks read ahead, for diagnostics
+		size_t window()
+		{
+			std::lock_guard<std::mutex> lock( m_lock );
+			return m_window;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,367 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include "../comLightServer.h"
+#include "../streams.h"
+#include "StreamBatchTearOffs.hpp"
+
+namespace ComLight
+{
+	namespace details
+	{
+		inline FILE* openFile( LPCTSTR path, bool write )
+		{
+#ifdef _MSC_VER
+			FILE* result = nullptr;
+			const auto e = _wfopen_s( &result, path, write ? L"wb" : L"rb" );
+			return ( 0 == e ) ? result : nullptr;
+#else
+			return fopen( path, write ? "wb" : "rb" );
+#endif
+		}
+
+		inline int seekFile( FILE* file, int64_t offset, int origin )
+		{
+#ifdef _MSC_VER
+			return _fseeki64( file, offset, origin );
+#else
+			return fseeko( file, (off_t)offset, origin );
+#endif
+		}
+
+		inline int64_t tellFile( FILE* file )
+		{
+#ifdef _MSC_VER
+			return _ftelli64( file );
+#else
+			return (int64_t)ftello( file );
+#endif
+		}
+
+		constexpr size_t defaultFileBufferSize = 64 * 1024;
+	}
+
+	// Readonly file stream over <stdio.h> file handle. The stdio buffer is disabled, the stream has its own one, lent to consumers with iReadStreamLending interface.
+	// Also implements iReadStreamBatch with a tear-off, the batch crosses the interop with a single call.
+	class StdioReadStream : public ObjectRoot<iReadStreamLending>
+	{
+		FILE* m_file = nullptr;
+		std::vector<uint8_t> m_buffer;
+		// The buffered data is in [ m_begin .. m_end ) range of the vector
+		size_t m_begin = 0, m_end = 0;
+		bool m_acquired = false;
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iReadStream )
+			COM_INTERFACE_ENTRY( iReadStreamLending )
+			COM_INTERFACE_ENTRY_TEAR_OFF( iReadStreamBatch, ReadStreamBatchTearOff<StdioReadStream> )
+		END_COM_MAP()
+
+		void discardBuffer()
+		{
+			m_begin = m_end = 0;
+		}
+
+		HRESULT fillBuffer()
+		{
+			discardBuffer();
+			const size_t cb = fread( m_buffer.data(), 1, m_buffer.size(), m_file );
+			if( cb < m_buffer.size() && 0 != ferror( m_file ) )
+				return CTL_E_DEVICEIOERROR;
+			m_end = cb;
+			return S_OK;
+		}
+
+	public:
+
+		~StdioReadStream()
+		{
+			if( nullptr != m_file )
+				fclose( m_file );
+		}
+
+		HRESULT openFile( LPCTSTR path, size_t bufferSize = details::defaultFileBufferSize )
+		{
+			if( nullptr != m_file )
+				return E_ALREADY_INITIALIZED;
+			if( 0 == bufferSize )
+				return E_INVALIDARG;
+			m_file = details::openFile( path, false );
+			if( nullptr == m_file )
+				return CTL_E_DEVICEIOERROR;
+			setvbuf( m_file, nullptr, _IONBF, 0 );
+			m_buffer.resize( bufferSize );
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			if( nullptr == m_file )
+				return OLE_E_BLANK;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			if( nNumberOfBytesToRead < 0 )
+				return E_INVALIDARG;
+
+			uint8_t* pb = (uint8_t*)lpBuffer;
+			size_t remaining = (size_t)nNumberOfBytesToRead;
+			// Consume the buffered data first
+			const size_t cbBuffered = (std::min)( remaining, m_end - m_begin );
+			memcpy( pb, m_buffer.data() + m_begin, cbBuffered );
+			m_begin += cbBuffered;
+			pb += cbBuffered;
+			remaining -= cbBuffered;
+
+			if( remaining >= m_buffer.size() )
+			{
+				// Large read, bypass the buffer
+				const size_t cb = fread( pb, 1, remaining, m_file );
+				if( cb < remaining && 0 != ferror( m_file ) )
+					return CTL_E_DEVICEIOERROR;
+				remaining -= cb;
+			}
+			else if( remaining > 0 )
+			{
+				CHECK( fillBuffer() );
+				const size_t cb = (std::min)( remaining, m_end );
+				memcpy( pb, m_buffer.data(), cb );
+				m_begin = cb;
+				remaining -= cb;
+			}
+			lpNumberOfBytesRead = nNumberOfBytesToRead - (int)remaining;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override
+		{
+			if( nullptr == m_file )
+				return OLE_E_BLANK;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			int o;
+			switch( origin )
+			{
+			case eSeekOrigin::Begin: o = SEEK_SET; break;
+			case eSeekOrigin::Current:
+				o = SEEK_CUR;
+				// The file position is ahead of the stream position by the count of buffered bytes
+				offset -= (int64_t)( m_end - m_begin );
+				break;
+			case eSeekOrigin::End: o = SEEK_END; break;
+			default: return E_INVALIDARG;
+			}
+			discardBuffer();
+			if( 0 != details::seekFile( m_file, offset, o ) )
+				return E_INVALIDARG;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override
+		{
+			if( nullptr == m_file )
+				return OLE_E_BLANK;
+			const int64_t pos = details::tellFile( m_file );
+			if( pos < 0 )
+				return CTL_E_DEVICEIOERROR;
+			position = pos - (int64_t)( m_end - m_begin );
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			if( nullptr == m_file )
+				return OLE_E_BLANK;
+			// Seek to the end and back, this doesn't affect the buffered data
+			const int64_t pos = details::tellFile( m_file );
+			if( pos < 0 || 0 != details::seekFile( m_file, 0, SEEK_END ) )
+				return CTL_E_DEVICEIOERROR;
+			length = details::tellFile( m_file );
+			if( 0 != details::seekFile( m_file, pos, SEEK_SET ) )
+				return CTL_E_DEVICEIOERROR;
+			return S_OK;
+		}
+
+		// Implements iReadStreamBatch::readBatch, called by the tear-off. The buffers are filled by read(), small ones from the buffered data.
+		HRESULT readBatch( const ReadBuffer* buffers, int count, int64_t& bytesRead )
+		{
+			if( nullptr == m_file )
+				return OLE_E_BLANK;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			CHECK( details::validateBuffers( buffers, count ) );
+			return details::readBuffers( this, buffers, count, bytesRead );
+		}
+
+		HRESULT COMLIGHTCALL acquireRead( const void** ppData, int64_t& length ) override
+		{
+			if( nullptr == ppData )
+				return E_POINTER;
+			if( nullptr == m_file )
+				return OLE_E_BLANK;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			if( m_begin >= m_end )
+				CHECK( fillBuffer() );
+			*ppData = m_buffer.data() + m_begin;
+			length = (int64_t)( m_end - m_begin );
+			m_acquired = true;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL releaseRead( int64_t consumed ) override
+		{
+			if( !m_acquired )
+				return E_UNEXPECTED;
+			if( consumed < 0 || consumed > (int64_t)( m_end - m_begin ) )
+				return E_BOUNDS;
+			m_begin += (size_t)consumed;
+			m_acquired = false;
+			return S_OK;
+		}
+	};
+
+	// Write-only file stream over <stdio.h> file handle. The stdio buffer is disabled, the stream has its own one, lent to producers with iWriteStreamLending interface.
+	// Also implements iWriteStreamBatch with a tear-off, the batch crosses the interop with a single call.
+	class StdioWriteStream : public ObjectRoot<iWriteStreamLending>
+	{
+		FILE* m_file = nullptr;
+		std::vector<uint8_t> m_buffer;
+		// Count of bytes in the buffer which are not yet written to the file
+		size_t m_length = 0;
+		bool m_acquired = false;
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iWriteStream )
+			COM_INTERFACE_ENTRY( iWriteStreamLending )
+			COM_INTERFACE_ENTRY_TEAR_OFF( iWriteStreamBatch, WriteStreamBatchTearOff<StdioWriteStream> )
+		END_COM_MAP()
+
+		HRESULT writeFile( const void* pv, size_t cb )
+		{
+			if( 0 == cb )
+				return S_OK;
+			const size_t written = fwrite( pv, 1, cb, m_file );
+			return ( cb == written ) ? S_OK : CTL_E_DEVICEIOERROR;
+		}
+
+		HRESULT flushBuffer()
+		{
+			const size_t cb = m_length;
+			m_length = 0;
+			return writeFile( m_buffer.data(), cb );
+		}
+
+	public:
+
+		~StdioWriteStream()
+		{
+			if( nullptr == m_file )
+				return;
+			flushBuffer();
+			fclose( m_file );
+		}
+
+		HRESULT createFile( LPCTSTR path, size_t bufferSize = details::defaultFileBufferSize )
+		{
+			if( nullptr != m_file )
+				return E_ALREADY_INITIALIZED;
+			if( 0 == bufferSize )
+				return E_INVALIDARG;
+			m_file = details::openFile( path, true );
+			if( nullptr == m_file )
+				return CTL_E_DEVICEIOERROR;
+			setvbuf( m_file, nullptr, _IONBF, 0 );
+			m_buffer.resize( bufferSize );
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL write( const void* lpBuffer, int nNumberOfBytesToWrite ) override
+		{
+			if( nullptr == m_file )
+				return OLE_E_BLANK;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			if( nNumberOfBytesToWrite < 0 )
+				return E_INVALIDARG;
+			const size_t cb = (size_t)nNumberOfBytesToWrite;
+			if( m_length + cb <= m_buffer.size() )
+			{
+				memcpy( m_buffer.data() + m_length, lpBuffer, cb );
+				m_length += cb;
+				return S_OK;
+			}
+			CHECK( flushBuffer() );
+			if( cb >= m_buffer.size() )
+				return writeFile( lpBuffer, cb );
+			memcpy( m_buffer.data(), lpBuffer, cb );
+			m_length = cb;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL flush() override
+		{
+			if( nullptr == m_file )
+				return OLE_E_BLANK;
+			CHECK( flushBuffer() );
+			if( 0 == fflush( m_file ) )
+				return S_OK;
+			return CTL_E_DEVICEIOERROR;
+		}
+
+		// Implements iWriteStreamBatch::writeBatch, called by the tear-off. Small buffers are combined in the buffer of the stream, large ones are written directly.
+		HRESULT writeBatch( const WriteBuffer* buffers, int count )
+		{
+			if( nullptr == m_file )
+				return OLE_E_BLANK;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			CHECK( details::validateBuffers( buffers, count ) );
+			return details::writeBuffers( this, buffers, count );
+		}
+
+		HRESULT COMLIGHTCALL acquireWrite( int64_t minLength, void** ppData, int64_t& length ) override
+		{
+			if( nullptr == ppData )
+				return E_POINTER;
+			if( nullptr == m_file )
+				return OLE_E_BLANK;
+			if( minLength < 0 )
+				return E_INVALIDARG;
+			if( m_acquired )
+				return E_ACCESSDENIED;
+			const size_t cbMin = (std::max)( (size_t)minLength, (size_t)1 );
+			if( m_buffer.size() - m_length < cbMin )
+			{
+				CHECK( flushBuffer() );
+				if( m_buffer.size() < cbMin )
+				{
+					try
+					{
+						m_buffer.resize( cbMin );
+					}
+					catch( const std::bad_alloc& )
+					{
+						return E_OUTOFMEMORY;
+					}
+				}
+			}
+			*ppData = m_buffer.data() + m_length;
+			length = (int64_t)( m_buffer.size() - m_length );
+			m_acquired = true;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL commitWrite( int64_t written ) override
+		{
+			if( !m_acquired )
+				return E_UNEXPECTED;
+			if( written < 0 || (size_t)written > m_buffer.size() - m_length )
+				return E_BOUNDS;
+			m_length += (size_t)written;
+			m_acquired = false;
+			if( m_length >= m_buffer.size() )
+				return flushBuffer();
+			return S_OK;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+#include "../comLightServer.h"
+#include "../streams.h"
+
+// Tear-offs implementing iReadStreamBatch and iWriteStreamBatch for the streams which already implement iReadStreamLending or iWriteStreamLending.
+// Inheriting from both interfaces would make the iReadStream / iWriteStream base ambiguous for the users of these classes.
+// The owner implements readBatch / writeBatch as regular public methods, the tear-off forwards all calls to the owner.
+namespace ComLight
+{
+	template<class TOwner>
+	class ReadStreamBatchTearOff : public TearOffRoot<TOwner, iReadStreamBatch>
+	{
+	public:
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			return this->owner()->read( lpBuffer, nNumberOfBytesToRead, lpNumberOfBytesRead );
+		}
+
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override
+		{
+			return this->owner()->seek( offset, origin );
+		}
+
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override
+		{
+			return this->owner()->getPosition( position );
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			return this->owner()->getLength( length );
+		}
+
+		HRESULT COMLIGHTCALL readBatch( const ReadBuffer* buffers, int count, int64_t& bytesRead ) override
+		{
+			return this->owner()->readBatch( buffers, count, bytesRead );
+		}
+	};
+
+	template<class TOwner>
+	class WriteStreamBatchTearOff : public TearOffRoot<TOwner, iWriteStreamBatch>
+	{
+	public:
+
+		HRESULT COMLIGHTCALL write( const void* lpBuffer, int nNumberOfBytesToWrite ) override
+		{
+			return this->owner()->write( lpBuffer, nNumberOfBytesToWrite );
+		}
+
+		HRESULT COMLIGHTCALL flush() override
+		{
+			return this->owner()->flush();
+		}
+
+		HRESULT COMLIGHTCALL writeBatch( const WriteBuffer* buffers, int count ) override
+		{
+			return this->owner()->writeBatch( buffers, count );
+		}
+	};
+}
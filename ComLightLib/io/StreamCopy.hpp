@@ -0,0 +1,195 @@
+#pragma once
+#include <limits.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "../comLightServer.h"
+#include "../streams.h"
+
+namespace ComLight
+{
+	// Statistics of a completed, failed or cancelled copy
+	struct CopyResult
+	{
+		// Count of bytes written to the destination stream
+		int64_t bytes;
+		double seconds;
+	};
+
+	// Copies streams with reads and writes overlapped. A reader thread fills a fixed ring of buffers, the calling thread writes them to the destination.
+	// When all buffers are full the reader waits for the writer, so the memory use is bounded, and the copy runs at the speed of the slower side.
+	// The object can be reused for many copies, one at a time; the buffers are allocated once.
+	class StreamCopy
+	{
+		const size_t m_bufferSize;
+		std::vector<std::vector<uint8_t>> m_buffers;
+		std::vector<size_t> m_lengths;
+
+		std::mutex m_lock;
+		std::condition_variable m_filled, m_free;
+		// Count of buffers filled by the reader, and written by the writer, since the start of the copy
+		uint64_t m_produced = 0, m_consumed = 0;
+		// Set by the reader on end of stream or failure
+		bool m_readerDone = false;
+		HRESULT m_readStatus = S_OK;
+		// Set by the writer when it no longer needs data
+		bool m_writerDone = false;
+		// Incremented by every copy. cancel() sets m_cancelledGeneration to the generation of the running copy, so it can't affect the copies which come after.
+		uint64_t m_generation = 0;
+		uint64_t m_cancelledGeneration = 0;
+		bool m_running = false;
+
+		void readerMain( iReadStream* source, uint64_t generation )
+		{
+			const size_t count = m_buffers.size();
+			for( uint64_t i = 0; ; i++ )
+			{
+				{
+					std::unique_lock<std::mutex> lock( m_lock );
+					m_free.wait( lock, [ this, i, count, generation ]() { return m_writerDone || m_cancelledGeneration == generation || i - m_consumed < count; } );
+					if( m_writerDone || m_cancelledGeneration == generation )
+						return;
+				}
+
+				const size_t idx = (size_t)( i % count );
+				int cb = 0;
+				const HRESULT hr = source->read( m_buffers[ idx ].data(), (int)m_bufferSize, cb );
+
+				{
+					std::lock_guard<std::mutex> lock( m_lock );
+					if( FAILED( hr ) )
+					{
+						m_readStatus = hr;
+						m_readerDone = true;
+					}
+					else if( cb <= 0 )
+						m_readerDone = true;
+					else
+					{
+						m_lengths[ idx ] = (size_t)cb;
+						m_produced = i + 1;
+					}
+				}
+				m_filled.notify_one();
+				if( FAILED( hr ) || cb <= 0 )
+					return;
+			}
+		}
+
+		HRESULT writerMain( iWriteStream* dest, uint64_t generation, int64_t& bytes )
+		{
+			const size_t count = m_buffers.size();
+			for( uint64_t i = 0; ; i++ )
+			{
+				size_t length;
+				{
+					std::unique_lock<std::mutex> lock( m_lock );
+					m_filled.wait( lock, [ this, i, generation ]() { return m_cancelledGeneration == generation || m_readerDone || m_produced > i; } );
+					if( m_cancelledGeneration == generation )
+						return E_ABORT;
+					if( m_produced <= i )
+						return m_readStatus;
+					length = m_lengths[ i % count ];
+				}
+
+				CHECK( dest->write( m_buffers[ i % count ].data(), (int)length ) );
+				bytes += (int64_t)length;
+
+				{
+					std::lock_guard<std::mutex> lock( m_lock );
+					m_consumed = i + 1;
+				}
+				m_free.notify_one();
+			}
+		}
+
+	public:
+
+		// The buffers are allocated by the constructor, the total size is bufferSize * buffersCount
+		StreamCopy( size_t bufferSize = 1024 * 1024, size_t buffersCount = 4 ) :
+			m_bufferSize( (std::min)( (std::max)( bufferSize, (size_t)1 ), (size_t)INT_MAX ) ),
+			m_buffers( (std::max)( buffersCount, (size_t)2 ) ),
+			m_lengths( m_buffers.size() )
+		{
+			for( auto& b : m_buffers )
+				b.resize( m_bufferSize );
+		}
+
+		StreamCopy( const StreamCopy& ) = delete;
+
+		// Copy the rest of the source stream to the destination, then flush the destination. Blocks the calling thread until complete.
+		// Returns E_ABORT when cancelled; the result, when requested, is set even when the copy fails or is cancelled.
+		HRESULT copy( iReadStream* source, iWriteStream* dest, CopyResult* result = nullptr )
+		{
+			if( nullptr == source || nullptr == dest )
+				return E_POINTER;
+
+			uint64_t generation;
+			{
+				std::lock_guard<std::mutex> lock( m_lock );
+				if( m_running )
+					return E_UNEXPECTED;
+				m_produced = m_consumed = 0;
+				m_readerDone = m_writerDone = false;
+				m_readStatus = S_OK;
+				generation = ++m_generation;
+				m_running = true;
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+			int64_t bytes = 0;
+			HRESULT hr;
+			try
+			{
+				std::thread reader( &StreamCopy::readerMain, this, source, generation );
+				hr = writerMain( dest, generation, bytes );
+				{
+					std::lock_guard<std::mutex> lock( m_lock );
+					m_writerDone = true;
+				}
+				m_free.notify_one();
+				reader.join();
+			}
+			catch( const std::system_error& )
+			{
+				std::lock_guard<std::mutex> lock( m_lock );
+				m_running = false;
+				return E_FAIL;
+			}
+			{
+				std::lock_guard<std::mutex> lock( m_lock );
+				m_running = false;
+			}
+			if( SUCCEEDED( hr ) )
+				hr = dest->flush();
+
+			if( nullptr != result )
+			{
+				const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				result->bytes = bytes;
+				result->seconds = elapsed.count();
+			}
+			return hr;
+		}
+
+		// Cancel the copy in progress. Can be called from any thread, the copy returns E_ABORT soon after.
+		// The reads and writes already in progress are not interrupted, the cancellation happens between them.
+		// Only affects the copy which is running when it's called: when no copy is running, it does nothing.
+		void cancel()
+		{
+			{
+				std::lock_guard<std::mutex> lock( m_lock );
+				if( !m_running )
+					return;
+				m_cancelledGeneration = m_generation;
+			}
+			m_filled.notify_all();
+			m_free.notify_all();
+		}
+	};
+}
\ No newline at end of file
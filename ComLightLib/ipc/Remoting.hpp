@@ -0,0 +1,895 @@
+#pragma once
+#ifndef _MSC_VER
+#include <new>
+#include <utility>
+#include <vector>
+#include "SharedMemoryChannel.hpp"
+#include "../io/MemoryStreams.hpp"
+#include "../arrays.h"
+#include "../utils/methodTraits.hpp"
+
+// Calls COM interfaces implemented in another process on the same machine, through a shared memory mapping. Linux only.
+// The client process creates the channel, and gets a proxy which implements the interface; the server process opens the channel by name, and serves an object.
+// The proxies and stubs are generated from COMLIGHT_INTERFACE_METHODS declaration of the interface. Supported parameters:
+// values of trivially copyable types, in/out references to them, `const char*` strings, iReadStream* and iWriteStream*.
+// Streams are passed through the shared memory: SharedMemoryStream objects without copying the data, other streams with a single copy.
+// The streams received by the server object point into the client's arena, and are only valid during the call: the client recycles that memory when the call returns.
+// After the call, read streams have length 0, and write streams fail with RPC_E_DISCONNECTED. Copy the data if you need it later; pointers acquired from the lending interfaces are dangling after the call.
+namespace ComLight
+{
+	namespace details
+	{
+		// Serializes the arguments into the payload of a call slot, 8 bytes alignment
+		class PayloadWriter
+		{
+			uint8_t* const m_begin;
+			const size_t m_capacity;
+			size_t m_length = 0;
+			bool m_overflow = false;
+
+		public:
+
+			PayloadWriter( uint8_t* begin, size_t capacity ) : m_begin( begin ), m_capacity( capacity ) { }
+
+			uint8_t* allocate( size_t cb )
+			{
+				const size_t offset = ( m_length + 7 ) & ~(size_t)7;
+				if( m_overflow || offset > m_capacity || cb > m_capacity - offset )
+				{
+					m_overflow = true;
+					return nullptr;
+				}
+				m_length = offset + cb;
+				return m_begin + offset;
+			}
+
+			template<class T>
+			void put( const T& value )
+			{
+				uint8_t* const p = allocate( sizeof( T ) );
+				if( nullptr != p )
+					memcpy( p, &value, sizeof( T ) );
+			}
+
+			void putString( const char* str )
+			{
+				if( nullptr == str )
+				{
+					put( UINT32_MAX );
+					return;
+				}
+				const size_t len = strlen( str );
+				if( len >= UINT32_MAX )
+				{
+					m_overflow = true;
+					return;
+				}
+				put( (uint32_t)len );
+				uint8_t* const p = allocate( len + 1 );
+				if( nullptr != p )
+					memcpy( p, str, len + 1 );
+			}
+
+			HRESULT status() const { return m_overflow ? E_BOUNDS : S_OK; }
+			uint32_t length() const { return (uint32_t)m_length; }
+		};
+
+		// Deserializes the payload. The data comes from another process, every read is checked.
+		class PayloadReader
+		{
+			const uint8_t* const m_begin;
+			const size_t m_length;
+			size_t m_offset = 0;
+			bool m_failed = false;
+
+		public:
+
+			PayloadReader( const uint8_t* begin, size_t length ) : m_begin( begin ), m_length( length ) { }
+
+			const uint8_t* take( size_t cb )
+			{
+				const size_t offset = ( m_offset + 7 ) & ~(size_t)7;
+				if( m_failed || offset > m_length || cb > m_length - offset )
+				{
+					m_failed = true;
+					return nullptr;
+				}
+				m_offset = offset + cb;
+				return m_begin + offset;
+			}
+
+			template<class T>
+			void get( T& value )
+			{
+				const uint8_t* const p = take( sizeof( T ) );
+				if( nullptr != p )
+					memcpy( &value, p, sizeof( T ) );
+			}
+
+			const char* getString()
+			{
+				uint32_t len = 0;
+				get( len );
+				if( UINT32_MAX == len )
+					return nullptr;
+				const char* const p = (const char*)take( (size_t)len + 1 );
+				if( nullptr == p || 0 != p[ len ] )
+				{
+					m_failed = true;
+					return nullptr;
+				}
+				return p;
+			}
+
+			HRESULT status() const { return m_failed ? E_INVALIDARG : S_OK; }
+		};
+
+		// Stream argument on the wire: a range of the arena
+		struct StreamDescriptor
+		{
+			uint64_t offset;
+			uint64_t capacity;
+			int64_t length;
+			int64_t position;
+			uint32_t isNull;
+		};
+
+		template<class T>
+		struct isPlainValue : std::integral_constant<bool, std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value && !std::is_member_pointer<T>::value> { };
+
+		// Client side of an argument: prepare() runs before the slot is claimed, write() serializes the request, finish() deserializes the response.
+		template<class A, class = void>
+		class ClientArg
+		{
+			static_assert( isPlainValue<A>::value, "Unsupported parameter type for a remote call. Supported are trivially copyable values and references, const char*, iReadStream* and iWriteStream*" );
+		};
+
+		// Values, and const references to them
+		template<class T>
+		class ClientArg<T, typename std::enable_if<isPlainValue<typename std::remove_const<typename std::remove_reference<T>::type>::type>::value &&
+			( !std::is_reference<T>::value || std::is_const<typename std::remove_reference<T>::type>::value )>::type>
+		{
+			using Value = typename std::remove_const<typename std::remove_reference<T>::type>::type;
+			static_assert( !std::is_base_of<ArrayDescriptor, Value>::value && !std::is_base_of<NdArrayDescriptor, Value>::value,
+				"Array descriptors point to the memory of the calling process. Pass the data in a SharedMemoryStream instead." );
+			T m_value;
+
+		public:
+
+			ClientArg( T v ) : m_value( v ) { }
+			HRESULT prepare( ClientChannel& ) { return S_OK; }
+			void write( PayloadWriter& w ) { w.put( m_value ); }
+			HRESULT finish( PayloadReader& ) { return S_OK; }
+		};
+
+		// In/out references
+		template<class T>
+		class ClientArg<T&, typename std::enable_if<isPlainValue<T>::value && !std::is_const<T>::value>::type>
+		{
+			T& m_value;
+
+		public:
+
+			ClientArg( T& v ) : m_value( v ) { }
+			HRESULT prepare( ClientChannel& ) { return S_OK; }
+			void write( PayloadWriter& w ) { w.put( m_value ); }
+			HRESULT finish( PayloadReader& r )
+			{
+				r.get( m_value );
+				return S_OK;
+			}
+		};
+
+		template<>
+		class ClientArg<const char*>
+		{
+			const char* m_value;
+
+		public:
+
+			ClientArg( const char* v ) : m_value( v ) { }
+			HRESULT prepare( ClientChannel& ) { return S_OK; }
+			void write( PayloadWriter& w ) { w.putString( m_value ); }
+			HRESULT finish( PayloadReader& ) { return S_OK; }
+		};
+
+		// Common part of stream arguments: the stream is either in the arena of this channel, or the data goes through a temporary block of the arena.
+		class ClientStreamArg
+		{
+		protected:
+			ClientChannel* m_channel = nullptr;
+			SharedBlock* m_shared = nullptr;
+			CComPtr<iSharedMemoryBlock> m_sharedStream;
+			uint64_t m_tempOffset = 0, m_tempSize = 0;
+			StreamDescriptor m_desc = {};
+
+			// True when the stream is in the arena of the channel
+			bool findShared( IUnknown* stream, ClientChannel& channel )
+			{
+				m_desc.isNull = ( nullptr == stream ) ? 1 : 0;
+				if( nullptr == stream )
+					return true;
+				if( FAILED( stream->QueryInterface( iSharedMemoryBlock::iid(), (void**)&m_sharedStream ) ) )
+					return false;
+				SharedBlock* const block = m_sharedStream->sharedBlock();
+				if( block->channel.get() != &channel )
+					return false;
+				m_shared = block;
+				m_desc.offset = block->offset;
+				m_desc.capacity = block->capacity;
+				m_desc.length = block->length;
+				m_desc.position = block->position;
+				return true;
+			}
+
+			HRESULT allocateTemp( ClientChannel& channel, uint64_t size )
+			{
+				CHECK( channel.allocate( size, m_tempOffset ) );
+				m_channel = &channel;
+				m_tempSize = size;
+				m_desc.offset = m_tempOffset;
+				m_desc.capacity = size;
+				return S_OK;
+			}
+
+			uint8_t* tempData() const { return m_channel->arena( m_tempOffset, m_tempSize ); }
+
+		public:
+
+			ClientStreamArg() = default;
+			ClientStreamArg( const ClientStreamArg& ) = delete;
+
+			~ClientStreamArg()
+			{
+				if( nullptr != m_channel )
+					m_channel->free( m_tempOffset, m_tempSize );
+			}
+
+			void write( PayloadWriter& w ) { w.put( m_desc ); }
+		};
+
+		// Input stream: the server reads the remaining data, the response contains the new read position
+		template<>
+		class ClientArg<iReadStream*> : public ClientStreamArg
+		{
+			iReadStream* const m_stream;
+
+		public:
+
+			ClientArg( iReadStream* s ) : m_stream( s ) { }
+
+			HRESULT prepare( ClientChannel& channel )
+			{
+				if( findShared( m_stream, channel ) )
+					return S_OK;
+				// Copy the rest of the stream into the arena
+				int64_t length, position;
+				CHECK( m_stream->getLength( length ) );
+				CHECK( m_stream->getPosition( position ) );
+				const int64_t remaining = std::max( length - position, (int64_t)0 );
+				CHECK( allocateTemp( channel, (uint64_t)remaining ) );
+				int64_t cbRead = 0;
+				const ReadBuffer rb{ tempData(), remaining };
+				CHECK( readBuffers( m_stream, &rb, 1, cbRead ) );
+				m_desc.length = cbRead;
+				m_desc.position = 0;
+				return S_OK;
+			}
+
+			HRESULT finish( PayloadReader& r )
+			{
+				int64_t position = 0;
+				r.get( position );
+				if( nullptr != m_shared )
+					m_shared->position = position;
+				else if( nullptr != m_stream && position < m_desc.length )
+				{
+					// The server didn't consume everything, rewind the source
+					return m_stream->seek( position - m_desc.length, eSeekOrigin::Current );
+				}
+				return S_OK;
+			}
+		};
+
+		// Output stream: the server appends to the block, the response contains the new length
+		template<>
+		class ClientArg<iWriteStream*> : public ClientStreamArg
+		{
+			iWriteStream* const m_stream;
+
+		public:
+
+			ClientArg( iWriteStream* s ) : m_stream( s ) { }
+
+			HRESULT prepare( ClientChannel& channel )
+			{
+				if( findShared( m_stream, channel ) )
+					return S_OK;
+				CHECK( allocateTemp( channel, channel.outputCapacity ) );
+				m_desc.length = 0;
+				m_desc.position = 0;
+				return S_OK;
+			}
+
+			HRESULT finish( PayloadReader& r )
+			{
+				int64_t length = 0;
+				r.get( length );
+				if( length < m_desc.length || (uint64_t)length > m_desc.capacity )
+					return E_BOUNDS;
+				if( nullptr != m_shared )
+				{
+					m_shared->length = length;
+					return S_OK;
+				}
+				if( nullptr == m_stream || 0 == length )
+					return S_OK;
+				const WriteBuffer wb{ tempData(), length };
+				return writeBuffers( m_stream, &wb, 1 );
+			}
+		};
+
+		template<class... A, size_t... Is>
+		inline HRESULT remoteCallImpl( ClientChannel& channel, uint32_t method, std::tuple<ClientArg<A>...>& args, std::index_sequence<Is...> )
+		{
+			if( channel.closed() )
+				return RPC_E_DISCONNECTED;
+			const HRESULT prepared[] = { S_OK, std::get<Is>( args ).prepare( channel )... };
+			for( HRESULT hr : prepared )
+				CHECK( hr );
+
+			SharedHeader& header = channel.header();
+			const off_t peer = serverLockByte;
+			const uint32_t pos = header.claimPos.fetch_add( 1 );
+			SlotHeader& slot = channel.slot( pos );
+			if( !channel.waitSequence( slot, pos, peer ) )
+				return RPC_E_DISCONNECTED;
+
+			uint8_t* const payload = channel.payload( slot );
+			PayloadWriter w{ payload, channel.payloadCapacity() };
+			const int dummy[] = { 0, ( std::get<Is>( args ).write( w ), 0 )... };
+			( void )dummy;
+			if( FAILED( w.status() ) )
+			{
+				// Skip the position: the server waits for the request in this slot, send an empty one
+				slot.method = UINT32_MAX;
+				slot.length = 0;
+				publishSequence( slot, pos + 1 );
+				if( channel.waitSequence( slot, pos + 2, peer ) )
+					publishSequence( slot, pos + channel.slotsCount() );
+				return E_BOUNDS;
+			}
+			slot.method = method;
+			slot.length = w.length();
+			publishSequence( slot, pos + 1 );
+
+			if( !channel.waitSequence( slot, pos + 2, peer ) )
+				return RPC_E_DISCONNECTED;
+			const HRESULT status = slot.status;
+			PayloadReader r{ payload, std::min( (size_t)slot.length, channel.payloadCapacity() ) };
+			const HRESULT finished[] = { S_OK, std::get<Is>( args ).finish( r )... };
+			publishSequence( slot, pos + channel.slotsCount() );
+
+			if( FAILED( status ) )
+				return status;
+			CHECK( r.status() );
+			for( HRESULT hr : finished )
+				CHECK( hr );
+			return status;
+		}
+
+		template<class... A>
+		inline HRESULT remoteCall( ClientChannel& channel, uint32_t method, A... args )
+		{
+			std::tuple<ClientArg<A>...> tuple( args... );
+			return remoteCallImpl<A...>( channel, method, tuple, std::index_sequence_for<A...>{} );
+		}
+
+		// Server side of an argument: read() deserializes the request, get() returns the value for the method, writeBack() serializes the response.
+		template<class A, class = void>
+		class ServerArg
+		{
+			static_assert( isPlainValue<A>::value, "Unsupported parameter type for a remote call" );
+		};
+
+		template<class T>
+		class ServerArg<T, typename std::enable_if<isPlainValue<typename std::remove_const<typename std::remove_reference<T>::type>::type>::value &&
+			( !std::is_reference<T>::value || std::is_const<typename std::remove_reference<T>::type>::value )>::type>
+		{
+			typename std::remove_const<typename std::remove_reference<T>::type>::type m_value;
+
+		public:
+
+			HRESULT read( PayloadReader& r, SharedMapping& )
+			{
+				r.get( m_value );
+				return S_OK;
+			}
+			T get() { return m_value; }
+			void writeBack( PayloadWriter& ) { }
+		};
+
+		template<class T>
+		class ServerArg<T&, typename std::enable_if<isPlainValue<T>::value && !std::is_const<T>::value>::type>
+		{
+			T m_value;
+
+		public:
+
+			HRESULT read( PayloadReader& r, SharedMapping& )
+			{
+				r.get( m_value );
+				return S_OK;
+			}
+			T& get() { return m_value; }
+			void writeBack( PayloadWriter& w ) { w.put( m_value ); }
+		};
+
+		template<>
+		class ServerArg<const char*>
+		{
+			const char* m_value = nullptr;
+
+		public:
+
+			// The string stays in the payload, it's only valid during the call
+			HRESULT read( PayloadReader& r, SharedMapping& )
+			{
+				m_value = r.getString();
+				return S_OK;
+			}
+			const char* get() { return m_value; }
+			void writeBack( PayloadWriter& ) { }
+		};
+
+		template<>
+		class ServerArg<iReadStream*>
+		{
+			CComPtr<Object<MemoryReadStream>> m_stream;
+
+		public:
+
+			// The stream reads directly from the arena, without copying the data
+			HRESULT read( PayloadReader& r, SharedMapping& mapping )
+			{
+				StreamDescriptor desc = {};
+				r.get( desc );
+				CHECK( r.status() );
+				if( 0 != desc.isNull )
+					return S_OK;
+				if( desc.length < 0 || desc.position < 0 || desc.position > desc.length )
+					return E_INVALIDARG;
+				const uint8_t* const data = mapping.arena( desc.offset, (uint64_t)desc.length );
+				if( nullptr == data )
+					return E_INVALIDARG;
+				CHECK( Object<MemoryReadStream>::create( m_stream ) );
+				CHECK( m_stream->initialize( data, desc.length ) );
+				return m_stream->seek( desc.position, eSeekOrigin::Begin );
+			}
+			iReadStream* get() { return m_stream; }
+			void writeBack( PayloadWriter& w )
+			{
+				int64_t position = 0;
+				if( m_stream )
+				{
+					m_stream->getPosition( position );
+					// Detach from the arena, in case the server object kept a reference to the stream
+					m_stream->initialize( nullptr, 0 );
+				}
+				w.put( position );
+			}
+		};
+
+		// Write stream of a fixed capacity over a block of the arena
+		class ArenaWriteStream : public ObjectRoot<iWriteStreamLending>
+		{
+			uint8_t* m_data = nullptr;
+			int64_t m_capacity = 0;
+			int64_t m_length = 0;
+			bool m_acquired = false;
+			bool m_closed = false;
+
+			BEGIN_COM_MAP()
+				COM_INTERFACE_ENTRY( iWriteStream )
+				COM_INTERFACE_ENTRY( iWriteStreamLending )
+			END_COM_MAP()
+
+		public:
+
+			void initialize( uint8_t* data, int64_t capacity, int64_t length )
+			{
+				m_data = data;
+				m_capacity = capacity;
+				m_length = length;
+			}
+
+			int64_t length() const { return m_length; }
+
+			// Called when the call returns, the arena memory is no longer ours
+			void close()
+			{
+				m_data = nullptr;
+				m_capacity = m_length = 0;
+				m_acquired = false;
+				m_closed = true;
+			}
+
+			HRESULT COMLIGHTCALL write( const void* lpBuffer, int nNumberOfBytesToWrite ) override
+			{
+				if( m_closed )
+					return RPC_E_DISCONNECTED;
+				if( m_acquired )
+					return E_ACCESSDENIED;
+				if( nNumberOfBytesToWrite < 0 )
+					return E_INVALIDARG;
+				if( nNumberOfBytesToWrite > m_capacity - m_length )
+					return E_BOUNDS;
+				memcpy( m_data + m_length, lpBuffer, (size_t)nNumberOfBytesToWrite );
+				m_length += nNumberOfBytesToWrite;
+				return S_OK;
+			}
+
+			HRESULT COMLIGHTCALL flush() override
+			{
+				return m_closed ? RPC_E_DISCONNECTED : S_OK;
+			}
+
+			HRESULT COMLIGHTCALL acquireWrite( int64_t minLength, void** ppData, int64_t& length ) override
+			{
+				if( nullptr == ppData )
+					return E_POINTER;
+				if( m_closed )
+					return RPC_E_DISCONNECTED;
+				if( minLength < 0 )
+					return E_INVALIDARG;
+				if( m_acquired )
+					return E_ACCESSDENIED;
+				if( minLength > m_capacity - m_length )
+					return E_BOUNDS;
+				*ppData = m_data + m_length;
+				length = m_capacity - m_length;
+				m_acquired = true;
+				return S_OK;
+			}
+
+			HRESULT COMLIGHTCALL commitWrite( int64_t written ) override
+			{
+				if( m_closed )
+					return RPC_E_DISCONNECTED;
+				if( !m_acquired )
+					return E_UNEXPECTED;
+				if( written < 0 || written > m_capacity - m_length )
+					return E_BOUNDS;
+				m_length += written;
+				m_acquired = false;
+				return S_OK;
+			}
+		};
+
+		template<>
+		class ServerArg<iWriteStream*>
+		{
+			CComPtr<Object<ArenaWriteStream>> m_stream;
+
+		public:
+
+			// The stream writes directly into the arena
+			HRESULT read( PayloadReader& r, SharedMapping& mapping )
+			{
+				StreamDescriptor desc = {};
+				r.get( desc );
+				CHECK( r.status() );
+				if( 0 != desc.isNull )
+					return S_OK;
+				if( desc.capacity > INT64_MAX || desc.length < 0 || (uint64_t)desc.length > desc.capacity )
+					return E_INVALIDARG;
+				uint8_t* const data = mapping.arena( desc.offset, desc.capacity );
+				if( nullptr == data )
+					return E_INVALIDARG;
+				CHECK( Object<ArenaWriteStream>::create( m_stream ) );
+				m_stream->initialize( data, (int64_t)desc.capacity, desc.length );
+				return S_OK;
+			}
+			iWriteStream* get() { return m_stream; }
+			void writeBack( PayloadWriter& w )
+			{
+				w.put( m_stream ? m_stream->length() : (int64_t)0 );
+				// Detach from the arena, in case the server object kept a reference to the stream
+				if( m_stream )
+					m_stream->close();
+			}
+		};
+
+		template<class I, class C, class... A, size_t... Is>
+		inline HRESULT invokeStub( I* obj, HRESULT( COMLIGHTCALL C::* method )( A... ), SharedMapping& mapping, SlotHeader& slot, std::index_sequence<Is...> )
+		{
+			uint8_t* const payload = mapping.payload( slot );
+			std::tuple<ServerArg<A>...> args;
+			PayloadReader r{ payload, std::min( (size_t)slot.length, mapping.payloadCapacity() ) };
+			const HRESULT decoded[] = { S_OK, std::get<Is>( args ).read( r, mapping )... };
+			slot.length = 0;
+			CHECK( r.status() );
+			for( HRESULT hr : decoded )
+				CHECK( hr );
+
+			const HRESULT status = ( obj->*method )( std::get<Is>( args ).get()... );
+
+			PayloadWriter w{ payload, mapping.payloadCapacity() };
+			const int dummy[] = { 0, ( std::get<Is>( args ).writeBack( w ), 0 )... };
+			( void )dummy;
+			slot.length = w.length();
+			CHECK( w.status() );
+			return status;
+		}
+
+		template<class I, size_t Index>
+		inline HRESULT invokeMethod( I* obj, const InterfaceMethods<I>& methods, SharedMapping& mapping, SlotHeader& slot )
+		{
+			using M = typename std::tuple_element<Index, InterfaceMethods<I>>::type;
+			constexpr size_t arity = MethodTraits<M>::arity;
+			return invokeStub( obj, std::get<Index>( methods ), mapping, slot, std::make_index_sequence<arity>{} );
+		}
+
+		template<class I>
+		class RemoteStub
+		{
+			using Methods = InterfaceMethods<I>;
+			using pfnInvoke = HRESULT( *)( I*, const Methods&, SharedMapping&, SlotHeader& );
+
+			template<size_t... Is>
+			static pfnInvoke lookup( uint32_t method, std::index_sequence<Is...> )
+			{
+				static const pfnInvoke table[] = { nullptr, &invokeMethod<I, Is>... };
+				return ( method < sizeof...( Is ) ) ? table[ method + 1 ] : nullptr;
+			}
+
+		public:
+
+			static constexpr size_t methodsCount = std::tuple_size<Methods>::value;
+
+			static HRESULT invoke( I* obj, const Methods& methods, SharedMapping& mapping, SlotHeader& slot )
+			{
+				const pfnInvoke pfn = lookup( slot.method, std::make_index_sequence<methodsCount>{} );
+				if( nullptr == pfn )
+				{
+					slot.length = 0;
+					return E_NOTIMPL;
+				}
+				return pfn( obj, methods, mapping, slot );
+			}
+		};
+
+		// Client-side object which implements the interface by sending the calls to the server.
+		// It's not a C++ class derived from the interface: the vtable is built at runtime from COMLIGHT_INTERFACE_METHODS, the same way .NET side of ComLight builds vtables of the managed objects.
+		template<class I>
+		class RemoteProxy
+		{
+			// Must be the first field, the callers see this object as I*
+			const void* const* m_vtbl;
+			std::atomic<uint32_t> m_refCounter;
+			std::shared_ptr<ClientChannel> m_channel;
+
+			using Methods = InterfaceMethods<I>;
+			static constexpr size_t methodsCount = std::tuple_size<Methods>::value;
+
+			RemoteProxy( const void* const* vtbl, const std::shared_ptr<ClientChannel>& channel ) :
+				m_vtbl( vtbl ), m_refCounter( 1 ), m_channel( channel ) { }
+
+			static HRESULT COMLIGHTCALL queryInterface( RemoteProxy* pThis, REFIID iid, void** ppvObject )
+			{
+				if( nullptr == ppvObject )
+					return E_POINTER;
+				if( iid == I::iid() || iid == IUnknown::iid() )
+				{
+					pThis->m_refCounter++;
+					*ppvObject = pThis;
+					return S_OK;
+				}
+				*ppvObject = nullptr;
+				return E_NOINTERFACE;
+			}
+
+			static uint32_t COMLIGHTCALL addRef( RemoteProxy* pThis )
+			{
+				return ++pThis->m_refCounter;
+			}
+
+			static uint32_t COMLIGHTCALL release( RemoteProxy* pThis )
+			{
+				const uint32_t res = --pThis->m_refCounter;
+				if( 0 == res )
+					delete pThis;
+				return res;
+			}
+
+			// Placed in the vtable slots of the methods missing from COMLIGHT_INTERFACE_METHODS
+			static HRESULT COMLIGHTCALL notImplemented( RemoteProxy* )
+			{
+				return E_NOTIMPL;
+			}
+
+			template<size_t Index, class Args>
+			struct Thunk;
+
+			template<size_t Index, class... A>
+			struct Thunk<Index, std::tuple<A...>>
+			{
+				static HRESULT COMLIGHTCALL call( RemoteProxy* pThis, A... args )
+				{
+					return remoteCall<A...>( *pThis->m_channel, (uint32_t)Index, args... );
+				}
+			};
+
+			template<class F>
+			static const void* entry( F pfn )
+			{
+				return reinterpret_cast<const void*>( pfn );
+			}
+
+			template<size_t... Is>
+			static HRESULT buildVtable( std::vector<const void*>& vtbl, std::index_sequence<Is...> )
+			{
+				const Methods methods = interfaceMethods<I>();
+				const int slots[] = { -1, vtableSlot( std::get<Is>( methods ) )... };
+				const void* const thunks[] = { nullptr, entry( &Thunk<Is, typename MethodTraits<typename std::tuple_element<Is, Methods>::type>::Arguments>::call )... };
+				int maxSlot = 2;
+				for( size_t i = 1; i <= methodsCount; i++ )
+				{
+					// The first 3 entries are the methods of IUnknown
+					if( slots[ i ] < 3 )
+						return E_INVALIDARG;
+					maxSlot = std::max( maxSlot, slots[ i ] );
+				}
+				vtbl.assign( (size_t)maxSlot + 1, entry( &notImplemented ) );
+				vtbl[ 0 ] = entry( &queryInterface );
+				vtbl[ 1 ] = entry( &addRef );
+				vtbl[ 2 ] = entry( &release );
+				for( size_t i = 1; i <= methodsCount; i++ )
+					vtbl[ slots[ i ] ] = thunks[ i ];
+				return S_OK;
+			}
+
+			// Built once per interface, nullptr if COMLIGHT_INTERFACE_METHODS lists something else than virtual methods
+			static const void* const* vtable()
+			{
+				static const std::vector<const void*> vtbl = []()
+				{
+					std::vector<const void*> v;
+					if( FAILED( buildVtable( v, std::make_index_sequence<methodsCount>{} ) ) )
+						v.clear();
+					return v;
+				}();
+				return vtbl.empty() ? nullptr : vtbl.data();
+			}
+
+		public:
+
+			static HRESULT create( const std::shared_ptr<ClientChannel>& channel, I** pp )
+			{
+				if( nullptr == pp )
+					return E_POINTER;
+				const void* const* vtbl = vtable();
+				if( nullptr == vtbl )
+					return E_INVALIDARG;
+				RemoteProxy* const p = new( std::nothrow ) RemoteProxy( vtbl, channel );
+				if( nullptr == p )
+					return E_OUTOFMEMORY;
+				*pp = reinterpret_cast<I*>( p );
+				return S_OK;
+			}
+		};
+	}
+
+	// The process which calls the remote object. Creates the shared memory, then the server process opens it by name.
+	class SharedMemoryClient
+	{
+		std::shared_ptr<details::ClientChannel> m_channel;
+
+	public:
+
+		~SharedMemoryClient()
+		{
+			close();
+		}
+
+		// Create the shared memory. The name must start with '/', the client removes it when closed.
+		HRESULT create( LPCTSTR name, const SharedMemoryOptions& options = SharedMemoryOptions{} )
+		{
+			if( m_channel )
+				return E_ALREADY_INITIALIZED;
+			std::shared_ptr<details::ClientChannel> channel;
+			try
+			{
+				channel = std::make_shared<details::ClientChannel>();
+			}
+			catch( const std::bad_alloc& )
+			{
+				return E_OUTOFMEMORY;
+			}
+			CHECK( channel->create( name, options ) );
+			m_channel = channel;
+			return S_OK;
+		}
+
+		// Wait for the server process to start serving, then create the proxy. Fails with E_NOINTERFACE if the server serves a different interface.
+		template<class I>
+		HRESULT connect( CComPtr<I>& proxy, int timeoutMs = 10000 )
+		{
+			if( !m_channel )
+				return OLE_E_BLANK;
+			CHECK( m_channel->waitForServer( timeoutMs ) );
+			const details::SharedHeader& header = m_channel->header();
+			if( !( header.iid == I::iid() ) || header.methodsCount != std::tuple_size<details::InterfaceMethods<I>>::value )
+				return E_NOINTERFACE;
+			proxy.release();
+			return details::RemoteProxy<I>::create( m_channel, &proxy );
+		}
+
+		// Create a stream in the shared memory, to pass data to the remote methods without copying
+		HRESULT createStream( int64_t capacity, CComPtr<Object<SharedMemoryStream>>& stream )
+		{
+			if( !m_channel )
+				return OLE_E_BLANK;
+			CHECK( Object<SharedMemoryStream>::create( stream ) );
+			return stream->initialize( m_channel, capacity );
+		}
+
+		// Disconnect the server. The proxies fail with RPC_E_DISCONNECTED afterwards.
+		void close()
+		{
+			if( m_channel )
+				m_channel->close();
+			m_channel.reset();
+		}
+	};
+
+	// The process which implements the object. Opens the shared memory created by the client.
+	class SharedMemoryServer
+	{
+		details::ServerChannel m_channel;
+
+	public:
+
+		~SharedMemoryServer()
+		{
+			if( m_channel.isOpen() )
+				m_channel.header().serverState.store( details::serverStopped );
+		}
+
+		HRESULT open( LPCTSTR name )
+		{
+			return m_channel.open( name );
+		}
+
+		// Serve the calls on the calling thread, in the order they were made. Returns S_OK when the client closes the channel, RPC_E_DISCONNECTED when the client process exits.
+		template<class I>
+		HRESULT serve( I* obj )
+		{
+			if( nullptr == obj )
+				return E_POINTER;
+			if( !m_channel.isOpen() )
+				return OLE_E_BLANK;
+			details::SharedHeader& header = m_channel.header();
+
+			using Stub = details::RemoteStub<I>;
+			const details::InterfaceMethods<I> methods = details::interfaceMethods<I>();
+			header.iid = I::iid();
+			header.methodsCount = (uint32_t)Stub::methodsCount;
+			header.serverState.store( details::serverServing );
+			details::futexWake( header.serverState );
+
+			const off_t peer = details::clientLockByte;
+			for( uint32_t pos = 0; ; pos++ )
+			{
+				details::SlotHeader& slot = m_channel.slot( pos );
+				if( !m_channel.waitSequence( slot, pos + 1, peer ) )
+					break;
+				slot.status = Stub::invoke( obj, methods, m_channel, slot );
+				details::publishSequence( slot, pos + 2 );
+			}
+			header.serverState.store( details::serverStopped );
+			return ( 0 != header.clientClosed.load() ) ? S_OK : RPC_E_DISCONNECTED;
+		}
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,623 @@
+#pragma once
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "../comLightServer.h"
+#include "../streams.h"
+#include "../utils/posixErrors.hpp"
+
+namespace ComLight
+{
+	// Parameters of a shared memory channel, specified by the client process which creates it
+	struct SharedMemoryOptions
+	{
+		// Count of calls in flight, power of 2. When more client threads are calling the remote object, they wait for a free slot.
+		uint32_t slots = 8;
+		// Maximum size of the serialized arguments of a single call, the payload of streams doesn't count
+		uint32_t slotPayload = 64 * 1024;
+		// Memory for the payload of streams, allocated by SharedMemoryStream objects and by the proxies
+		uint64_t arenaSize = 64 * 1024 * 1024;
+		// Capacity of the temporary block which receives the output of a remote method, when the caller passes a write stream which is not in the shared memory
+		uint32_t outputCapacity = 1024 * 1024;
+	};
+
+	namespace details
+	{
+		static_assert( ATOMIC_INT_LOCK_FREE == 2, "Shared memory channel requires lock-free 32-bit atomics" );
+
+		// Not using FUTEX_PRIVATE_FLAG, the other side is in another process
+		inline void futexWait( std::atomic<uint32_t>& word, uint32_t value, int timeoutMs )
+		{
+			struct timespec ts;
+			ts.tv_sec = timeoutMs / 1000;
+			ts.tv_nsec = ( timeoutMs % 1000 ) * 1000000L;
+			syscall( SYS_futex, &word, FUTEX_WAIT, value, &ts, nullptr, 0 );
+		}
+
+		inline void futexWake( std::atomic<uint32_t>& word )
+		{
+			syscall( SYS_futex, &word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0 );
+		}
+
+		constexpr uint32_t sharedMemoryMagic = 0x4C434D53;
+		constexpr uint32_t sharedMemoryVersion = 1;
+		constexpr size_t sharedHeaderSize = 4096;
+		constexpr size_t slotHeaderSize = 64;
+		constexpr size_t arenaAlignment = 64;
+
+		constexpr uint32_t serverStarting = 0;
+		constexpr uint32_t serverServing = 1;
+		constexpr uint32_t serverStopped = 2;
+
+		// Each process holds a lock on one byte of the mapped file while it's alive, the kernel releases the lock when the process exits or crashes
+		constexpr off_t clientLockByte = 0;
+		constexpr off_t serverLockByte = 1;
+
+		// Beginning of the shared mapping. The call slots follow, then the arena for the payload of streams.
+		struct SharedHeader
+		{
+			// Written last by the client, after the rest of the header
+			std::atomic<uint32_t> magic;
+			uint32_t version;
+			uint64_t mappingSize;
+			uint32_t slotsCount;
+			uint32_t slotSize;
+			uint64_t slotsOffset;
+			uint64_t arenaOffset;
+			uint64_t arenaSize;
+			// The fields below are written by the server before it sets serverState to serverServing
+			GUID iid;
+			uint32_t methodsCount;
+			std::atomic<uint32_t> serverState;
+			std::atomic<uint32_t> clientClosed;
+			// Next position in the ring of calls, incremented by the client threads
+			std::atomic<uint32_t> claimPos;
+		};
+		static_assert( sizeof( SharedHeader ) <= sharedHeaderSize, "SharedHeader is too large" );
+
+		// Header of a call slot, followed by the payload.
+		// For the call at ring position `pos`, the sequence is pos while the slot is free, pos + 1 when the request is written, pos + 2 when the response is written.
+		struct SlotHeader
+		{
+			std::atomic<uint32_t> sequence;
+			// Count of threads sleeping on the sequence, to skip the system call when nobody waits
+			std::atomic<uint32_t> waiters;
+			uint32_t method;
+			HRESULT status;
+			uint32_t length;
+		};
+		static_assert( sizeof( SlotHeader ) <= slotHeaderSize, "SlotHeader is too large" );
+
+		inline void publishSequence( SlotHeader& slot, uint32_t value )
+		{
+			slot.sequence.store( value );
+			if( slot.waiters.load() > 0 )
+				futexWake( slot.sequence );
+		}
+
+		// Memory mapping of the channel. Both processes keep the geometry in local memory, the shared copy is only read when the mapping is opened.
+		class SharedMapping
+		{
+		protected:
+			int m_fd = -1;
+			uint8_t* m_base = nullptr;
+			size_t m_size = 0;
+			uint32_t m_slotsCount = 0;
+			size_t m_slotSize = 0;
+			size_t m_slotsOffset = 0;
+			size_t m_arenaOffset = 0;
+			uint64_t m_arenaSize = 0;
+
+			HRESULT map( size_t size )
+			{
+				void* const pv = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0 );
+				if( MAP_FAILED == pv )
+					return hresultFromErrno();
+				m_base = (uint8_t*)pv;
+				m_size = size;
+				return S_OK;
+			}
+
+			// Open file description locks are owned by the file descriptor, not by the process, and they're not affected by the other descriptors of the same file
+			HRESULT lockByte( off_t byte )
+			{
+				struct flock fl = {};
+				fl.l_type = F_WRLCK;
+				fl.l_whence = SEEK_SET;
+				fl.l_start = byte;
+				fl.l_len = 1;
+				if( 0 != fcntl( m_fd, F_OFD_SETLK, &fl ) )
+					return hresultFromErrno();
+				return S_OK;
+			}
+
+			// False when the client closed the channel, or the other process has exited. Unlike kill( pid, 0 ), this also works for zombie processes.
+			bool peerAlive( off_t peerByte ) const
+			{
+				if( 0 != header().clientClosed.load() )
+					return false;
+				struct flock fl = {};
+				fl.l_type = F_WRLCK;
+				fl.l_whence = SEEK_SET;
+				fl.l_start = peerByte;
+				fl.l_len = 1;
+				if( 0 != fcntl( m_fd, F_OFD_GETLK, &fl ) )
+					return false;
+				return F_UNLCK != fl.l_type;
+			}
+
+		public:
+
+			SharedMapping() = default;
+			SharedMapping( const SharedMapping& ) = delete;
+			void operator=( const SharedMapping& ) = delete;
+
+			~SharedMapping()
+			{
+				if( nullptr != m_base )
+					munmap( m_base, m_size );
+				if( m_fd >= 0 )
+					::close( m_fd );
+			}
+
+			bool isOpen() const { return nullptr != m_base; }
+
+			SharedHeader& header() const { return *(SharedHeader*)m_base; }
+
+			uint32_t slotsCount() const { return m_slotsCount; }
+
+			SlotHeader& slot( uint32_t pos ) const
+			{
+				return *(SlotHeader*)( m_base + m_slotsOffset + ( pos & ( m_slotsCount - 1 ) ) * m_slotSize );
+			}
+
+			uint8_t* payload( SlotHeader& s ) const { return (uint8_t*)&s + slotHeaderSize; }
+
+			size_t payloadCapacity() const { return m_slotSize - slotHeaderSize; }
+
+			// Pointer to the range of the arena, or nullptr if the range is outside of the arena
+			uint8_t* arena( uint64_t offset, uint64_t length ) const
+			{
+				if( offset > m_arenaSize || length > m_arenaSize - offset )
+					return nullptr;
+				return m_base + m_arenaOffset + offset;
+			}
+
+			// Wait until the sequence number of the slot equals the value. Returns false when the channel is closed, or the other process has exited.
+			bool waitSequence( SlotHeader& s, uint32_t value, off_t peerByte ) const
+			{
+				// The other process usually responds within microseconds, yielding is cheaper than sleeping in the kernel
+				for( int i = 0; i < 64; i++ )
+				{
+					if( s.sequence.load( std::memory_order_acquire ) == value )
+						return true;
+					std::this_thread::yield();
+				}
+
+				while( true )
+				{
+					// The waiters + recheck protocol ensures the other side never skips the wake, both are sequentially consistent
+					s.waiters.fetch_add( 1 );
+					const uint32_t seq = s.sequence.load();
+					if( seq != value )
+						futexWait( s.sequence, seq, 100 );
+					s.waiters.fetch_sub( 1 );
+					if( s.sequence.load() == value )
+						return true;
+					if( !peerAlive( peerByte ) )
+						return false;
+				}
+			}
+		};
+
+		// The client end of the channel: creates the mapping, and allocates the arena.
+		class ClientChannel : public SharedMapping
+		{
+			std::string m_name;
+			std::mutex m_arenaLock;
+			// Free ranges of the arena, offset => size
+			std::map<uint64_t, uint64_t> m_free;
+			std::atomic_bool m_closed;
+
+			static size_t roundUp( size_t x, size_t alignment )
+			{
+				return ( x + alignment - 1 ) / alignment * alignment;
+			}
+
+		public:
+
+			uint32_t outputCapacity = 0;
+
+			ClientChannel() : m_closed( false ) { }
+
+			~ClientChannel()
+			{
+				close();
+			}
+
+			HRESULT create( LPCTSTR name, const SharedMemoryOptions& options )
+			{
+				if( nullptr == name )
+					return E_POINTER;
+				if( options.slots < 4 || 0 != ( options.slots & ( options.slots - 1 ) ) || options.slotPayload < 256 || 0 == options.arenaSize )
+					return E_INVALIDARG;
+
+				const size_t slotSize = roundUp( slotHeaderSize + options.slotPayload, 64 );
+				const size_t arenaOffset = roundUp( sharedHeaderSize + slotSize * options.slots, 4096 );
+				const size_t arenaSize = roundUp( (size_t)options.arenaSize, 4096 );
+				const size_t size = arenaOffset + arenaSize;
+
+				m_fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600 );
+				if( m_fd < 0 )
+					return hresultFromErrno();
+				m_name = name;
+				HRESULT hr = S_OK;
+				if( 0 != ftruncate( m_fd, (off_t)size ) )
+					hr = hresultFromErrno();
+				else
+					hr = map( size );
+				if( SUCCEEDED( hr ) )
+					hr = lockByte( clientLockByte );
+				if( FAILED( hr ) )
+				{
+					shm_unlink( name );
+					m_name.clear();
+					return hr;
+				}
+
+				m_slotsCount = options.slots;
+				m_slotSize = slotSize;
+				m_slotsOffset = sharedHeaderSize;
+				m_arenaOffset = arenaOffset;
+				m_arenaSize = arenaSize;
+				outputCapacity = options.outputCapacity;
+				m_free[ 0 ] = arenaSize;
+
+				// ftruncate zeroed the memory, only need to set the non-zero fields
+				SharedHeader& h = header();
+				h.version = sharedMemoryVersion;
+				h.mappingSize = size;
+				h.slotsCount = m_slotsCount;
+				h.slotSize = (uint32_t)m_slotSize;
+				h.slotsOffset = m_slotsOffset;
+				h.arenaOffset = m_arenaOffset;
+				h.arenaSize = m_arenaSize;
+				for( uint32_t i = 0; i < m_slotsCount; i++ )
+					slot( i ).sequence.store( i, std::memory_order_relaxed );
+				h.magic.store( sharedMemoryMagic );
+				return S_OK;
+			}
+
+			bool closed() const { return m_closed.load(); }
+
+			// Mark the channel as closed and remove the name. The server process returns from serve(), the mapping stays alive while there're references to this object.
+			void close()
+			{
+				if( m_closed.exchange( true ) || nullptr == m_base )
+					return;
+				header().clientClosed.store( 1 );
+				for( uint32_t i = 0; i < m_slotsCount; i++ )
+					futexWake( slot( i ).sequence );
+				shm_unlink( m_name.c_str() );
+			}
+
+			// Wait for the server to start serving
+			HRESULT waitForServer( int timeoutMs )
+			{
+				using Clock = std::chrono::steady_clock;
+				const auto deadline = Clock::now() + std::chrono::milliseconds( timeoutMs );
+				SharedHeader& h = header();
+				while( true )
+				{
+					const uint32_t state = h.serverState.load();
+					if( serverServing == state )
+						return S_OK;
+					if( serverStopped == state || m_closed.load() )
+						return RPC_E_DISCONNECTED;
+					const auto now = Clock::now();
+					if( now >= deadline )
+						return E_TIMEOUT;
+					const int ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>( deadline - now ).count();
+					futexWait( h.serverState, state, std::min( std::max( ms, 1 ), 100 ) );
+				}
+			}
+
+			HRESULT allocate( uint64_t size, uint64_t& offset )
+			{
+				size = roundUp( (size_t)std::max( size, (uint64_t)1 ), arenaAlignment );
+				std::lock_guard<std::mutex> lock( m_arenaLock );
+				// First fit, the blocks are usually short-lived
+				for( auto it = m_free.begin(); it != m_free.end(); it++ )
+				{
+					if( it->second < size )
+						continue;
+					offset = it->first;
+					const uint64_t rest = it->second - size;
+					m_free.erase( it );
+					if( rest > 0 )
+						m_free[ offset + size ] = rest;
+					return S_OK;
+				}
+				return E_OUTOFMEMORY;
+			}
+
+			void free( uint64_t offset, uint64_t size )
+			{
+				size = roundUp( (size_t)std::max( size, (uint64_t)1 ), arenaAlignment );
+				std::lock_guard<std::mutex> lock( m_arenaLock );
+				auto it = m_free.emplace( offset, size ).first;
+				// Merge with the next free range, then with the previous one
+				auto next = std::next( it );
+				if( next != m_free.end() && it->first + it->second == next->first )
+				{
+					it->second += next->second;
+					m_free.erase( next );
+				}
+				if( it != m_free.begin() )
+				{
+					auto prev = std::prev( it );
+					if( prev->first + prev->second == it->first )
+					{
+						prev->second += it->second;
+						m_free.erase( it );
+					}
+				}
+			}
+		};
+
+		// The server end of the channel: opens the mapping created by the client, and validates its geometry.
+		class ServerChannel : public SharedMapping
+		{
+		public:
+
+			HRESULT open( LPCTSTR name )
+			{
+				if( nullptr == name )
+					return E_POINTER;
+				if( m_fd >= 0 )
+					return E_ALREADY_INITIALIZED;
+				m_fd = shm_open( name, O_RDWR | O_CLOEXEC, 0 );
+				if( m_fd < 0 )
+					return hresultFromErrno();
+				struct stat st;
+				if( 0 != fstat( m_fd, &st ) )
+					return hresultFromErrno();
+				if( (size_t)st.st_size < sharedHeaderSize )
+					return E_INVALIDARG;
+				CHECK( map( (size_t)st.st_size ) );
+
+				const SharedHeader& h = header();
+				if( sharedMemoryMagic != h.magic.load() || sharedMemoryVersion != h.version || h.mappingSize != m_size )
+					return E_INVALIDARG;
+				if( h.slotsCount < 4 || 0 != ( h.slotsCount & ( h.slotsCount - 1 ) ) || h.slotSize <= slotHeaderSize || 0 != h.slotSize % 64 || h.slotsOffset < sharedHeaderSize )
+					return E_INVALIDARG;
+				if( h.slotsOffset + (uint64_t)h.slotSize * h.slotsCount > h.arenaOffset || h.arenaOffset > m_size || h.arenaSize > m_size - h.arenaOffset )
+					return E_INVALIDARG;
+				m_slotsCount = h.slotsCount;
+				m_slotSize = h.slotSize;
+				m_slotsOffset = (size_t)h.slotsOffset;
+				m_arenaOffset = (size_t)h.arenaOffset;
+				m_arenaSize = h.arenaSize;
+				// Fails when another server is attached to the channel
+				return lockByte( serverLockByte );
+			}
+		};
+
+		// The stream in the arena of the channel, recognized by the proxies so they pass the offset instead of the data
+		struct SharedBlock
+		{
+			std::shared_ptr<ClientChannel> channel;
+			uint64_t offset = 0;
+			uint64_t capacity = 0;
+			// Count of bytes written, and the read position
+			int64_t length = 0;
+			int64_t position = 0;
+		};
+
+		struct DECLSPEC_NOVTABLE iSharedMemoryBlock : public IUnknown
+		{
+			DEFINE_INTERFACE_ID( "3f6f0b54-92c7-4d3e-a1a8-6d5e9c2b7f10" );
+
+			virtual SharedBlock* COMLIGHTCALL sharedBlock() = 0;
+		};
+	}
+
+	// Stream of a fixed capacity in the memory shared with the server process. Passing it to a remote method costs no copies of the data.
+	// Write the data with iWriteStreamLending::acquireWrite to produce it in place, read the output of the server with iReadStreamLending::acquireRead.
+	// Don't access the stream while a remote call which received it is running.
+	class SharedMemoryStream : public ObjectRoot<iReadStreamLending>, public iWriteStreamLending, public details::iSharedMemoryBlock
+	{
+		details::SharedBlock m_block;
+		uint8_t* m_data = nullptr;
+		bool m_readAcquired = false;
+		bool m_writeAcquired = false;
+
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iReadStream )
+			COM_INTERFACE_ENTRY( iReadStreamLending )
+			COM_INTERFACE_ENTRY( iWriteStream )
+			COM_INTERFACE_ENTRY( iWriteStreamLending )
+			COM_INTERFACE_ENTRY( details::iSharedMemoryBlock )
+		END_COM_MAP()
+
+		bool acquired() const { return m_readAcquired || m_writeAcquired; }
+
+		int64_t capacity() const { return (int64_t)m_block.capacity; }
+
+	public:
+
+		~SharedMemoryStream()
+		{
+			if( m_block.channel )
+				m_block.channel->free( m_block.offset, m_block.capacity );
+		}
+
+		HRESULT initialize( const std::shared_ptr<details::ClientChannel>& channel, int64_t capacity )
+		{
+			if( !channel )
+				return E_POINTER;
+			if( capacity <= 0 )
+				return E_INVALIDARG;
+			if( m_block.channel )
+				return E_ALREADY_INITIALIZED;
+			uint64_t offset;
+			CHECK( channel->allocate( (uint64_t)capacity, offset ) );
+			m_block.channel = channel;
+			m_block.offset = offset;
+			m_block.capacity = (uint64_t)capacity;
+			m_data = channel->arena( offset, m_block.capacity );
+			return S_OK;
+		}
+
+		// Direct access to the memory, for producers which fill the complete stream
+		uint8_t* data() const { return m_data; }
+
+		// Set the count of bytes written directly to data(), and rewind the read position
+		HRESULT setLength( int64_t length )
+		{
+			if( length < 0 || length > capacity() )
+				return E_BOUNDS;
+			m_block.length = length;
+			m_block.position = 0;
+			return S_OK;
+		}
+
+		details::SharedBlock* COMLIGHTCALL sharedBlock() override
+		{
+			return &m_block;
+		}
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			if( acquired() )
+				return E_ACCESSDENIED;
+			if( nNumberOfBytesToRead < 0 )
+				return E_INVALIDARG;
+			const int64_t cb = std::max( std::min( (int64_t)nNumberOfBytesToRead, m_block.length - m_block.position ), (int64_t)0 );
+			if( cb > 0 )
+			{
+				memcpy( lpBuffer, m_data + m_block.position, (size_t)cb );
+				m_block.position += cb;
+			}
+			lpNumberOfBytesRead = (int)cb;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override
+		{
+			if( acquired() )
+				return E_ACCESSDENIED;
+			int64_t pos;
+			switch( origin )
+			{
+			case eSeekOrigin::Begin: pos = offset; break;
+			case eSeekOrigin::Current: pos = m_block.position + offset; break;
+			case eSeekOrigin::End: pos = m_block.length + offset; break;
+			default: return E_INVALIDARG;
+			}
+			if( pos < 0 )
+				return E_INVALIDARG;
+			m_block.position = pos;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override
+		{
+			position = m_block.position;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			length = m_block.length;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL acquireRead( const void** ppData, int64_t& length ) override
+		{
+			if( nullptr == ppData )
+				return E_POINTER;
+			if( acquired() )
+				return E_ACCESSDENIED;
+			const int64_t cb = std::max( m_block.length - m_block.position, (int64_t)0 );
+			*ppData = ( cb > 0 ) ? m_data + m_block.position : nullptr;
+			length = cb;
+			m_readAcquired = true;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL releaseRead( int64_t consumed ) override
+		{
+			if( !m_readAcquired )
+				return E_UNEXPECTED;
+			if( consumed < 0 || consumed > std::max( m_block.length - m_block.position, (int64_t)0 ) )
+				return E_BOUNDS;
+			m_block.position += consumed;
+			m_readAcquired = false;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL write( const void* lpBuffer, int nNumberOfBytesToWrite ) override
+		{
+			if( acquired() )
+				return E_ACCESSDENIED;
+			if( nNumberOfBytesToWrite < 0 )
+				return E_INVALIDARG;
+			if( nNumberOfBytesToWrite > capacity() - m_block.length )
+				return E_BOUNDS;
+			memcpy( m_data + m_block.length, lpBuffer, (size_t)nNumberOfBytesToWrite );
+			m_block.length += nNumberOfBytesToWrite;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL flush() override
+		{
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL acquireWrite( int64_t minLength, void** ppData, int64_t& length ) override
+		{
+			if( nullptr == ppData )
+				return E_POINTER;
+			if( minLength < 0 )
+				return E_INVALIDARG;
+			if( acquired() )
+				return E_ACCESSDENIED;
+			const int64_t available = capacity() - m_block.length;
+			if( minLength > available )
+				return E_BOUNDS;
+			*ppData = m_data + m_block.length;
+			length = available;
+			m_writeAcquired = true;
+			return S_OK;
+		}
+
+		HRESULT COMLIGHTCALL commitWrite( int64_t written ) override
+		{
+			if( !m_writeAcquired )
+				return E_UNEXPECTED;
+			if( written < 0 || written > capacity() - m_block.length )
+				return E_BOUNDS;
+			m_block.length += written;
+			m_writeAcquired = false;
+			return S_OK;
+		}
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,259 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include "../comLightCommon.h"
+
+namespace ComLight
+{
+	namespace details
+	{
+		// Objects with zero reference counter waiting to be destroyed by a background thread.
+		// Bounded lock-free multi-producer single-consumer ring, the producers are the threads calling Release, the consumer is the reclamation thread.
+		// The mutex and condition variables are only used when the reclamation thread is idle, or when a thread waits in flush().
+		class ReclamationQueue
+		{
+			using pfnDestroy = void( *)( void* );
+
+			struct Cell
+			{
+				// Vyukov's sequence number: equal to the position when the cell is free for the producer, position + 1 when it contains an entry
+				std::atomic_size_t sequence;
+				pfnDestroy destroy;
+				void* object;
+			};
+
+			static constexpr size_t capacity = 1 << 16;
+			static constexpr size_t mask = capacity - 1;
+			// The reclamation thread dequeues up to that many entries before destroying them
+			static constexpr size_t batchSize = 256;
+
+			std::unique_ptr<Cell[]> m_cells;
+			// Padding instead of alignas, C++14 operator new doesn't support over-aligned types.
+			uint8_t m_pad0[ 64 ];
+			std::atomic_size_t m_enqueuePos;
+			uint8_t m_pad1[ 64 ];
+			// Only modified by the reclamation thread
+			std::atomic_size_t m_dequeuePos;
+			// Count of destroyed objects, lags behind m_dequeuePos while the batch is being destroyed
+			std::atomic_size_t m_destroyed;
+			uint8_t m_pad2[ 64 ];
+
+			std::atomic_bool m_consumerSleeping;
+			std::atomic_uint m_flushWaiters;
+			std::mutex m_lock;
+			std::condition_variable m_wakeConsumer, m_flushed;
+			std::thread::id m_threadId;
+			bool m_running = false;
+
+			size_t dequeueBatch( pfnDestroy* destroy, void** objects )
+			{
+				size_t pos = m_dequeuePos.load( std::memory_order_relaxed );
+				size_t count = 0;
+				for( ; count < batchSize; count++, pos++ )
+				{
+					Cell& c = m_cells[ pos & mask ];
+					if( c.sequence.load( std::memory_order_acquire ) != pos + 1 )
+						break;
+					destroy[ count ] = c.destroy;
+					objects[ count ] = c.object;
+					c.sequence.store( pos + capacity, std::memory_order_release );
+				}
+				m_dequeuePos.store( pos, std::memory_order_relaxed );
+				return count;
+			}
+
+			size_t pending() const
+			{
+				return m_enqueuePos.load( std::memory_order_relaxed ) - m_dequeuePos.load( std::memory_order_relaxed );
+			}
+
+			bool empty() const
+			{
+				const size_t pos = m_dequeuePos.load( std::memory_order_relaxed );
+				return m_cells[ pos & mask ].sequence.load() != pos + 1;
+			}
+
+			void threadMain()
+			{
+				pfnDestroy destroy[ batchSize ];
+				void* objects[ batchSize ];
+				// After waking up, the thread waits that long for more objects, unless the queue is half full or a thread is flushing
+				const std::chrono::milliseconds gatherDelay{ 10 };
+				while( true )
+				{
+					const size_t count = dequeueBatch( destroy, objects );
+					if( count > 0 )
+					{
+						for( size_t i = 0; i < count; i++ )
+							destroy[ i ]( objects[ i ] );
+						m_destroyed.fetch_add( count );
+						if( m_flushWaiters.load() > 0 )
+						{
+							std::lock_guard<std::mutex> lock( m_lock );
+							m_flushed.notify_all();
+						}
+						continue;
+					}
+
+					// The flag + recheck protocol ensures the producers never skip the notification, the flag and the sequence numbers are sequentially consistent
+					std::unique_lock<std::mutex> lock( m_lock );
+					m_consumerSleeping.store( true );
+					while( empty() )
+						m_wakeConsumer.wait( lock );
+					m_consumerSleeping.store( false );
+
+					// Let more objects accumulate, so they're destroyed in a batch. While this thread is awake, releasing objects doesn't make system calls.
+					m_wakeConsumer.wait_for( lock, gatherDelay, [ this ]() { return m_flushWaiters.load() > 0 || pending() >= capacity / 2; } );
+				}
+			}
+
+			ReclamationQueue() :
+				m_enqueuePos( 0 ), m_dequeuePos( 0 ), m_destroyed( 0 ),
+				m_consumerSleeping( false ), m_flushWaiters( 0 )
+			{
+				try
+				{
+					m_cells.reset( new Cell[ capacity ] );
+					for( size_t i = 0; i < capacity; i++ )
+						m_cells[ i ].sequence.store( i, std::memory_order_relaxed );
+					std::thread t( &ReclamationQueue::threadMain, this );
+					m_threadId = t.get_id();
+					t.detach();
+					m_running = true;
+				}
+				catch( const std::bad_alloc& ) { }
+				catch( const std::system_error& ) { }
+			}
+
+		public:
+
+			// The queue is created on first use, and never destroyed: objects can be released by other static destructors while the process is shutting down.
+			// Entries still in the queue when the process exits are not destroyed, call flushDeferredDestruction() before that if their destructors have side effects.
+			static ReclamationQueue& instance()
+			{
+				static ReclamationQueue* const q = new ReclamationQueue();
+				return *q;
+			}
+
+			// Returns false when the queue is full, or the reclamation thread failed to start; the caller should destroy the object immediately.
+			bool push( pfnDestroy destroy, void* object )
+			{
+				if( !m_running || std::this_thread::get_id() == m_threadId )
+					return false;	// Destructors releasing more objects on the reclamation thread destroy them right away
+
+				size_t pos = m_enqueuePos.load( std::memory_order_relaxed );
+				Cell* c;
+				while( true )
+				{
+					c = &m_cells[ pos & mask ];
+					const size_t seq = c->sequence.load( std::memory_order_acquire );
+					const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+					if( 0 == diff )
+					{
+						if( m_enqueuePos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+							break;
+					}
+					else if( diff < 0 )
+						return false;	// Full
+					else
+						pos = m_enqueuePos.load( std::memory_order_relaxed );
+				}
+				c->destroy = destroy;
+				c->object = object;
+				c->sequence.store( pos + 1 );
+
+				if( m_consumerSleeping.load() || pos - m_dequeuePos.load( std::memory_order_relaxed ) == capacity / 2 )
+				{
+					std::lock_guard<std::mutex> lock( m_lock );
+					m_wakeConsumer.notify_one();
+				}
+				return true;
+			}
+
+			// Wait until all objects queued before the call are destroyed, including the ones released by their destructors
+			HRESULT flush()
+			{
+				if( !m_running )
+					return S_FALSE;
+				if( std::this_thread::get_id() == m_threadId )
+					return E_UNEXPECTED;	// Would wait forever
+
+				while( true )
+				{
+					const size_t target = m_enqueuePos.load();
+					if( m_destroyed.load() >= target )
+						return S_OK;
+					std::unique_lock<std::mutex> lock( m_lock );
+					m_flushWaiters.fetch_add( 1 );
+					m_wakeConsumer.notify_one();
+					m_flushed.wait( lock, [ this, target ]() { return m_destroyed.load() >= target; } );
+					m_flushWaiters.fetch_sub( 1 );
+				}
+			}
+		};
+	}
+
+	// Default destruction policy of Object<T>: the thread which released the last reference runs FinalRelease and the destructor.
+	struct ImmediateDestruction
+	{
+		template<class TObject>
+		static inline void destroy( TObject* p )
+		{
+			p->finalDestroy();
+		}
+	};
+
+	// Destruction policy which hands the released objects to a background thread, which runs FinalRelease and the destructor in batches.
+	// Use DECLARE_DEFERRED_DESTRUCTION() macro in your class to enable. Good for objects with expensive destructors, like large buffers or file handles, released on latency-sensitive threads.
+	// When the queue is full, the objects are destroyed immediately by the releasing thread.
+	struct DeferredDestruction
+	{
+		template<class TObject>
+		static void destroyThunk( void* p )
+		{
+			static_cast<TObject*>( p )->finalDestroy();
+		}
+
+		template<class TObject>
+		static inline void destroy( TObject* p )
+		{
+			if( !details::ReclamationQueue::instance().push( &destroyThunk<TObject>, p ) )
+				p->finalDestroy();
+		}
+	};
+
+	// Wait for the background thread to destroy all objects released so far with DeferredDestruction policy. Call before shutdown, and in tests.
+	// Returns S_FALSE if the background thread failed to start, E_UNEXPECTED when called from a destructor running on that thread.
+	inline HRESULT flushDeferredDestruction()
+	{
+		return details::ReclamationQueue::instance().flush();
+	}
+
+	namespace details
+	{
+		template<class T, class = void>
+		struct destructionPolicy
+		{
+			using type = ImmediateDestruction;
+		};
+
+		template<class T>
+		struct destructionPolicy<T, decltype( (void)( typename T::comLightDestructionPolicy* )nullptr )>
+		{
+			using type = typename T::comLightDestructionPolicy;
+		};
+	}
+}
+
+// Place this macro in your object class to destroy the objects on a background thread, instead of the thread which released the last reference.
+#define DECLARE_DEFERRED_DESTRUCTION()                                 \
+public:                                                                \
+using comLightDestructionPolicy = ComLight::DeferredDestruction;       \
+private:
@@ -3,6 +3,9 @@
 #include "../comLightClient.h"
 #include "../utils/typeTraits.hpp"
 #include "../Exception.hpp"
+#include "ObjectPool.hpp"
+#include "DeferredDestruction.hpp"
+#include "queryCache.hpp"
 
 namespace ComLight
 {
@@ -11,95 +14,140 @@ namespace ComLight
 		GENERATE_HAS_MEMBER( implQueryInterface );
 		GENERATE_HAS_MEMBER( implAddRef );
 		GENERATE_HAS_MEMBER( implRelease );
-	}
-
-	// Outer class of objects, implements IUnknown methods, also the class factory. The type argument must be your class implementing your interfaces, inherited from ObjectRoot<I>
-	template<class T>
-	class Object : public T
-	{
-	public:
-		Object() = default;
-		inline virtual ~Object() override { }
 
-		// Implement IUnknown methods
-		HRESULT COMLIGHTCALL QueryInterface( REFIID riid, void **ppvObject ) override
+		// Implementation of Object<T>, TOuter is the Object<T> class
+		template<class T, class TOuter>
+		class ObjectImpl : public T
 		{
-			static_assert( details::has_member_implQueryInterface<T>::value, "Your object class must inherit from ComLight::ObjectRoot" );
+			using AllocationPolicy = typename details::allocationPolicy<T>::type;
+			using DestructionPolicy = typename details::destructionPolicy<T>::type;
+			friend DestructionPolicy;
+
+			// Called by the destruction policy when the reference counter reaches zero
+			void finalDestroy()
+			{
+				T::FinalRelease();
+				delete static_cast<TOuter*>( this );
+			}
+
+			bool queryInterfaceMap( REFIID riid, void **ppvObject, std::false_type )
+			{
+				return T::implQueryInterface( riid, ppvObject );
+			}
+
+			// DECLARE_QUERY_INTERFACE_CACHE() version, consults the per-thread cache before the interface map
+			bool queryInterfaceMap( REFIID riid, void **ppvObject, std::true_type )
+			{
+				using Cache = details::QueryCache<TOuter>;
+				if( Cache::lookup( static_cast<TOuter*>( this ), riid, ppvObject ) )
+					return true;
+				if( !T::implQueryInterface( riid, ppvObject ) )
+					return false;
+				Cache::store( static_cast<TOuter*>( this ), riid, *ppvObject );
+				return true;
+			}
+
+		public:
+
+			// Implement IUnknown methods
+			HRESULT COMLIGHTCALL QueryInterface( REFIID riid, void **ppvObject ) override
+			{
+				static_assert( details::has_member_implQueryInterface<T>::value, "Your object class must inherit from ComLight::ObjectRoot" );
 			
-			if( nullptr == ppvObject )
-				return E_POINTER;
+				if( nullptr == ppvObject )
+					return E_POINTER;
 
-			if( T::implQueryInterface( riid, ppvObject ) )
-				return S_OK;
-			if( T::queryExtraInterfaces( riid, ppvObject ) )
-				return S_OK;
+				if( queryInterfaceMap( riid, ppvObject, details::hasQueryCache<T>{} ) )
+					return S_OK;
+				if( T::queryExtraInterfaces( riid, ppvObject ) )
+					return S_OK;
 
-			if( riid == IUnknown::iid() )
+				if( riid == IUnknown::iid() )
+				{
+					ComLight::IUnknown* unk = T::getUnknown();
+					unk->AddRef();
+					*ppvObject = unk;
+					return S_OK;
+				}
+
+				return E_NOINTERFACE;
+			}
+
+			uint32_t COMLIGHTCALL AddRef() override
 			{
-				ComLight::IUnknown* unk = T::getUnknown();
-				unk->AddRef();
-				*ppvObject = unk;
-				return S_OK;
+				static_assert( details::has_member_implAddRef<T>::value, "Your object class must inherit from ComLight::ObjectRoot" );
+				return T::implAddRef();
 			}
 
-			return E_NOINTERFACE;
-		}
+			uint32_t COMLIGHTCALL Release() override
+			{
+				static_assert( details::has_member_implRelease<T>::value, "Your object class must inherit from ComLight::ObjectRoot" );
+				const uint32_t ret = T::implRelease();
+				if( 0 == ret )
+					DestructionPolicy::destroy( static_cast<TOuter*>( this ) );
+				return ret;
+			}
 
-		uint32_t COMLIGHTCALL AddRef() override
-		{
-			static_assert( details::has_member_implAddRef<T>::value, "Your object class must inherit from ComLight::ObjectRoot" );
-			return T::implAddRef();
-		}
+			// Route the memory of the objects through the allocation policy. By default that's the heap, DECLARE_POOLED_ALLOCATION() macro switches to the pool.
+			static inline void* operator new( size_t cb )
+			{
+				return AllocationPolicy::template allocate<TOuter>( cb );
+			}
 
-		uint32_t COMLIGHTCALL Release() override
-		{
-			static_assert( details::has_member_implRelease<T>::value, "Your object class must inherit from ComLight::ObjectRoot" );
-			const uint32_t ret = T::implRelease();
-			if( 0 == ret )
+			static inline void operator delete( void* p )
 			{
-				T::FinalRelease();
-				delete this;
+				AllocationPolicy::template deallocate<TOuter>( p );
 			}
-			return ret;
-		}
 
-		// Create a new object on the heap, store in smart pointer
-		static inline HRESULT create( CComPtr<Object<T>>& result )
-		{
-			CComPtr<Object<T>> ptr;
-			try
+			// Create a new object on the heap, store in smart pointer
+			static inline HRESULT create( CComPtr<TOuter>& result )
 			{
-				ptr = new Object<T>();	// The RefCounter constructor creates it with ref.counter 0. But then CComPtr constructor calls AddRef so we have RC=1 after this line.
+				CComPtr<TOuter> ptr;
+				try
+				{
+					ptr = new TOuter();	// The RefCounter constructor creates it with ref.counter 0. But then CComPtr constructor calls AddRef so we have RC=1 after this line.
 
-				HRESULT hr = ptr->internalFinalConstruct();
-				if( FAILED( hr ) )
-					return hr;
+					HRESULT hr = ptr->internalFinalConstruct();
+					if( FAILED( hr ) )
+						return hr;
 
-				hr = ptr->FinalConstruct();
-				if( FAILED( hr ) )
-					return hr;
+					hr = ptr->FinalConstruct();
+					if( FAILED( hr ) )
+						return hr;
 
-				ptr.swap( result );
-				return S_OK;
+					ptr.swap( result );
+					return S_OK;
+				}
+				catch( const Exception& ex )
+				{
+					return ex.code();
+				}
 			}
-			catch( const Exception& ex )
+
+			// Create a new object on the heap, return one of it's interfaces. The caller is assumed to take ownership of the new object.
+			template<class I>
+			static inline HRESULT create( I** pp )
 			{
-				return ex.code();
+				if( pp == nullptr )
+					return E_POINTER;
+
+				static_assert( details::pointersAssignable<I, T>(), "Object::create can't cast object to the requested interface" );
+				CComPtr<TOuter> ptr;
+				CHECK( create( ptr ) );
+				ptr.detach( pp );
+				return S_OK;
 			}
-		}
+		};
+	}
 
-		// Create a new object on the heap, return one of it's interfaces. The caller is assumed to take ownership of the new object.
-		template<class I>
-		static inline HRESULT create( I** pp )
-		{
-			if( pp == nullptr )
-				return E_POINTER;
-
-			static_assert( details::pointersAssignable<I, T>(), "Object::create can't cast object to the requested interface" );
-			CComPtr<Object<T>> ptr;
-			CHECK( create( ptr ) );
-			ptr.detach( pp );
-			return S_OK;
-		}
-	};
+	// Outer class of objects, implements IUnknown methods, also the class factory. The type argument must be your class implementing your interfaces, inherited from ObjectRoot<I> or CompactObjectRoot<I>
+	// Release() deletes the object as Object<T>. When T has no virtual destructor, e.g. CompactObjectRoot, Object<T> is final, and classes derived from it fail to compile instead of being destroyed incorrectly.
+	template<class T, bool = std::has_virtual_destructor<T>::value>
+	class Object;
+
+	template<class T>
+	class Object<T, true> : public details::ObjectImpl<T, Object<T, true>> { };
+
+	template<class T>
+	class Object<T, false> final : public details::ObjectImpl<T, Object<T, false>> { };
 }
\ No newline at end of file
@@ -0,0 +1,229 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <assert.h>
+#include <mutex>
+
+namespace ComLight
+{
+	// Default allocation policy of Object<T>, plain C++ heap.
+	struct HeapAllocation
+	{
+		template<class TObject>
+		static inline void* allocate( size_t cb )
+		{
+			return ::operator new( cb );
+		}
+
+		template<class TObject>
+		static inline void deallocate( void* p )
+		{
+			::operator delete( p );
+		}
+	};
+
+	namespace details
+	{
+		// Free-list pool of fixed-size memory blocks, one pool per type of objects.
+		// Each thread has a small cache of free blocks, refilled from / drained into the global list in batches, so most allocations don't touch the mutex.
+		// Blocks released on another thread go to the cache of that thread, that's fine, they're all the same size.
+		template<class TObject>
+		class ObjectPool
+		{
+			struct Block
+			{
+				Block* next;
+			};
+
+			static constexpr size_t cbBlock = sizeof( TObject ) > sizeof( Block ) ? sizeof( TObject ) : sizeof( Block );
+			// How many blocks a thread moves to or from the global list at once
+			static constexpr uint32_t batchSize = 64;
+			// When a thread has that many free blocks, it gives a batch back to the global list
+			static constexpr uint32_t maxThreadCache = batchSize * 4;
+
+			// Singly-linked list of free blocks
+			struct FreeList
+			{
+				Block* head = nullptr;
+				uint32_t count = 0;
+
+				void push( void* p )
+				{
+					Block* const b = static_cast<Block*>( p );
+					b->next = head;
+					head = b;
+					count++;
+				}
+
+				void* pop()
+				{
+					Block* const b = head;
+					head = b->next;
+					count--;
+					return b;
+				}
+
+				// Detach up to maxCount blocks from the head of this list, return the first one of them
+				Block* detachBatch( uint32_t maxCount, uint32_t& detached )
+				{
+					Block* const first = head;
+					Block* last = head;
+					uint32_t n = 1;
+					while( n < maxCount && nullptr != last->next )
+					{
+						last = last->next;
+						n++;
+					}
+					head = last->next;
+					last->next = nullptr;
+					count -= n;
+					detached = n;
+					return first;
+				}
+			};
+
+			struct GlobalList
+			{
+				std::mutex lock;
+				FreeList list;
+
+				void pushBatch( Block* first, uint32_t count )
+				{
+					Block* last = first;
+					while( nullptr != last->next )
+						last = last->next;
+
+					std::lock_guard<std::mutex> guard( lock );
+					last->next = list.head;
+					list.head = first;
+					list.count += count;
+				}
+
+				Block* popBatch( uint32_t& count )
+				{
+					std::lock_guard<std::mutex> guard( lock );
+					if( nullptr == list.head )
+					{
+						count = 0;
+						return nullptr;
+					}
+					return list.detachBatch( batchSize, count );
+				}
+			};
+
+			// Created on first use and never destroyed, pooled objects can be released by other static destructors while the process is shutting down
+			static GlobalList& global()
+			{
+				static GlobalList* const g = new GlobalList();
+				return *g;
+			}
+
+			// Set when the cache of the calling thread was destroyed. Trivially destructible, so it stays usable by the destructors which run after the cache's.
+			static bool& cacheDestroyed()
+			{
+				static thread_local bool destroyed = false;
+				return destroyed;
+			}
+
+			struct ThreadCache
+			{
+				FreeList list;
+
+				~ThreadCache()
+				{
+					// Thread is exiting, return all cached blocks to the global list
+					if( nullptr != list.head )
+						global().pushBatch( list.head, list.count );
+					list.head = nullptr;
+					list.count = 0;
+					cacheDestroyed() = true;
+				}
+			};
+
+			static ThreadCache& threadCache()
+			{
+				static thread_local ThreadCache tc;
+				return tc;
+			}
+
+		public:
+
+			static void* allocate( size_t cb )
+			{
+				assert( cb <= cbBlock );
+				if( cacheDestroyed() )
+					return ::operator new( cbBlock );
+				ThreadCache& tc = threadCache();
+				if( nullptr == tc.list.head )
+				{
+					uint32_t count;
+					Block* const batch = global().popBatch( count );
+					if( nullptr == batch )
+						return ::operator new( cbBlock );
+					tc.list.head = batch;
+					tc.list.count = count;
+				}
+				return tc.list.pop();
+			}
+
+			static void deallocate( void* p )
+			{
+				if( cacheDestroyed() )
+				{
+					// Late release from a thread-local destructor, bypass the cache
+					Block* const b = static_cast<Block*>( p );
+					b->next = nullptr;
+					global().pushBatch( b, 1 );
+					return;
+				}
+				ThreadCache& tc = threadCache();
+				tc.list.push( p );
+				if( tc.list.count < maxThreadCache )
+					return;
+				uint32_t count;
+				Block* const batch = tc.list.detachBatch( batchSize, count );
+				global().pushBatch( batch, count );
+			}
+		};
+	}
+
+	// Allocation policy which recycles memory of released objects with a per-type, thread-caching free list.
+	// Use DECLARE_POOLED_ALLOCATION() macro in your class to enable.
+	// Good for small objects which are created and destroyed at high frequency. The memory is never returned to the OS while the process is running.
+	struct PooledAllocation
+	{
+		template<class TObject>
+		static inline void* allocate( size_t cb )
+		{
+			return details::ObjectPool<TObject>::allocate( cb );
+		}
+
+		template<class TObject>
+		static inline void deallocate( void* p )
+		{
+			details::ObjectPool<TObject>::deallocate( p );
+		}
+	};
+
+	namespace details
+	{
+		template<class T, class = void>
+		struct allocationPolicy
+		{
+			using type = HeapAllocation;
+		};
+
+		template<class T>
+		struct allocationPolicy<T, decltype( (void)( typename T::comLightAllocationPolicy* )nullptr )>
+		{
+			using type = typename T::comLightAllocationPolicy;
+		};
+	}
+}
+
+// Place this macro in your object class to allocate the objects from the pool instead of the heap.
+#define DECLARE_POOLED_ALLOCATION()                           \
+public:                                                       \
+using comLightAllocationPolicy = ComLight::PooledAllocation;  \
+private:
@@ -5,47 +5,61 @@
 
 namespace ComLight
 {
-	// Base class of objects, implements reference counting, also a few lifetime methods.
-	// The template argument is the interface you want clients to get when they ask for IID_IUnknown. By convention, that pointer defines object's identity.
-	template<class I>
-	class ObjectRoot : public RefCounter, public I
+	namespace details
 	{
-	protected:
-
-		inline HRESULT internalFinalConstruct()
+		// Lifetime methods and the default interface map, shared by ObjectRoot and CompactObjectRoot. The base classes are the reference counter and the interface, in the order of the layout.
+		template<class I, class TFirstBase, class TSecondBase>
+		class ObjectRootImpl : public TFirstBase, public TSecondBase
 		{
-			return S_FALSE;
-		}
+		protected:
 
-		inline HRESULT FinalConstruct()
-		{
-			return S_FALSE;
-		}
+			inline HRESULT internalFinalConstruct()
+			{
+				return S_FALSE;
+			}
 
-		inline void FinalRelease() { }
+			inline HRESULT FinalConstruct()
+			{
+				return S_FALSE;
+			}
 
-		IUnknown* getUnknown()
-		{
-			static_assert( details::pointersAssignable<IUnknown, I>(), "The interface doesn't derive from IUnknown" );
-			return static_cast<I*>( this );
-		}
+			inline void FinalRelease() { }
 
-		bool queryExtraInterfaces( REFIID riid, void **ppvObject ) const
-		{
-			return false;
-		}
+			IUnknown* getUnknown()
+			{
+				static_assert( details::pointersAssignable<IUnknown, I>(), "The interface doesn't derive from IUnknown" );
+				return static_cast<I*>( this );
+			}
 
-		// Implement query interface with 2 entries, IUnknown and I.
-		bool implQueryInterface( REFIID riid, void** ppvObject )
-		{
-			if( riid == I::iid() || riid == IUnknown::iid() )
+			bool queryExtraInterfaces( REFIID riid, void **ppvObject ) const
 			{
-				I* const result = this;
-				result->AddRef();
-				*ppvObject = result;
-				return true;
+				return false;
 			}
-			return false;
-		}
-	};
+
+			// Implement query interface with 2 entries, IUnknown and I.
+			bool implQueryInterface( REFIID riid, void** ppvObject )
+			{
+				if( riid == I::iid() || riid == IUnknown::iid() )
+				{
+					I* const result = this;
+					result->AddRef();
+					*ppvObject = result;
+					return true;
+				}
+				return false;
+			}
+		};
+	}
+
+	// Base class of objects, implements reference counting, also a few lifetime methods.
+	// The first template argument is the interface you want clients to get when they ask for IID_IUnknown. By convention, that pointer defines object's identity.
+	// The second one is the reference counting policy: AtomicRefCount, SingleThreadRefCount, or CheckedRefCount.
+	template<class I, class TRefCountPolicy = AtomicRefCount>
+	class ObjectRoot : public details::ObjectRootImpl<I, BasicRefCounter<TRefCountPolicy>, I> { };
+
+	// Same as ObjectRoot, with compact memory layout: the reference counter has no virtual destructor, and it's placed after the vtable pointer of the interface.
+	// The object has one vtable pointer less, and on 64-bit platforms the first 4 bytes of your fields fit in the padding after the 32-bit counter.
+	// The vtables are the same, the objects are binary compatible with the other side of the interop.
+	template<class I, class TRefCountPolicy = AtomicRefCount>
+	class CompactObjectRoot : public details::ObjectRootImpl<I, I, CompactRefCounter<TRefCountPolicy>> { };
 }
\ No newline at end of file
@@ -2,37 +2,167 @@
 #include <atomic>
 #include <assert.h>
 #include <limits.h>
+#include <stdint.h>
 
 namespace ComLight
 {
-	// Very base class of objects, implements reference counting.
-	class RefCounter
+	// Reference counting policies, pass one of them as the second template argument of ObjectRoot.
+
+	// Thread safe reference counter, the default one.
+	class AtomicRefCount
+	{
+		std::atomic_uint counter;
+
+	public:
+
+		AtomicRefCount() : counter( 0 ) { }
+
+		uint32_t increment()
+		{
+			return ++counter;
+		}
+
+		uint32_t decrement()
+		{
+			const uint32_t rc = --counter;
+			assert( rc != UINT_MAX );
+			return rc;
+		}
+	};
+
+	// Non-atomic reference counter. Only use this for objects which never leave the thread which created them, in both C++ and .NET.
+	// Saves the locked RMW instructions in AddRef / Release, and the cache line bouncing they cause.
+	class SingleThreadRefCount
+	{
+		uint32_t counter;
+
+	public:
+
+		SingleThreadRefCount() : counter( 0 ) { }
+
+		uint32_t increment()
+		{
+			return ++counter;
+		}
+
+		uint32_t decrement()
+		{
+			const uint32_t rc = --counter;
+			assert( rc != UINT_MAX );
+			return rc;
+		}
+	};
+
+	// Thread safe reference counter for debugging memory management bugs. Slower than AtomicRefCount, uses CAS loops.
+	// When 2 threads call release at the same time for an object with counter = 1, only one of them wins and destroys the object, the other one asserts.
+	// Same happens when AddRef or Release is called for an object which has already been released. Unless the memory has been reused by then, it's a best effort.
+	// In release builds, the violations are ignored instead of crashing: the loser doesn't destroy the object again.
+	class CheckedRefCount
+	{
+		std::atomic_uint counter;
+
+		// The counter has this value after the final release, until the memory is reused.
+		static constexpr uint32_t releasedMarker = 0xDEADC0DEu;
+
+		static bool isBroken( uint32_t rc )
+		{
+			return 0 == rc || releasedMarker == rc;
+		}
+
+	public:
+
+		CheckedRefCount() : counter( 0 ) { }
+
+		uint32_t increment()
+		{
+			uint32_t rc = counter.load( std::memory_order_relaxed );
+			while( true )
+			{
+				if( releasedMarker == rc )
+				{
+					assert( !"AddRef called for a released object" );
+					return releasedMarker;
+				}
+				if( counter.compare_exchange_weak( rc, rc + 1 ) )
+					return rc + 1;
+			}
+		}
+
+		// Returns 0 to exactly one caller, the one which should destroy the object.
+		uint32_t decrement()
+		{
+			uint32_t rc = counter.load( std::memory_order_relaxed );
+			while( true )
+			{
+				if( isBroken( rc ) )
+				{
+					assert( !"Release called for a released object, or concurrently from multiple threads for the last reference" );
+					return releasedMarker;
+				}
+				const uint32_t newValue = ( 1 == rc ) ? releasedMarker : rc - 1;
+				if( counter.compare_exchange_weak( rc, newValue ) )
+					return ( 1 == rc ) ? 0 : newValue;
+			}
+		}
+	};
+
+	// Very base class of objects, implements reference counting. The template argument is the policy, one of the above classes.
+	template<class TPolicy>
+	class BasicRefCounter
 	{
-		std::atomic_uint referenceCounter;
+		TPolicy referenceCounter;
 
 	public:
 
-		RefCounter() : referenceCounter( 0 ) { }
+		BasicRefCounter() = default;
 
-		inline virtual ~RefCounter() { }
+		inline virtual ~BasicRefCounter() { }
 
-		RefCounter( const RefCounter &that ) = delete;
-		RefCounter( RefCounter &&that ) = delete;
+		BasicRefCounter( const BasicRefCounter &that ) = delete;
+		BasicRefCounter( BasicRefCounter &&that ) = delete;
 
 	protected:
 
 		uint32_t implAddRef()
 		{
-			return ++referenceCounter;
+			return referenceCounter.increment();
 		}
 
 		uint32_t implRelease()
 		{
-			// Might be a good idea to use locks, at least in debug builds. They're much slower than atomics, but with locks it's possible to detect when 2 threads call release at the same time, for object with counter = 1.
-			// It's a memory management bug, but it would be nice if debug builds would handle that case gracefully.
-			const uint32_t rc = --referenceCounter;
-			assert( rc != UINT_MAX );
-			return rc;
+			// For the case when 2 threads call release at the same time for object with counter = 1, use CheckedRefCount policy in debug builds. Atomics alone can't detect that.
+			return referenceCounter.decrement();
 		}
 	};
+
+	// Reference counter without the virtual destructor, the base of CompactObjectRoot. Saves a vtable pointer in every object.
+	// The objects are destroyed by Object<T>::Release which deletes the most derived type, deleting them through a pointer to this class is not supported.
+	template<class TPolicy>
+	class CompactRefCounter
+	{
+		TPolicy referenceCounter;
+
+	public:
+
+		CompactRefCounter() = default;
+
+		CompactRefCounter( const CompactRefCounter &that ) = delete;
+		CompactRefCounter( CompactRefCounter &&that ) = delete;
+
+	protected:
+
+		~CompactRefCounter() = default;
+
+		uint32_t implAddRef()
+		{
+			return referenceCounter.increment();
+		}
+
+		uint32_t implRelease()
+		{
+			return referenceCounter.decrement();
+		}
+	};
+
+	using RefCounter = BasicRefCounter<AtomicRefCount>;
 }
\ No newline at end of file
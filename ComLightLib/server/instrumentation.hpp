@@ -0,0 +1,262 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "../comLightCommon.h"
+
+// Opt-in instrumentation of COM methods: per-method call counts, cumulative time, and latency histograms with power of 2 buckets.
+// Define COMLIGHT_INSTRUMENTATION macro for the whole project to enable, and place INSTRUMENT_METHOD() at the start of the methods you want to measure.
+// The hot path is lock-free: each thread records into its own buffers, the readers sum these buffers.
+namespace ComLight
+{
+	// Statistics of a single method, as exposed to the host
+	struct MethodStats
+	{
+		static constexpr int histogramBuckets = 32;
+
+		// Name of the method, as reported by the compiler
+		const char* name;
+		uint64_t calls;
+		uint64_t totalNanoseconds;
+		// Bucket i counts calls which took [ 2^i, 2^(i+1) ) nanoseconds. The first bucket also counts calls faster than 1ns, the last one also counts longer calls.
+		uint64_t histogram[ histogramBuckets ];
+	};
+
+	// Callback which receives the statistics, one call per method
+	using pfnMethodStats = void( COMLIGHTCALL* )( void* context, const MethodStats* stats );
+
+	namespace details
+	{
+		class Instrumentation
+		{
+		public:
+			static constexpr uint32_t maxMethods = 1024;
+
+		private:
+			struct Slot
+			{
+				std::atomic<uint64_t> calls;
+				std::atomic<uint64_t> totalNanoseconds;
+				std::atomic<uint64_t> histogram[ MethodStats::histogramBuckets ];
+
+				Slot() : calls( 0 ), totalNanoseconds( 0 )
+				{
+					for( auto& h : histogram )
+						h.store( 0, std::memory_order_relaxed );
+				}
+
+				// Only the owning thread writes the slot, plain load + store is enough, no need for locked RMW
+				static void increment( std::atomic<uint64_t>& a, uint64_t val )
+				{
+					a.store( a.load( std::memory_order_relaxed ) + val, std::memory_order_relaxed );
+				}
+
+				void record( uint64_t ns, uint32_t bucket )
+				{
+					increment( calls, 1 );
+					increment( totalNanoseconds, ns );
+					increment( histogram[ bucket ], 1 );
+				}
+
+				void addTo( MethodStats& stats ) const
+				{
+					stats.calls += calls.load( std::memory_order_relaxed );
+					stats.totalNanoseconds += totalNanoseconds.load( std::memory_order_relaxed );
+					for( int i = 0; i < MethodStats::histogramBuckets; i++ )
+						stats.histogram[ i ] += histogram[ i ].load( std::memory_order_relaxed );
+				}
+			};
+
+			// Per-thread buffers, the slots are allocated on first call of the method on that thread
+			struct ThreadBuffers
+			{
+				std::atomic<Slot*> slots[ maxMethods ];
+
+				ThreadBuffers()
+				{
+					for( auto& s : slots )
+						s.store( nullptr, std::memory_order_relaxed );
+					std::lock_guard<std::mutex> lock( global().lock );
+					global().threads.push_back( this );
+				}
+
+				~ThreadBuffers()
+				{
+					// Thread is exiting, merge the statistics into the global totals
+					Global& g = global();
+					std::lock_guard<std::mutex> lock( g.lock );
+					g.threads.erase( std::find( g.threads.begin(), g.threads.end(), this ) );
+					for( uint32_t i = 0; i < maxMethods; i++ )
+					{
+						Slot* const s = slots[ i ].load( std::memory_order_relaxed );
+						if( nullptr == s )
+							continue;
+						s->addTo( g.retired[ i ] );
+						delete s;
+					}
+				}
+
+				Slot& slot( uint32_t method )
+				{
+					Slot* s = slots[ method ].load( std::memory_order_relaxed );
+					if( nullptr != s )
+						return *s;
+					s = new Slot();
+					slots[ method ].store( s, std::memory_order_release );
+					return *s;
+				}
+			};
+
+			struct Global
+			{
+				std::mutex lock;
+				std::vector<ThreadBuffers*> threads;
+				std::vector<const char*> names;
+				// Statistics of the threads which have exited
+				MethodStats retired[ maxMethods ] = {};
+			};
+
+			static Global& global()
+			{
+				// Never destroyed, thread_local buffers of other threads may outlive static destructors
+				static Global* const g = new Global();
+				return *g;
+			}
+
+			static ThreadBuffers& threadBuffers()
+			{
+				static thread_local ThreadBuffers tb;
+				return tb;
+			}
+
+			static uint32_t bucket( uint64_t ns )
+			{
+				uint32_t b = 0;
+				while( ns > 1 && b + 1 < MethodStats::histogramBuckets )
+				{
+					ns >>= 1;
+					b++;
+				}
+				return b;
+			}
+
+		public:
+
+			// Register a method, returns the ID. Called once per instrumented method, from a function-local static initializer.
+			static uint32_t registerMethod( const char* name )
+			{
+				Global& g = global();
+				std::lock_guard<std::mutex> lock( g.lock );
+				const uint32_t id = (uint32_t)g.names.size();
+				if( id >= maxMethods )
+					return UINT32_MAX;
+				g.names.push_back( name );
+				return id;
+			}
+
+			static void record( uint32_t method, uint64_t ns )
+			{
+				if( method >= maxMethods )
+					return;
+				threadBuffers().slot( method ).record( ns, bucket( ns ) );
+			}
+
+			// Sum up the statistics of all threads, call the callback for every method which has been called at least once.
+			// Doesn't block the instrumented methods, the totals can be slightly behind the calls in flight.
+			static void collect( pfnMethodStats callback, void* context )
+			{
+				Global& g = global();
+				std::vector<MethodStats> stats;
+				{
+					std::lock_guard<std::mutex> lock( g.lock );
+					stats.resize( g.names.size() );
+					for( size_t i = 0; i < stats.size(); i++ )
+					{
+						stats[ i ] = g.retired[ i ];
+						stats[ i ].name = g.names[ i ];
+					}
+					for( ThreadBuffers* tb : g.threads )
+					{
+						for( size_t i = 0; i < stats.size(); i++ )
+						{
+							const Slot* const s = tb->slots[ i ].load( std::memory_order_acquire );
+							if( nullptr != s )
+								s->addTo( stats[ i ] );
+						}
+					}
+				}
+				for( const auto& s : stats )
+					if( 0 != s.calls )
+						callback( context, &s );
+			}
+		};
+
+		// Measures the time between construction and destruction, records into the statistics of the method
+		class MethodTimer
+		{
+			const uint32_t m_method;
+			const std::chrono::steady_clock::time_point m_start;
+
+		public:
+
+			MethodTimer( uint32_t method ) : m_method( method ), m_start( std::chrono::steady_clock::now() ) { }
+
+			~MethodTimer()
+			{
+				const auto elapsed = std::chrono::steady_clock::now() - m_start;
+				Instrumentation::record( m_method, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>( elapsed ).count() );
+			}
+		};
+
+		inline void COMLIGHTCALL printMethodStats( void* context, const MethodStats* s )
+		{
+			FILE* const stream = (FILE*)context;
+			fprintf( stream, "%s: %llu calls, %.3f ms total, %.1f ns average\n", s->name,
+				(unsigned long long)s->calls, (double)s->totalNanoseconds * 1E-6, (double)s->totalNanoseconds / (double)s->calls );
+			for( int i = 0; i < MethodStats::histogramBuckets; i++ )
+				if( 0 != s->histogram[ i ] )
+					fprintf( stream, "\t[ %llu ns .. ): %llu\n", 1ull << i, (unsigned long long)s->histogram[ i ] );
+		}
+	}
+
+	// Call the callback once for every instrumented method which has been called at least once. Safe to call at any time, from any thread.
+	inline void collectMethodStats( pfnMethodStats callback, void* context )
+	{
+		details::Instrumentation::collect( callback, context );
+	}
+
+	// Print the statistics in human-readable form
+	inline void printMethodStats( FILE* stream )
+	{
+		details::Instrumentation::collect( &details::printMethodStats, stream );
+	}
+}
+
+#ifdef _MSC_VER
+#define COMLIGHT_FUNCTION_NAME __FUNCTION__
+#else
+#define COMLIGHT_FUNCTION_NAME __PRETTY_FUNCTION__
+#endif
+
+#ifdef COMLIGHT_INSTRUMENTATION
+// Place at the start of a method to record calls count, time and latency histogram of that method
+#define INSTRUMENT_METHOD()                                                                                                   \
+static const uint32_t comLightMethodId = ComLight::details::Instrumentation::registerMethod( COMLIGHT_FUNCTION_NAME );  \
+const ComLight::details::MethodTimer comLightMethodTimer{ comLightMethodId };
+#else
+#define INSTRUMENT_METHOD()
+#endif
+
+// Define an exported function which lets the host collect the statistics without stopping the process: HRESULT name( pfnMethodStats callback, void* context )
+#define DEFINE_METHOD_STATS_EXPORT( name )                                                 \
+DLLEXPORT HRESULT COMLIGHTCALL name( ComLight::pfnMethodStats callback, void* context )   \
+{                                                                                          \
+	if( nullptr == callback )                                                              \
+		return E_POINTER;                                                                  \
+	ComLight::collectMethodStats( callback, context );                                     \
+	return S_OK;                                                                           \
+}
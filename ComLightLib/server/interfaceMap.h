@@ -1,4 +1,8 @@
 #pragma once
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include "../comLightCommon.h"
 #include "../utils/typeTraits.hpp"
 
 // Unlike ATL, the interface map is optional for ComLight.
@@ -13,12 +17,104 @@ namespace ComLight
 {
 	namespace details
 	{
+		template<class T>
+		class TearOffObject;
+	}
+
+	// Base class of tear-off interfaces. A tear-off implements a rarely used interface of the owner object in a small separate object, created on QueryInterface.
+	// The owner doesn't inherit from the interface, saving a vtable pointer in every instance. Derive from this class, implement the methods of I, and use owner() to access the state.
+	// Each successful QueryInterface creates a new tear-off, which keeps the owner alive. QueryInterface of the tear-off forwards other IIDs, including IUnknown, to the owner.
+	template<class TOwner, class I>
+	class TearOffRoot : public I
+	{
+		template<class T>
+		friend class details::TearOffObject;
+
+		TOwner* m_owner = nullptr;
+		IUnknown* m_ownerUnknown = nullptr;
+
+	protected:
+
+		TOwner* owner() const { return m_owner; }
+
+	public:
+
+		using Owner = TOwner;
+		using Interface = I;
+	};
+
+	namespace details
+	{
+		// Outer class of tear-offs, implements IUnknown methods
+		template<class T>
+		class TearOffObject final : public T
+		{
+			std::atomic_uint m_refs;
+
+		public:
+
+			TearOffObject( typename T::Owner* owner, IUnknown* ownerUnknown ) : m_refs( 1 )
+			{
+				this->m_owner = owner;
+				this->m_ownerUnknown = ownerUnknown;
+				ownerUnknown->AddRef();
+			}
+
+			~TearOffObject()
+			{
+				this->m_ownerUnknown->Release();
+			}
+
+			HRESULT COMLIGHTCALL QueryInterface( REFIID riid, void **ppvObject ) override
+			{
+				if( nullptr == ppvObject )
+					return E_POINTER;
+				if( riid == T::Interface::iid() )
+				{
+					typename T::Interface* const result = this;
+					result->AddRef();
+					*ppvObject = result;
+					return S_OK;
+				}
+				return this->m_ownerUnknown->QueryInterface( riid, ppvObject );
+			}
+
+			uint32_t COMLIGHTCALL AddRef() override
+			{
+				return ++m_refs;
+			}
+
+			uint32_t COMLIGHTCALL Release() override
+			{
+				const uint32_t rc = --m_refs;
+				if( 0 == rc )
+					delete this;
+				return rc;
+			}
+		};
+
+		template<typename I, typename TTearOff, typename C>
+		inline bool tryReturnTearOff( REFIID iid, C* pThis, IUnknown* unk, void** ppvResult )
+		{
+			static_assert( std::is_base_of<TearOffRoot<typename TTearOff::Owner, I>, TTearOff>::value, "The tear-off class must inherit from ComLight::TearOffRoot<Owner, I>" );
+			static_assert( pointersAssignable<typename TTearOff::Owner, C>(), "The tear-off is declared for another owner class" );
+			if( !( I::iid() == iid ) )
+				return false;
+			// On allocation failure the caller gets E_NOINTERFACE, the interface map has no way to report E_OUTOFMEMORY
+			TearOffObject<TTearOff>* const obj = new( std::nothrow ) TearOffObject<TTearOff>( pThis, unk );
+			if( nullptr == obj )
+				return false;
+			I* const result = obj;
+			*ppvResult = result;
+			return true;
+		}
+
 		template<typename I, typename C>
 		inline bool tryReturnInterface( REFIID iid, C* pThis, void** ppvResult )
 		{
 			static_assert( pointersAssignable<IUnknown, I>(), "Trying to implement an interface that doesn't derive from IUnknown" );
 			static_assert( pointersAssignable<I, C>(), "Declared support for an interface, but the class doesn't implement it" );
-			if( I::iid != iid )
+			if( !( I::iid() == iid ) )
 				return false;
 			I* const result = pThis;
 			result->AddRef();
@@ -28,4 +124,7 @@ namespace ComLight
 	}
 }
 
-#define COM_INTERFACE_ENTRY( I ) if( ComLight::details::tryReturnInterface<I>( iid, this, ppvObject ) ) return true;
\ No newline at end of file
+#define COM_INTERFACE_ENTRY( I ) if( ComLight::details::tryReturnInterface<I>( iid, this, ppvObject ) ) return true;
+
+// The interface is implemented by a separate class TTearOff, derived from ComLight::TearOffRoot<Owner, I>, instantiated by every QueryInterface for that IID.
+#define COM_INTERFACE_ENTRY_TEAR_OFF( I, TTearOff ) if( ComLight::details::tryReturnTearOff<I, TTearOff>( iid, this, this->getUnknown(), ppvObject ) ) return true;
\ No newline at end of file
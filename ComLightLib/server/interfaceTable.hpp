@@ -0,0 +1,162 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <tuple>
+#include <type_traits>
+#include "../comLightCommon.h"
+#include "../utils/typeTraits.hpp"
+
+namespace ComLight
+{
+	namespace details
+	{
+		// 32-bit hash of GUID, folds all 16 bytes. Computed at compile time for the interfaces in the table, at runtime for the requested IID.
+		inline constexpr uint32_t guidHash( const GUID& g )
+		{
+			return g.Data1 ^
+				( (uint32_t)g.Data2 | ( (uint32_t)g.Data3 << 16 ) ) ^
+				( (uint32_t)g.Data4[ 0 ] | ( (uint32_t)g.Data4[ 1 ] << 8 ) | ( (uint32_t)g.Data4[ 2 ] << 16 ) | ( (uint32_t)g.Data4[ 3 ] << 24 ) ) ^
+				( (uint32_t)g.Data4[ 4 ] | ( (uint32_t)g.Data4[ 5 ] << 8 ) | ( (uint32_t)g.Data4[ 6 ] << 16 ) | ( (uint32_t)g.Data4[ 7 ] << 24 ) );
+		}
+
+		inline constexpr bool guidEqual( const GUID& a, const GUID& b )
+		{
+			return a.Data1 == b.Data1 && a.Data2 == b.Data2 && a.Data3 == b.Data3 &&
+				a.Data4[ 0 ] == b.Data4[ 0 ] && a.Data4[ 1 ] == b.Data4[ 1 ] && a.Data4[ 2 ] == b.Data4[ 2 ] && a.Data4[ 3 ] == b.Data4[ 3 ] &&
+				a.Data4[ 4 ] == b.Data4[ 4 ] && a.Data4[ 5 ] == b.Data4[ 5 ] && a.Data4[ 6 ] == b.Data4[ 6 ] && a.Data4[ 7 ] == b.Data4[ 7 ];
+		}
+
+		// Interfaces of the table sorted by the hash of their IIDs, built at compile time
+		template<size_t N>
+		struct SortedInterfaces
+		{
+			uint32_t hashes[ N ];
+			GUID iids[ N ];
+			// Index of the interface in the original list
+			uint8_t index[ N ];
+		};
+
+		template<size_t N>
+		inline constexpr SortedInterfaces<N> sortInterfaces( const GUID( &iids )[ N ] )
+		{
+			SortedInterfaces<N> result{};
+			for( size_t i = 0; i < N; i++ )
+			{
+				result.hashes[ i ] = guidHash( iids[ i ] );
+				result.iids[ i ] = iids[ i ];
+				result.index[ i ] = (uint8_t)i;
+			}
+			// Insertion sort, N is small
+			for( size_t i = 1; i < N; i++ )
+			{
+				for( size_t j = i; j > 0 && result.hashes[ j - 1 ] > result.hashes[ j ]; j-- )
+				{
+					const uint32_t h = result.hashes[ j ];
+					result.hashes[ j ] = result.hashes[ j - 1 ];
+					result.hashes[ j - 1 ] = h;
+					const GUID g = result.iids[ j ];
+					result.iids[ j ] = result.iids[ j - 1 ];
+					result.iids[ j - 1 ] = g;
+					const uint8_t idx = result.index[ j ];
+					result.index[ j ] = result.index[ j - 1 ];
+					result.index[ j - 1 ] = idx;
+				}
+			}
+			return result;
+		}
+
+		template<size_t N>
+		inline constexpr bool hasDuplicateInterfaces( const GUID( &iids )[ N ] )
+		{
+			for( size_t i = 0; i < N; i++ )
+				for( size_t j = i + 1; j < N; j++ )
+					if( guidEqual( iids[ i ], iids[ j ] ) )
+						return true;
+			return false;
+		}
+
+		template<class C, class I>
+		inline void* castInterface( C* pThis )
+		{
+			static_assert( pointersAssignable<IUnknown, I>(), "Trying to implement an interface that doesn't derive from IUnknown" );
+			static_assert( pointersAssignable<I, C>(), "Declared support for an interface, but the class doesn't implement it" );
+			I* const result = pThis;
+			result->AddRef();
+			return result;
+		}
+
+		// Compile-time interface map. The first interface of the list defines the identity of the object, it's returned for IUnknown.
+		template<class C, class... I>
+		class InterfaceTable
+		{
+			using Caster = void* ( *)( C* );
+			using First = typename std::tuple_element<0, std::tuple<I...>>::type;
+
+			static constexpr size_t count = sizeof...( I ) + 1;
+			static_assert( count <= 0xFF, "Too many interfaces" );
+
+			static constexpr GUID iids[ count ] = { I::iid()..., IUnknown::iid() };
+			static constexpr SortedInterfaces<count> sorted = sortInterfaces( iids );
+			static_assert( !hasDuplicateInterfaces( iids ), "The interface table has duplicate entries" );
+
+			static Caster caster( size_t idx )
+			{
+				static const Caster casters[ count ] = { &castInterface<C, I>..., &castInterface<C, First> };
+				return casters[ idx ];
+			}
+
+		public:
+
+			static bool query( C* pThis, REFIID iid, void** ppvObject )
+			{
+				const uint32_t h = guidHash( iid );
+
+				// Lower bound in the sorted array of hashes
+				size_t begin = 0, length = count;
+				while( length > 0 )
+				{
+					const size_t half = length / 2;
+					if( sorted.hashes[ begin + half ] < h )
+					{
+						begin += half + 1;
+						length -= half + 1;
+					}
+					else
+						length = half;
+				}
+
+				// Different IIDs might have equal hashes, check all of them
+				for( size_t i = begin; i < count && sorted.hashes[ i ] == h; i++ )
+				{
+					if( !guidEqual( sorted.iids[ i ], iid ) )
+						continue;
+					*ppvObject = caster( sorted.index[ i ] )( pThis );
+					return true;
+				}
+				return false;
+			}
+		};
+
+		template<class C, class... I>
+		constexpr GUID InterfaceTable<C, I...>::iids[ InterfaceTable<C, I...>::count ];
+
+		template<class C, class... I>
+		constexpr SortedInterfaces<InterfaceTable<C, I...>::count> InterfaceTable<C, I...>::sorted;
+
+		template<class... I, class C>
+		inline bool queryInterfaceTable( C* pThis, REFIID iid, void** ppvObject )
+		{
+			return InterfaceTable<C, I...>::query( pThis, iid, ppvObject );
+		}
+	}
+}
+
+// Alternative to BEGIN_COM_MAP / COM_INTERFACE_ENTRY / END_COM_MAP, better for objects which implement many interfaces.
+// Instead of comparing the requested IID with every entry, it computes the hash of IID, and searches a table sorted at compile time.
+// The first interface of the list is returned for IUnknown. Usage: COM_INTERFACE_TABLE( IFirst, ISecond, IThird )
+#define COM_INTERFACE_TABLE( ... )                                                               \
+protected:                                                                                       \
+bool implQueryInterface( REFIID iid, void** ppvObject )                                          \
+{                                                                                                \
+	return ComLight::details::queryInterfaceTable<__VA_ARGS__>( this, iid, ppvObject );          \
+}
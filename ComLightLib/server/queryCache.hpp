@@ -0,0 +1,96 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <type_traits>
+#include "interfaceTable.hpp"
+
+namespace ComLight
+{
+	namespace details
+	{
+		// Per-thread cache of QueryInterface results for objects of a single type.
+		// Maps IID to the offset of the interface pointer from the start of the object. That offset only depends on the most derived type, not on the instance.
+		// Only the results of the interface map are cached. Interfaces returned by queryExtraInterfaces are not, they can change at runtime.
+		// Neither are interface pointers outside of the object, e.g. tear-offs.
+		template<class TObject>
+		class QueryCache
+		{
+			// Direct-mapped, indexed by the lowest bits of the IID hash
+			static constexpr size_t entriesCount = 16;
+
+			struct Entry
+			{
+				GUID iid;
+				ptrdiff_t offset;
+				// The entry is valid when equal to the current epoch, which is never 0.
+				uint32_t epoch;
+			};
+
+			static Entry* entries()
+			{
+				static thread_local Entry table[ entriesCount ] = {};
+				return table;
+			}
+
+			static std::atomic_uint& epoch()
+			{
+				static std::atomic_uint e{ 1 };
+				return e;
+			}
+
+			static Entry& entry( REFIID iid )
+			{
+				return entries()[ guidHash( iid ) % entriesCount ];
+			}
+
+		public:
+
+			// If the IID is in the cache, AddRef and return the interface
+			static bool lookup( TObject* pThis, REFIID iid, void** ppvObject )
+			{
+				const Entry& e = entry( iid );
+				if( e.epoch != epoch().load( std::memory_order_acquire ) || !guidEqual( e.iid, iid ) )
+					return false;
+				IUnknown* const result = (IUnknown*)( (uint8_t*)pThis + e.offset );
+				result->AddRef();
+				*ppvObject = result;
+				return true;
+			}
+
+			// Store the interface pointer returned by the interface map
+			static void store( TObject* pThis, REFIID iid, void* pv )
+			{
+				const ptrdiff_t offset = (const uint8_t*)pv - (const uint8_t*)pThis;
+				if( offset < 0 || offset >= (ptrdiff_t)sizeof( TObject ) )
+					return;
+				Entry& e = entry( iid );
+				e.iid = iid;
+				e.offset = offset;
+				e.epoch = epoch().load( std::memory_order_relaxed );
+			}
+
+			// Invalidate the caches of all threads. Only needed when the interface map of the type changes its behaviour at runtime.
+			static void invalidate()
+			{
+				uint32_t e = epoch().load( std::memory_order_relaxed ) + 1;
+				if( 0 == e )
+					e = 1;
+				epoch().store( e, std::memory_order_release );
+			}
+		};
+
+		template<class T, class = void>
+		struct hasQueryCache : std::false_type { };
+
+		template<class T>
+		struct hasQueryCache<T, decltype( (void)( typename T::comLightQueryCache* )nullptr )> : std::true_type { };
+	}
+}
+
+// Place this macro in your object class to cache the results of the interface map per thread, keyed on the type of the object and IID.
+// Makes repeated QueryInterface calls a table lookup plus pointer adjustment, regardless of the length of the interface map.
+#define DECLARE_QUERY_INTERFACE_CACHE()              \
+public:                                              \
+using comLightQueryCache = std::true_type;           \
+private:
@@ -1,6 +1,10 @@
 #pragma once
 #include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <limits.h>
 #include "comLightCommon.h"
+#include "client/CComPtr.hpp"
 
 // COM interfaces to marshal streams across the interop.
 namespace ComLight
@@ -58,4 +62,257 @@ namespace ComLight
 			return write( vec.data(), cb );
 		}
 	};
+
+	// Buffer descriptor for scatter reads
+	struct ReadBuffer
+	{
+		void* data;
+		int64_t length;
+	};
+
+	// Buffer descriptor for gather writes
+	struct WriteBuffer
+	{
+		const void* data;
+		int64_t length;
+	};
+
+	// Readonly stream which can read into multiple buffers with a single call, similar to readv() in POSIX.
+	struct DECLSPEC_NOVTABLE iReadStreamBatch : public iReadStream
+	{
+		DEFINE_INTERFACE_ID( "a3a42cd4-4d51-4f0e-b0a5-7d1bb2bf2f5d" );
+
+		// Fill the buffers in order. Only stops before the end of the last buffer when the stream has ended.
+		virtual HRESULT COMLIGHTCALL readBatch( const ReadBuffer* buffers, int count, int64_t& bytesRead ) = 0;
+	};
+
+	// Write stream which can write multiple buffers with a single call, similar to writev() in POSIX.
+	struct DECLSPEC_NOVTABLE iWriteStreamBatch : public iWriteStream
+	{
+		DEFINE_INTERFACE_ID( "5e0c8f6a-2f7e-4c43-9b8e-63c1a1e4f0b7" );
+
+		// Write all the buffers, in order.
+		virtual HRESULT COMLIGHTCALL writeBatch( const WriteBuffer* buffers, int count ) = 0;
+	};
+
+	namespace details
+	{
+		// Validate the arguments of readBatch / writeBatch, the buffers may come from another module
+		template<class B>
+		inline HRESULT validateBuffers( const B* buffers, int count )
+		{
+			if( count < 0 )
+				return E_INVALIDARG;
+			if( nullptr == buffers && 0 != count )
+				return E_POINTER;
+			for( int i = 0; i < count; i++ )
+			{
+				if( buffers[ i ].length < 0 )
+					return E_INVALIDARG;
+				if( nullptr == buffers[ i ].data && 0 != buffers[ i ].length )
+					return E_POINTER;
+			}
+			return S_OK;
+		}
+
+		// Read into the buffers one by one, with the old interface
+		inline HRESULT readBuffers( iReadStream* stream, const ReadBuffer* buffers, int count, int64_t& bytesRead )
+		{
+			bytesRead = 0;
+			for( int i = 0; i < count; i++ )
+			{
+				uint8_t* pb = (uint8_t*)buffers[ i ].data;
+				int64_t remaining = buffers[ i ].length;
+				while( remaining > 0 )
+				{
+					const int cbChunk = (int)(std::min)( remaining, (int64_t)INT_MAX );
+					int cb = 0;
+					CHECK( stream->read( pb, cbChunk, cb ) );
+					bytesRead += cb;
+					if( cb <= 0 )
+						return S_OK;
+					pb += cb;
+					remaining -= cb;
+				}
+			}
+			return S_OK;
+		}
+
+		// Write the buffers one by one, with the old interface
+		inline HRESULT writeBuffers( iWriteStream* stream, const WriteBuffer* buffers, int count )
+		{
+			for( int i = 0; i < count; i++ )
+			{
+				const uint8_t* pb = (const uint8_t*)buffers[ i ].data;
+				int64_t remaining = buffers[ i ].length;
+				while( remaining > 0 )
+				{
+					const int cbChunk = (int)(std::min)( remaining, (int64_t)INT_MAX );
+					CHECK( stream->write( pb, cbChunk ) );
+					pb += cbChunk;
+					remaining -= cbChunk;
+				}
+			}
+			return S_OK;
+		}
+	}
+
+	// Collects buffers to read, then reads them all with a single call to iReadStreamBatch when the stream implements that interface.
+	// When it doesn't, falls back to one iReadStream::read call per buffer, or per 2GB of data.
+	class ReadBatch
+	{
+		CComPtr<iReadStream> m_stream;
+		CComPtr<iReadStreamBatch> m_batch;
+		std::vector<ReadBuffer> m_buffers;
+		int64_t m_totalLength = 0;
+
+	public:
+
+		ReadBatch( iReadStream* stream ) : m_stream( stream )
+		{
+			if( nullptr != stream )
+				stream->QueryInterface( iReadStreamBatch::iid(), (void**)&m_batch );
+		}
+
+		// True if the stream supports batched reads, i.e. read() below makes a single call.
+		bool isBatched() const { return m_batch; }
+
+		// Append a buffer. The memory must stay alive until read() is called.
+		void add( void* data, int64_t length )
+		{
+			if( length <= 0 )
+				return;
+			m_buffers.push_back( ReadBuffer{ data, length } );
+			m_totalLength += length;
+		}
+
+		template<class E>
+		void add( std::vector<E>& vec )
+		{
+			add( vec.data(), (int64_t)details::sizeofVector( vec ) );
+		}
+
+		template<class E>
+		void add( E& pod )
+		{
+			static_assert( std::is_trivially_copyable<E>::value, "ReadBatch::add only supports trivially copyable types" );
+			add( &pod, (int64_t)sizeof( E ) );
+		}
+
+		// Read all the buffers, then clear the batch. Returns E_EOF if the stream ended before the buffers were filled.
+		HRESULT read()
+		{
+			if( !m_stream )
+				return OLE_E_BLANK;
+			int64_t cbRead = 0;
+			HRESULT hr;
+			if( m_batch )
+				hr = m_batch->readBatch( m_buffers.data(), (int)m_buffers.size(), cbRead );
+			else
+				hr = details::readBuffers( m_stream, m_buffers.data(), (int)m_buffers.size(), cbRead );
+			const int64_t expected = m_totalLength;
+			clear();
+			CHECK( hr );
+			return ( cbRead >= expected ) ? S_OK : E_EOF;
+		}
+
+		void clear()
+		{
+			m_buffers.clear();
+			m_totalLength = 0;
+		}
+	};
+
+	// Collects buffers to write, then writes them all with a single call to iWriteStreamBatch when the stream implements that interface.
+	// When it doesn't, falls back to one iWriteStream::write call per buffer.
+	class WriteBatch
+	{
+		CComPtr<iWriteStream> m_stream;
+		CComPtr<iWriteStreamBatch> m_batch;
+		std::vector<WriteBuffer> m_buffers;
+
+	public:
+
+		WriteBatch( iWriteStream* stream ) : m_stream( stream )
+		{
+			if( nullptr != stream )
+				stream->QueryInterface( iWriteStreamBatch::iid(), (void**)&m_batch );
+		}
+
+		// True if the stream supports batched writes, i.e. write() below makes a single call.
+		bool isBatched() const { return m_batch; }
+
+		// Append a buffer. The memory must stay alive until write() is called.
+		void add( const void* data, int64_t length )
+		{
+			if( length <= 0 )
+				return;
+			m_buffers.push_back( WriteBuffer{ data, length } );
+		}
+
+		template<class E>
+		void add( const std::vector<E>& vec )
+		{
+			add( vec.data(), (int64_t)details::sizeofVector( vec ) );
+		}
+
+		template<class E>
+		void add( const E& pod )
+		{
+			static_assert( std::is_trivially_copyable<E>::value, "WriteBatch::add only supports trivially copyable types" );
+			add( &pod, (int64_t)sizeof( E ) );
+		}
+
+		// Write all the buffers, then clear the batch.
+		HRESULT write()
+		{
+			if( !m_stream )
+				return OLE_E_BLANK;
+			HRESULT hr;
+			if( m_batch )
+				hr = m_batch->writeBatch( m_buffers.data(), (int)m_buffers.size() );
+			else
+				hr = details::writeBuffers( m_stream, m_buffers.data(), (int)m_buffers.size() );
+			m_buffers.clear();
+			return hr;
+		}
+	};
+
+	// Readonly stream without a cursor, every read specifies the offset, similar to pread() in POSIX.
+	// Implementations are safe to call from multiple threads concurrently, this allows scanning a single stream from many cores.
+	struct DECLSPEC_NOVTABLE iPositionalReadStream : public IUnknown
+	{
+		DEFINE_INTERFACE_ID( "4b9e2a61-8f3c-4d7a-b5e0-1c6d8f2a9e34" );
+
+		// Read up to length bytes starting at the offset. Only reads less than requested when the stream ends before offset + length.
+		virtual HRESULT COMLIGHTCALL readAt( int64_t offset, void* buffer, int64_t length, int64_t& bytesRead ) = 0;
+		virtual HRESULT COMLIGHTCALL getLength( int64_t& length ) = 0;
+	};
+
+	// Readonly stream which lends its internal buffers to the consumer, instead of copying data into the buffer owned by the caller.
+	// Only one buffer can be acquired at a time; the read methods of iReadStream fail with E_ACCESSDENIED while a buffer is acquired.
+	struct DECLSPEC_NOVTABLE iReadStreamLending : public iReadStream
+	{
+		DEFINE_INTERFACE_ID( "8c4d3f5b-6a3e-4d0e-a2a7-2f9b1c6e0d41" );
+
+		// Get a pointer to the next bytes of the stream. The length is 0 when the stream has ended.
+		// The data stays valid until releaseRead is called.
+		virtual HRESULT COMLIGHTCALL acquireRead( const void** ppData, int64_t& length ) = 0;
+
+		// Return the buffer to the stream, and advance the position by the count of bytes consumed, which must not exceed the acquired length.
+		virtual HRESULT COMLIGHTCALL releaseRead( int64_t consumed ) = 0;
+	};
+
+	// Write stream which lends its internal buffers to the producer, who writes the data in place.
+	// Only one buffer can be acquired at a time; the write methods of iWriteStream fail with E_ACCESSDENIED while a buffer is acquired.
+	struct DECLSPEC_NOVTABLE iWriteStreamLending : public iWriteStream
+	{
+		DEFINE_INTERFACE_ID( "e1b0a9c7-3d64-4f25-8e5a-9b7c2d4f6a83" );
+
+		// Get a writable buffer of at least minLength bytes. The length receives the actual size of the buffer, it can be larger than requested.
+		virtual HRESULT COMLIGHTCALL acquireWrite( int64_t minLength, void** ppData, int64_t& length ) = 0;
+
+		// Append the first `written` bytes of the acquired buffer to the stream, and return the buffer. Pass 0 to discard the buffer.
+		virtual HRESULT COMLIGHTCALL commitWrite( int64_t written ) = 0;
+	};
 }
\ No newline at end of file
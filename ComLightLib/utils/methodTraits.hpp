@@ -0,0 +1,80 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <tuple>
+#include <type_traits>
+#include "../comLightCommon.h"
+
+namespace ComLight
+{
+	namespace details
+	{
+		template<class M>
+		struct MethodTraits
+		{
+			static_assert( std::is_member_function_pointer<M>::value, "Expected a pointer to an interface method" );
+			static_assert( !std::is_member_function_pointer<M>::value, "Only methods which return HRESULT are supported" );
+		};
+
+		// Compile-time descriptor of an interface method, from the type of the member function pointer
+		template<class I, class... A>
+		struct MethodTraits<HRESULT( COMLIGHTCALL I::* )( A... )>
+		{
+			using Interface = I;
+			using Arguments = std::tuple<A...>;
+			static constexpr size_t arity = sizeof...( A );
+		};
+
+		template<class... M>
+		inline std::tuple<M...> methodList( M... methods )
+		{
+			return std::tuple<M...>{ methods... };
+		}
+
+		// Tuple with the member function pointers of the interface, declared with COMLIGHT_INTERFACE_METHODS macro
+		template<class I>
+		using InterfaceMethods = decltype( comLightInterfaceMethods( (const I*)nullptr ) );
+
+		template<class I>
+		inline InterfaceMethods<I> interfaceMethods()
+		{
+			return comLightInterfaceMethods( (const I*)nullptr );
+		}
+
+#ifndef _MSC_VER
+		// Index of the method in the vtable, decoded from the member function pointer. Returns -1 when the method is not virtual.
+		// Implements Itanium C++ ABI used by gcc and clang, ARM has the "virtual" bit in the adjustment field.
+		template<class M>
+		inline int vtableSlot( M method )
+		{
+			struct ItaniumPointer
+			{
+				uintptr_t ptr;
+				ptrdiff_t adj;
+			};
+			static_assert( sizeof( M ) == sizeof( ItaniumPointer ), "Unsupported ABI of member function pointers" );
+			ItaniumPointer v;
+			memcpy( &v, &method, sizeof( v ) );
+#if defined( __arm__ ) || defined( __aarch64__ )
+			if( 0 == ( v.adj & 1 ) )
+				return -1;
+			return (int)( v.ptr / sizeof( void* ) );
+#else
+			if( 0 == ( v.ptr & 1 ) )
+				return -1;
+			return (int)( ( v.ptr - 1 ) / sizeof( void* ) );
+#endif
+		}
+#endif
+	}
+}
+
+// Declare methods of the interface for the code which generates proxies and stubs, e.g. to call the interface from another process.
+// Place at namespace scope next to the interface, list the methods after IUnknown including the inherited ones. Usage:
+// COMLIGHT_INTERFACE_METHODS( IHelloWorld, &IHelloWorld::print, &IHelloWorld::add )
+#define COMLIGHT_INTERFACE_METHODS( I, ... )                            \
+inline auto comLightInterfaceMethods( const I* )                        \
+{                                                                       \
+	return ::ComLight::details::methodList( __VA_ARGS__ );               \
+}
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef _MSC_VER
+#include <errno.h>
+#include "../hresult.h"
+
+namespace ComLight
+{
+	namespace details
+	{
+		// Map errno code of a failed POSIX call to HRESULT
+		inline HRESULT hresultFromErrno( int e )
+		{
+			switch( e )
+			{
+			case 0: return E_FAIL;
+			case ENOENT: return CTL_E_FILENOTFOUND;
+			case ENOTDIR: return CTL_E_PATHNOTFOUND;
+			case EACCES:
+			case EPERM:
+			case EROFS:
+				return CTL_E_PERMISSIONDENIED;
+			case ENOMEM: return E_OUTOFMEMORY;
+			case EINVAL: return E_INVALIDARG;
+			case EBADF: return E_HANDLE;
+			case EEXIST: return STG_E_FILEALREADYEXISTS;
+			case ENOSPC: return STG_E_WRITEFAULT;
+			case ENOSYS:
+			case EOPNOTSUPP:
+				return E_NOTIMPL;
+			default: return CTL_E_DEVICEIOERROR;
+			}
+		}
+
+		inline HRESULT hresultFromErrno()
+		{
+			return hresultFromErrno( errno );
+		}
+	}
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <string.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <chrono>
+#include "../../ComLightLib/comLightServer.h"
+#include "../../ComLightLib/ipc/Remoting.hpp"
+using namespace ComLight;
+
+extern char** environ;
+
+// The interface implemented by the worker process
+struct DECLSPEC_NOVTABLE iWorker : public ComLight::IUnknown
+{
+	DEFINE_INTERFACE_ID( "{8e4c2b1d-5a3f-4e6b-9c7d-0f1e2d3c4b5a}" );
+
+	virtual HRESULT COMLIGHTCALL add( int a, int b, int& result ) = 0;
+	virtual HRESULT COMLIGHTCALL print( const char* message ) = 0;
+	// Sum of the remaining bytes of the stream
+	virtual HRESULT COMLIGHTCALL checksum( iReadStream* stream, uint64_t& result ) = 0;
+	// Write the specified count of sequential 32-bit integers to the stream
+	virtual HRESULT COMLIGHTCALL generate( uint32_t count, iWriteStream* stream ) = 0;
+};
+
+// This generates the proxy for the client process, and the stub for the worker
+COMLIGHT_INTERFACE_METHODS( iWorker, &iWorker::add, &iWorker::print, &iWorker::checksum, &iWorker::generate )
+
+class Worker : public ObjectRoot<iWorker>
+{
+	HRESULT COMLIGHTCALL add( int a, int b, int& result ) override
+	{
+		result = a + b;
+		return S_OK;
+	}
+
+	HRESULT COMLIGHTCALL print( const char* message ) override
+	{
+		printf( "Worker process %i: %s\n", (int)getpid(), message );
+		return S_OK;
+	}
+
+	HRESULT COMLIGHTCALL checksum( iReadStream* stream, uint64_t& result ) override
+	{
+		// The streams received from the client lend pointers into the shared memory, the data is never copied
+		CComPtr<iReadStreamLending> lending;
+		CHECK( stream->QueryInterface( iReadStreamLending::iid(), (void**)&lending ) );
+		const void* pv;
+		int64_t length;
+		CHECK( lending->acquireRead( &pv, length ) );
+		uint64_t sum = 0;
+		const uint8_t* pb = (const uint8_t*)pv;
+		for( int64_t i = 0; i < length; i++ )
+			sum += pb[ i ];
+		result = sum;
+		return lending->releaseRead( length );
+	}
+
+	HRESULT COMLIGHTCALL generate( uint32_t count, iWriteStream* stream ) override
+	{
+		CComPtr<iWriteStreamLending> lending;
+		CHECK( stream->QueryInterface( iWriteStreamLending::iid(), (void**)&lending ) );
+		void* pv;
+		int64_t length;
+		CHECK( lending->acquireWrite( (int64_t)count * 4, &pv, length ) );
+		uint32_t* const p = (uint32_t*)pv;
+		for( uint32_t i = 0; i < count; i++ )
+			p[ i ] = i;
+		return lending->commitWrite( (int64_t)count * 4 );
+	}
+};
+
+static int workerMain( const char* name )
+{
+	SharedMemoryServer server;
+	HRESULT hr = server.open( name );
+	if( SUCCEEDED( hr ) )
+	{
+		CComPtr<Object<Worker>> worker;
+		hr = Object<Worker>::create( worker );
+		if( SUCCEEDED( hr ) )
+			hr = server.serve<iWorker>( worker );
+	}
+	if( FAILED( hr ) )
+		fprintf( stderr, "Worker failed: 0x%08X\n", (uint32_t)hr );
+	return FAILED( hr ) ? 1 : 0;
+}
+
+static HRESULT demo( iWorker* worker, SharedMemoryClient& client )
+{
+	int sum = 0;
+	CHECK( worker->add( 2, 3, sum ) );
+	printf( "2 + 3 = %i, computed in another process\n", sum );
+	CHECK( worker->print( "Hello from the client" ) );
+
+	// Latency of the round trip
+	constexpr int calls = 100000;
+	const auto start = std::chrono::steady_clock::now();
+	for( int i = 0; i < calls; i++ )
+		CHECK( worker->add( i, 1, sum ) );
+	const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+	printf( "%i calls, %.2f microseconds per call\n", calls, elapsed.count() / calls );
+
+	// Produce 32 MB directly in the shared memory, the worker reads it in place
+	constexpr int64_t cb = 32 * 1024 * 1024;
+	CComPtr<Object<SharedMemoryStream>> shared;
+	CHECK( client.createStream( cb, shared ) );
+	uint64_t expected = 0;
+	for( int64_t i = 0; i < cb; i++ )
+	{
+		const uint8_t b = (uint8_t)( i * 7 );
+		shared->data()[ i ] = b;
+		expected += b;
+	}
+	CHECK( shared->setLength( cb ) );
+	uint64_t checksum = 0;
+	const auto startChecksum = std::chrono::steady_clock::now();
+	CHECK( worker->checksum( shared, checksum ) );
+	const std::chrono::duration<double, std::milli> elapsedChecksum = std::chrono::steady_clock::now() - startChecksum;
+	printf( "Checksum of 32 MB in the shared memory: %s, %.1f ms\n", checksum == expected ? "correct" : "WRONG", elapsedChecksum.count() );
+	if( checksum != expected )
+		return E_FAIL;
+
+	// Streams outside of the shared memory work too, with a copy
+	CComPtr<Object<MemoryWriteStream>> local;
+	CHECK( Object<MemoryWriteStream>::create( local ) );
+	CHECK( worker->generate( 1000, local ) );
+	printf( "The worker wrote %zu bytes to the local stream\n", local->size() );
+
+	// Output in the shared memory
+	CComPtr<Object<SharedMemoryStream>> output;
+	CHECK( client.createStream( 4000, output ) );
+	CHECK( worker->generate( 1000, output ) );
+	int64_t length = 0;
+	CHECK( output->getLength( length ) );
+	const uint32_t* const values = (const uint32_t*)output->data();
+	printf( "The worker wrote %i bytes to the shared stream, the last value is %u\n", (int)length, values[ 999 ] );
+	return S_OK;
+}
+
+static int clientMain( char* exe )
+{
+	char name[ 64 ];
+	snprintf( name, sizeof( name ), "/comlight-remoting-%i", (int)getpid() );
+	SharedMemoryClient client;
+	HRESULT hr = client.create( name );
+	if( FAILED( hr ) )
+	{
+		fprintf( stderr, "Unable to create the shared memory: 0x%08X\n", (uint32_t)hr );
+		return 1;
+	}
+
+	char worker[] = "--worker";
+	char* const argv[] = { exe, worker, name, nullptr };
+	pid_t pid;
+	if( 0 != posix_spawn( &pid, "/proc/self/exe", nullptr, nullptr, argv, environ ) )
+	{
+		fprintf( stderr, "Unable to start the worker process\n" );
+		return 1;
+	}
+
+	{
+		CComPtr<iWorker> proxy;
+		hr = client.connect( proxy );
+		if( SUCCEEDED( hr ) )
+			hr = demo( proxy, client );
+	}
+	client.close();
+	int status = 0;
+	waitpid( pid, &status, 0 );
+	if( FAILED( hr ) )
+	{
+		fprintf( stderr, "Remote call failed: 0x%08X\n", (uint32_t)hr );
+		return 1;
+	}
+	return WEXITSTATUS( status );
+}
+
+int main( int argc, char** argv )
+{
+	if( 3 == argc && 0 == strcmp( argv[ 1 ], "--worker" ) )
+		return workerMain( argv[ 2 ] );
+	return clientMain( argv[ 0 ] );
+}
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <string.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "../../ComLightLib/comLightServer.h"
+#include "../../ComLightLib/ipc/Remoting.hpp"
+using namespace ComLight;
+
+extern char** environ;
+
+// Tests of the shared memory transport with two local processes: the test spawns itself as the worker process.
+// Exits with 0 when all tests pass, 1 otherwise.
+
+struct DECLSPEC_NOVTABLE iTestWorker : public ComLight::IUnknown
+{
+	DEFINE_INTERFACE_ID( "{3c9d0e6a-7b21-4f58-a4e3-d2b6c1f08e97}" );
+
+	virtual HRESULT COMLIGHTCALL add( int a, int b, int& result ) = 0;
+	// Sum of the remaining bytes of the stream
+	virtual HRESULT COMLIGHTCALL checksum( iReadStream* stream, uint64_t& result ) = 0;
+	// Write the specified count of sequential 32-bit integers to the stream, with iWriteStream::write
+	virtual HRESULT COMLIGHTCALL generate( uint32_t count, iWriteStream* stream ) = 0;
+	// Keep references to the streams after the call returns
+	virtual HRESULT COMLIGHTCALL keepStreams( iReadStream* read, iWriteStream* write ) = 0;
+	// Use the streams kept by keepStreams
+	virtual HRESULT COMLIGHTCALL useKeptStreams( int& bytesRead, HRESULT& writeStatus ) = 0;
+	// Terminate the worker process in the middle of the call
+	virtual HRESULT COMLIGHTCALL crash() = 0;
+};
+
+COMLIGHT_INTERFACE_METHODS( iTestWorker, &iTestWorker::add, &iTestWorker::checksum, &iTestWorker::generate,
+	&iTestWorker::keepStreams, &iTestWorker::useKeptStreams, &iTestWorker::crash )
+
+class TestWorker : public ObjectRoot<iTestWorker>
+{
+	CComPtr<iReadStream> m_keptRead;
+	CComPtr<iWriteStream> m_keptWrite;
+
+	HRESULT COMLIGHTCALL add( int a, int b, int& result ) override
+	{
+		result = a + b;
+		return S_OK;
+	}
+
+	HRESULT COMLIGHTCALL checksum( iReadStream* stream, uint64_t& result ) override
+	{
+		uint64_t sum = 0;
+		uint8_t buffer[ 4096 ];
+		while( true )
+		{
+			int cb = 0;
+			CHECK( stream->read( buffer, (int)sizeof( buffer ), cb ) );
+			if( 0 == cb )
+				break;
+			for( int i = 0; i < cb; i++ )
+				sum += buffer[ i ];
+		}
+		result = sum;
+		return S_OK;
+	}
+
+	HRESULT COMLIGHTCALL generate( uint32_t count, iWriteStream* stream ) override
+	{
+		for( uint32_t i = 0; i < count; i++ )
+			CHECK( stream->write( &i, 4 ) );
+		return S_OK;
+	}
+
+	HRESULT COMLIGHTCALL keepStreams( iReadStream* read, iWriteStream* write ) override
+	{
+		m_keptRead = read;
+		m_keptWrite = write;
+		return S_OK;
+	}
+
+	HRESULT COMLIGHTCALL useKeptStreams( int& bytesRead, HRESULT& writeStatus ) override
+	{
+		if( !m_keptRead || !m_keptWrite )
+			return OLE_E_BLANK;
+		uint8_t buffer[ 16 ];
+		CHECK( m_keptRead->seek( 0, eSeekOrigin::Begin ) );
+		CHECK( m_keptRead->read( buffer, (int)sizeof( buffer ), bytesRead ) );
+		writeStatus = m_keptWrite->write( buffer, 4 );
+		return S_OK;
+	}
+
+	HRESULT COMLIGHTCALL crash() override
+	{
+		_exit( 3 );
+	}
+};
+
+static int workerMain( const char* name )
+{
+	SharedMemoryServer server;
+	HRESULT hr = server.open( name );
+	if( SUCCEEDED( hr ) )
+	{
+		CComPtr<Object<TestWorker>> worker;
+		hr = Object<TestWorker>::create( worker );
+		if( SUCCEEDED( hr ) )
+			hr = server.serve<iTestWorker>( worker );
+	}
+	return FAILED( hr ) ? 1 : 0;
+}
+
+static int failures = 0;
+
+static void check( bool passed, const char* what )
+{
+	printf( "%s: %s\n", passed ? "PASS" : "FAIL", what );
+	if( !passed )
+		failures++;
+}
+
+// Client process, connected to a worker process
+class Session
+{
+	char m_exe[ 1024 ];
+	pid_t m_pid = 0;
+
+public:
+
+	SharedMemoryClient client;
+	CComPtr<iTestWorker> worker;
+
+	HRESULT start( const char* exe, int index )
+	{
+		strncpy( m_exe, exe, sizeof( m_exe ) - 1 );
+		m_exe[ sizeof( m_exe ) - 1 ] = '\0';
+		char name[ 64 ];
+		snprintf( name, sizeof( name ), "/comlight-remoting-test-%i-%i", (int)getpid(), index );
+		CHECK( client.create( name ) );
+		char workerArg[] = "--worker";
+		char* const argv[] = { m_exe, workerArg, name, nullptr };
+		if( 0 != posix_spawn( &m_pid, "/proc/self/exe", nullptr, nullptr, argv, environ ) )
+			return E_FAIL;
+		return client.connect( worker );
+	}
+
+	// Close the channel, return the exit code of the worker
+	int finish()
+	{
+		worker.release();
+		client.close();
+		int status = 0;
+		if( 0 != m_pid && m_pid == waitpid( m_pid, &status, 0 ) && WIFEXITED( status ) )
+			return WEXITSTATUS( status );
+		return -1;
+	}
+};
+
+static void testConcurrentCalls( iTestWorker* worker )
+{
+	constexpr int threadsCount = 6;
+	constexpr int calls = 10000;
+	std::atomic<int> errors{ 0 };
+	std::vector<std::thread> threads;
+	for( int t = 0; t < threadsCount; t++ )
+	{
+		threads.emplace_back( [ worker, t, &errors ]()
+		{
+			for( int i = 0; i < calls; i++ )
+			{
+				int sum = 0;
+				if( FAILED( worker->add( t * calls, i, sum ) ) || sum != t * calls + i )
+					errors++;
+			}
+		} );
+	}
+	for( auto& t : threads )
+		t.join();
+	check( 0 == errors, "6 threads calling concurrently" );
+}
+
+static void testStreams( iTestWorker* worker, SharedMemoryClient& client )
+{
+	std::vector<uint8_t> data( 100000 );
+	uint64_t expected = 0;
+	for( size_t i = 0; i < data.size(); i++ )
+	{
+		data[ i ] = (uint8_t)( i * 13 );
+		expected += data[ i ];
+	}
+
+	// Foreign streams take the copy path
+	CComPtr<Object<MemoryReadStream>> foreignRead;
+	uint64_t sum = 0;
+	bool ok = SUCCEEDED( Object<MemoryReadStream>::create( foreignRead ) ) && SUCCEEDED( foreignRead->initialize( data.data(), (int64_t)data.size() ) );
+	ok = ok && SUCCEEDED( worker->checksum( foreignRead, sum ) ) && sum == expected;
+	check( ok, "Foreign read stream" );
+
+	CComPtr<Object<MemoryWriteStream>> foreignWrite;
+	ok = SUCCEEDED( Object<MemoryWriteStream>::create( foreignWrite ) ) && SUCCEEDED( worker->generate( 1000, foreignWrite ) );
+	ok = ok && foreignWrite->size() == 4000 && 999 == ( (const uint32_t*)foreignWrite->data() )[ 999 ];
+	check( ok, "Foreign write stream" );
+
+	// Streams in the shared memory
+	CComPtr<Object<SharedMemoryStream>> shared;
+	ok = SUCCEEDED( client.createStream( (int64_t)data.size(), shared ) );
+	if( ok )
+	{
+		memcpy( shared->data(), data.data(), data.size() );
+		sum = 0;
+		ok = SUCCEEDED( shared->setLength( (int64_t)data.size() ) ) && SUCCEEDED( worker->checksum( shared, sum ) ) && sum == expected;
+	}
+	check( ok, "Shared memory read stream" );
+
+	CComPtr<Object<SharedMemoryStream>> output;
+	int64_t length = 0;
+	ok = SUCCEEDED( client.createStream( 4000, output ) ) && SUCCEEDED( worker->generate( 1000, output ) );
+	ok = ok && SUCCEEDED( output->getLength( length ) ) && 4000 == length && 999 == ( (const uint32_t*)output->data() )[ 999 ];
+	check( ok, "Shared memory write stream" );
+
+	// The streams kept by the server after the call no longer reference the arena
+	CComPtr<Object<SharedMemoryStream>> keptRead, keptWrite;
+	int bytesRead = -1;
+	HRESULT writeStatus = S_OK;
+	ok = SUCCEEDED( client.createStream( 16, keptRead ) ) && SUCCEEDED( client.createStream( 16, keptWrite ) );
+	ok = ok && SUCCEEDED( keptRead->setLength( 16 ) ) && SUCCEEDED( worker->keepStreams( keptRead, keptWrite ) );
+	ok = ok && SUCCEEDED( worker->useKeptStreams( bytesRead, writeStatus ) );
+	ok = ok && 0 == bytesRead && RPC_E_DISCONNECTED == writeStatus;
+	check( ok, "Streams are detached when the call returns" );
+}
+
+static int clientMain( char* exe )
+{
+	{
+		Session session;
+		const HRESULT hr = session.start( exe, 0 );
+		check( SUCCEEDED( hr ), "Start the worker" );
+		if( SUCCEEDED( hr ) )
+		{
+			testConcurrentCalls( session.worker );
+			testStreams( session.worker, session.client );
+		}
+		check( 0 == session.finish(), "Worker exits when the client closes the channel" );
+	}
+
+	{
+		Session session;
+		const HRESULT hr = session.start( exe, 1 );
+		check( SUCCEEDED( hr ) && RPC_E_DISCONNECTED == session.worker->crash(), "Worker crashing in the middle of a call" );
+		int sum = 0;
+		check( RPC_E_DISCONNECTED == session.worker->add( 1, 2, sum ), "Calls fail after the worker crashed" );
+		check( 3 == session.finish(), "Exit code of the crashed worker" );
+	}
+
+	printf( "%i tests failed\n", failures );
+	return ( 0 == failures ) ? 0 : 1;
+}
+
+int main( int argc, char** argv )
+{
+	if( 3 == argc && 0 == strcmp( argv[ 1 ], "--worker" ) )
+		return workerMain( argv[ 2 ] );
+	return clientMain( argv[ 0 ] );
+}
@@ -1,5 +1,6 @@
 #include "interfaces.h"
 #include <array>
+#include "../../ComLightLib/io/BufferedStreams.hpp"
 
 class StreamsDemo : public ComLight::ObjectRoot<iStreamsDemo>
 {
@@ -13,11 +14,20 @@ class StreamsDemo : public ComLight::ObjectRoot<iStreamsDemo>
 
 	HRESULT COMLIGHTCALL copyWithManaged( LPCTSTR pathFrom, LPCTSTR pathTo ) override
 	{
-		CComPtr<iReadStream> read;
-		CHECK( m_managed->openFile( pathFrom, &read ) );
+		CComPtr<iReadStream> managedRead;
+		CHECK( m_managed->openFile( pathFrom, &managedRead ) );
 
-		CComPtr<iWriteStream> write;
-		CHECK( m_managed->createFile( pathTo, &write ) );
+		CComPtr<iWriteStream> managedWrite;
+		CHECK( m_managed->createFile( pathTo, &managedWrite ) );
+
+		// Wrap the managed streams into buffers, this way the 1kb reads and writes below only call into .NET once per 64kb
+		CComPtr<ComLight::Object<BufferedReadStream>> read;
+		CHECK( ComLight::Object<BufferedReadStream>::create( read ) );
+		CHECK( read->initialize( managedRead ) );
+
+		CComPtr<ComLight::Object<BufferedWriteStream>> write;
+		CHECK( ComLight::Object<BufferedWriteStream>::create( write ) );
+		CHECK( write->initialize( managedWrite ) );
 
 		constexpr int cbBuffer = 1024;
 		std::array<uint8_t, cbBuffer> buffer;
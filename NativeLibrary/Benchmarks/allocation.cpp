@@ -0,0 +1,324 @@
+#include "benchmarks.h"
+#include "../../ComLightLib/comLightServer.h"
+#include "../../ComLightLib/streams.h"
+#include "../../ComLightLib/io/BufferPool.hpp"
+#include <memory>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace
+{
+	using namespace ComLight;
+
+	// Small object with the default allocation policy, the heap
+	class HeapObject : public ObjectRoot<iReadStream>
+	{
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override { return E_NOTIMPL; }
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override { return E_NOTIMPL; }
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override { return E_NOTIMPL; }
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override { return E_NOTIMPL; }
+		int64_t m_payload[ 2 ] = {};
+	};
+
+	// Same object, allocated from the pool
+	class PooledObject : public HeapObject
+	{
+		DECLARE_POOLED_ALLOCATION()
+	};
+
+	struct DECLSPEC_NOVTABLE iValue : public IUnknown
+	{
+		DEFINE_INTERFACE_ID( "{7d3c1e52-9a4b-4f6e-8c2d-5b0a1f3e6d47}" );
+		virtual int64_t COMLIGHTCALL getValue() = 0;
+	};
+
+	// Tiny objects with 8 bytes of payload, in the default and compact layouts
+	template<template<class, class> class TRoot>
+	class SmallObject : public TRoot<iValue, AtomicRefCount>
+	{
+		int64_t m_value = 0;
+		int64_t COMLIGHTCALL getValue() override { return m_value; }
+	};
+	using SmallDefault = Object<SmallObject<ObjectRoot>>;
+	using SmallCompact = Object<SmallObject<CompactObjectRoot>>;
+
+	// Default layout: vtable pointer of the reference counter, 32-bit counter and padding, vtable pointer of the interface, payload
+	static_assert( sizeof( SmallDefault ) == 3 * sizeof( void* ) + 8, "Unexpected size of the default layout" );
+	// Compact layout: vtable pointer of the interface, 32-bit counter, payload; on 32-bit platforms there's no padding
+	static_assert( sizeof( SmallCompact ) == ( sizeof( void* ) == 8 ? 24 : 16 ), "Unexpected size of the compact layout" );
+	static_assert( sizeof( Object<CompactObjectRoot<iValue>> ) == sizeof( void* ) + ( sizeof( void* ) == 8 ? 8 : 4 ), "Unexpected size of the compact layout" );
+
+	// Bytes allocated from the heap, including the allocator overhead, or 0 when not available
+	size_t heapBytes()
+	{
+#if defined( __GLIBC__ ) && ( __GLIBC__ > 2 || __GLIBC_MINOR__ >= 33 )
+		return mallinfo2().uordblks;
+#else
+		return 0;
+#endif
+	}
+
+	constexpr size_t millionsCount = 10 * 1000 * 1000;
+	constexpr size_t millionsBatch = 100 * 1000;
+
+	// Create 10M objects and keep them alive, then release them all. The samples are nanoseconds per object.
+	template<class T>
+	void createMillions( Benchmarks::Samples& samples, size_t& memoryPerObject )
+	{
+		std::vector<iValue*> objects;
+		objects.reserve( millionsCount );
+
+		const size_t memBefore = heapBytes();
+		for( size_t i = 0; i < millionsCount; i += millionsBatch )
+		{
+			const auto start = Benchmarks::Clock::now();
+			for( size_t j = 0; j < millionsBatch; j++ )
+			{
+				iValue* p = nullptr;
+				if( FAILED( T::create( &p ) ) )
+					break;
+				objects.push_back( p );
+			}
+			samples.add( start, Benchmarks::Clock::now(), millionsBatch );
+		}
+		const size_t memAfter = heapBytes();
+		memoryPerObject = ( memAfter > memBefore ) ? ( memAfter - memBefore ) / objects.size() : 0;
+
+		for( iValue* p : objects )
+			p->Release();
+	}
+
+	template<class T>
+	void createMillions( Benchmarks::Suite& suite, const char* name )
+	{
+		if( !suite.enabled( name ) )
+			return;
+		Benchmarks::Samples samples{ millionsCount / millionsBatch };
+		size_t memory = 0;
+		createMillions<T>( samples, memory );
+		suite.add( name, samples );
+		printf( "%s: sizeof %zu bytes", name, sizeof( T ) );
+		if( 0 != memory )
+			printf( ", %zu bytes of heap per object", memory );
+		printf( "\n" );
+	}
+
+	void smallObjects( Benchmarks::Suite& suite )
+	{
+		const char* const nameDefault = "Create 10M small objects, ObjectRoot";
+		const char* const nameCompact = "Create 10M small objects, CompactObjectRoot";
+		if( !suite.enabled( nameDefault ) && !suite.enabled( nameCompact ) )
+			return;
+		// Warm up the heap, so both measures reuse the memory instead of page faulting
+		Benchmarks::Samples warmup;
+		size_t memory;
+		createMillions<SmallDefault>( warmup, memory );
+
+		createMillions<SmallDefault>( suite, nameDefault );
+		createMillions<SmallCompact>( suite, nameCompact );
+	}
+
+	// Object owning a temporary file with 1MB of buffered data, the destructor writes the data and closes the file
+	class FileObject : public ObjectRoot<iValue>
+	{
+		FILE* m_file = nullptr;
+		std::vector<char> m_buffer = std::vector<char>( 2 * 1024 * 1024 );
+
+	public:
+
+		HRESULT FinalConstruct()
+		{
+			m_file = tmpfile();
+			if( nullptr == m_file )
+				return E_FAIL;
+			setvbuf( m_file, m_buffer.data(), _IOFBF, m_buffer.size() );
+			const std::vector<uint8_t> data( 1024 * 1024, (uint8_t)0x55 );
+			fwrite( data.data(), 1, data.size(), m_file );
+			return S_OK;
+		}
+
+		~FileObject()
+		{
+			if( nullptr != m_file )
+				fclose( m_file );
+		}
+
+		int64_t COMLIGHTCALL getValue() override { return 0; }
+	};
+
+	class FileObjectDeferred : public FileObject
+	{
+		DECLARE_DEFERRED_DESTRUCTION()
+	};
+
+	// Latency of the final Release call on the releasing thread, the samples are nanoseconds
+	template<class T>
+	void finalRelease( Benchmarks::Suite& suite, const char* name )
+	{
+		if( !suite.enabled( name ) )
+			return;
+		constexpr int count = 500;
+		Benchmarks::Samples samples{ count };
+		for( int i = 0; i < count; i++ )
+		{
+			iValue* p = nullptr;
+			if( FAILED( Object<T>::create( &p ) ) )
+				return;
+			const auto start = Benchmarks::Clock::now();
+			p->Release();
+			samples.add( start, Benchmarks::Clock::now() );
+		}
+		flushDeferredDestruction();
+		suite.add( name, samples );
+	}
+
+	constexpr int objectsPerRound = 256;
+	constexpr int rounds = 20000;
+
+	// Create a batch of objects, then release them all; repeat. Each round is a sample.
+	template<class T>
+	void churn( Benchmarks::Samples& samples )
+	{
+		std::vector<CComPtr<iReadStream>> objects;
+		objects.resize( objectsPerRound );
+
+		for( int r = 0; r < rounds; r++ )
+		{
+			const auto start = Benchmarks::Clock::now();
+			for( auto& p : objects )
+				Object<T>::create( &p );
+			for( auto& p : objects )
+				p.release();
+			samples.add( start, Benchmarks::Clock::now(), objectsPerRound );
+		}
+	}
+
+	template<class T>
+	void singleThread( Benchmarks::Suite& suite, const char* name )
+	{
+		if( !suite.enabled( name ) )
+			return;
+		// Warm up the pool, or the heap
+		Benchmarks::Samples warmup;
+		churn<T>( warmup );
+
+		Benchmarks::Samples samples{ rounds };
+		churn<T>( samples );
+		suite.add( name, samples );
+	}
+
+	template<class T>
+	void allThreads( Benchmarks::Suite& suite, const char* name )
+	{
+		if( !suite.enabled( name ) )
+			return;
+
+		const int threadsCount = (int)std::max( 2u, std::thread::hardware_concurrency() );
+		std::vector<Benchmarks::Samples> samples;
+		samples.resize( threadsCount );
+		std::vector<std::thread> threads;
+		for( int i = 0; i < threadsCount; i++ )
+		{
+			Benchmarks::Samples& s = samples[ i ];
+			threads.emplace_back( [ &s ]() { churn<T>( s ); } );
+		}
+		for( auto& t : threads )
+			t.join();
+
+		Benchmarks::Samples merged;
+		for( auto& s : samples )
+			for( double v : s.values() )
+				merged.addValue( v, objectsPerRound );
+		suite.add( name, merged );
+	}
+
+	constexpr size_t bufferLength = 1024 * 1024;
+	constexpr size_t buffersBatch = 100;
+	constexpr int bufferRounds = 200;
+
+	// Write a byte to every page, so the samples include the page faults of the fresh memory
+	void touchPages( uint8_t* p )
+	{
+		for( size_t i = 0; i < bufferLength; i += 4096 )
+			p[ i ] = (uint8_t)i;
+	}
+
+	// Allocate and free 1MB buffers, compare the heap with the buffer pool
+	void largeBuffers( Benchmarks::Suite& suite )
+	{
+		const char* const nameHeap = "1MB buffer, new[] + delete[]";
+		if( suite.enabled( nameHeap ) )
+		{
+			Benchmarks::Samples samples{ bufferRounds };
+			for( int r = 0; r < bufferRounds; r++ )
+			{
+				const auto start = Benchmarks::Clock::now();
+				for( size_t i = 0; i < buffersBatch; i++ )
+				{
+					std::unique_ptr<uint8_t[]> p{ new uint8_t[ bufferLength ] };
+					touchPages( p.get() );
+				}
+				samples.add( start, Benchmarks::Clock::now(), buffersBatch );
+			}
+			suite.add( nameHeap, samples );
+		}
+
+		const char* const namePooled = "1MB buffer, createBuffer + Release";
+		if( suite.enabled( namePooled ) )
+		{
+			Benchmarks::Samples samples{ bufferRounds };
+			for( int r = 0; r < bufferRounds; r++ )
+			{
+				const auto start = Benchmarks::Clock::now();
+				for( size_t i = 0; i < buffersBatch; i++ )
+				{
+					CComPtr<iBuffer> buffer;
+					if( FAILED( createBuffer( bufferLength, &buffer ) ) )
+						return;
+					void* pv;
+					int64_t cb;
+					buffer->getData( &pv, cb );
+					touchPages( (uint8_t*)pv );
+				}
+				samples.add( start, Benchmarks::Clock::now(), buffersBatch );
+			}
+			suite.add( namePooled, samples );
+		}
+
+		const char* const nameSlice = "1MB buffer, slice + Release";
+		if( suite.enabled( nameSlice ) )
+		{
+			CComPtr<iBuffer> buffer;
+			if( FAILED( createBuffer( bufferLength, &buffer ) ) )
+				return;
+			Benchmarks::Samples samples{ bufferRounds };
+			for( int r = 0; r < bufferRounds; r++ )
+			{
+				const auto start = Benchmarks::Clock::now();
+				for( size_t i = 0; i < buffersBatch; i++ )
+				{
+					CComPtr<iBuffer> slice;
+					buffer->slice( (int64_t)i * 4096, 4096, &slice );
+				}
+				samples.add( start, Benchmarks::Clock::now(), buffersBatch );
+			}
+			suite.add( nameSlice, samples );
+		}
+	}
+}
+
+void Benchmarks::allocation( Suite& suite )
+{
+	singleThread<HeapObject>( suite, "Object::create + Release, heap" );
+	singleThread<PooledObject>( suite, "Object::create + Release, pooled" );
+	allThreads<HeapObject>( suite, "Object::create + Release, heap, all threads" );
+	allThreads<PooledObject>( suite, "Object::create + Release, pooled, all threads" );
+	smallObjects( suite );
+	finalRelease<FileObject>( suite, "Final Release of object with a file, immediate" );
+	finalRelease<FileObjectDeferred>( suite, "Final Release of object with a file, deferred" );
+	largeBuffers( suite );
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Micro-benchmarks of ComLightLib, built by cmake into comlight-bench executable.
+namespace Benchmarks
+{
+	using Clock = std::chrono::steady_clock;
+
+	inline double secondsSince( Clock::time_point start )
+	{
+		const std::chrono::duration<double> elapsed = Clock::now() - start;
+		return elapsed.count();
+	}
+
+	// Median time of an empty timed region, in nanoseconds, i.e. the cost of reading the clock. Measured on first use.
+	double clockOverhead();
+
+	// Collects timing samples of a benchmark.
+	// Most measured operations are way too fast to time individually, each sample is a batch of operations, the statistics are per operation.
+	// The percentiles are computed over the samples, i.e. they are percentiles of batch means. Batching hides the tails of individual operations.
+	class Samples
+	{
+		std::vector<double> m_values;
+		uint64_t m_operations = 0;
+		uint64_t m_maxBatch = 0;
+
+	public:
+
+		Samples( size_t capacity = 0 ) { m_values.reserve( capacity ); }
+
+		// Add a sample which took the specified time for the specified count of operations
+		void add( Clock::time_point start, Clock::time_point finish, uint64_t operations = 1 )
+		{
+			const std::chrono::duration<double, std::nano> elapsed = finish - start;
+			m_values.push_back( elapsed.count() / (double)operations );
+			m_operations += operations;
+			m_maxBatch = ( operations > m_maxBatch ) ? operations : m_maxBatch;
+		}
+
+		// Add a sample of a single operation, with the overhead of reading the clock subtracted.
+		// These operations are not much slower than the clock: expect noise of a few nanoseconds, but the percentiles are of individual operations.
+		void addSingle( Clock::time_point start, Clock::time_point finish )
+		{
+			const std::chrono::duration<double, std::nano> elapsed = finish - start;
+			const double ns = elapsed.count() - clockOverhead();
+			m_values.push_back( ns > 0 ? ns : 0 );
+			m_operations++;
+			m_maxBatch = ( m_maxBatch > 1 ) ? m_maxBatch : 1;
+		}
+
+		// Add a sample value directly, e.g. throughput of a repetition
+		void addValue( double value, uint64_t operations = 1 )
+		{
+			m_values.push_back( value );
+			m_operations += operations;
+			m_maxBatch = ( operations > m_maxBatch ) ? operations : m_maxBatch;
+		}
+
+		std::vector<double>& values() { return m_values; }
+		uint64_t operations() const { return m_operations; }
+		// Largest count of operations in a single sample, 1 when the operations were timed individually
+		uint64_t batch() const { return m_maxBatch; }
+	};
+
+	// Statistics of a single benchmark
+	struct Result
+	{
+		std::string name;
+		// "ns" for latency, "MB/s" for throughput, etc.
+		std::string unit;
+		uint64_t samples;
+		uint64_t operations;
+		// Operations per sample, when above 1 the percentiles are of batch means
+		uint64_t batch;
+		double mean, p50, p99, p999, min, max;
+	};
+
+	// Runs the benchmarks, collects the results, prints them as a table and optionally JSON.
+	class Suite
+	{
+		std::vector<Result> m_results;
+		std::string m_filter;
+
+	public:
+
+		Suite( const char* filter ) : m_filter( nullptr != filter ? filter : "" ) { }
+
+		// False when the benchmark is excluded by the command-line filter
+		bool enabled( const char* name ) const;
+
+		// Compute statistics of the samples, print and keep the result.
+		void add( const char* name, Samples& samples, const char* unit = "ns" );
+
+		void printJson( FILE* stream ) const;
+	};
+
+	void calls( Suite& suite );
+	void interfaceMap( Suite& suite );
+	void allocation( Suite& suite );
+	void refCounting( Suite& suite );
+	void streams( Suite& suite );
+	void files( Suite& suite );
+}
@@ -0,0 +1,65 @@
+#include "benchmarks.h"
+#include "../ITest.h"
+#include "../Test.h"
+
+namespace
+{
+	using namespace ComLight;
+
+	// The batched calls are recorded and executed in batches of that many calls
+	constexpr int callsPerSample = 64;
+	constexpr int samplesCount = 100000;
+	// The other calls are timed individually
+	constexpr int singleSamplesCount = 1000000;
+
+	void vtableCalls( Benchmarks::Suite& suite, ITest* test )
+	{
+		const char* name = "ITest::add, native to native";
+		if( !suite.enabled( name ) )
+			return;
+
+		Benchmarks::Samples samples{ singleSamplesCount };
+		int x = 0;
+		for( int s = 0; s < singleSamplesCount; s++ )
+		{
+			int r = 0;
+			const auto start = Benchmarks::Clock::now();
+			test->add( s, s, r );
+			samples.addSingle( start, Benchmarks::Clock::now() );
+			x ^= r;
+		}
+		if( 0x7FFFFFFF == x )
+			printf( "\n" );	// Prevent the compiler from optimizing away the calls
+		suite.add( name, samples );
+	}
+
+	// QueryInterface followed by Release of the returned pointer, if any
+	void queryInterface( Benchmarks::Suite& suite, const char* name, ITest* test, REFIID iid )
+	{
+		if( !suite.enabled( name ) )
+			return;
+
+		Benchmarks::Samples samples{ singleSamplesCount };
+		for( int s = 0; s < singleSamplesCount; s++ )
+		{
+			const auto start = Benchmarks::Clock::now();
+			IUnknown* unk = nullptr;
+			if( SUCCEEDED( test->QueryInterface( iid, (void**)&unk ) ) )
+				unk->Release();
+			samples.addSingle( start, Benchmarks::Clock::now() );
+		}
+		suite.add( name, samples );
+	}
+}
+
+void Benchmarks::calls( Suite& suite )
+{
+	CComPtr<ITest> test;
+	if( FAILED( createTest( &test ) ) )
+		return;
+
+	vtableCalls( suite, test );
+	queryInterface( suite, "QueryInterface + Release, hit", test, ITest::iid() );
+	queryInterface( suite, "QueryInterface + Release, IUnknown", test, IUnknown::iid() );
+	queryInterface( suite, "QueryInterface, miss", test, ITest2::iid() );
+}
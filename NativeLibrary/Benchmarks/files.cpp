@@ -0,0 +1,96 @@
+#include "benchmarks.h"
+#include "../../ComLightLib/io/StdioStreams.hpp"
+#include "../../ComLightLib/io/LinuxFileStreams.hpp"
+
+namespace
+{
+	using namespace ComLight;
+
+	constexpr size_t fileLength = 256 * 1024 * 1024;
+	constexpr int chunk = 64 * 1024;
+	constexpr int repetitions = 4;
+	const char* const tempPath = "comlight-bench.tmp";
+
+	template<class TStream, class TOpen>
+	void writeFile( Benchmarks::Suite& suite, const char* name, TOpen open )
+	{
+		if( !suite.enabled( name ) )
+			return;
+		const std::vector<uint8_t> buffer( chunk, (uint8_t)0x55 );
+		Benchmarks::Samples samples{ repetitions };
+		for( int r = 0; r < repetitions; r++ )
+		{
+			const auto start = Benchmarks::Clock::now();
+			{
+				CComPtr<Object<TStream>> stream;
+				if( FAILED( Object<TStream>::create( stream ) ) || FAILED( open( stream ) ) )
+					return;
+				iWriteStream* const ws = stream;
+				for( size_t i = 0; i < fileLength / chunk; i++ )
+					ws->write( buffer.data(), chunk );
+				ws->flush();
+			}
+			const double seconds = Benchmarks::secondsSince( start );
+			samples.addValue( (double)fileLength / ( seconds * 1024 * 1024 ) );
+		}
+		suite.add( name, samples, "MB/s" );
+	}
+
+	template<class TStream, class TOpen>
+	void readFile( Benchmarks::Suite& suite, const char* name, TOpen open )
+	{
+		if( !suite.enabled( name ) )
+			return;
+		std::vector<uint8_t> buffer( chunk );
+		Benchmarks::Samples samples{ repetitions };
+		for( int r = 0; r < repetitions; r++ )
+		{
+			const auto start = Benchmarks::Clock::now();
+			{
+				CComPtr<Object<TStream>> stream;
+				if( FAILED( Object<TStream>::create( stream ) ) || FAILED( open( stream ) ) )
+					return;
+				iReadStream* const rs = stream;
+				while( true )
+				{
+					int cb = 0;
+					if( FAILED( rs->read( buffer.data(), chunk, cb ) ) || 0 == cb )
+						break;
+				}
+			}
+			const double seconds = Benchmarks::secondsSince( start );
+			samples.addValue( (double)fileLength / ( seconds * 1024 * 1024 ) );
+		}
+		suite.add( name, samples, "MB/s" );
+	}
+}
+
+// Sequential file I/O in the current directory, 64kb calls. Mostly measures the page cache, unless O_DIRECT.
+void Benchmarks::files( Suite& suite )
+{
+	FileWriteOptions wo;
+	wo.durability = eDurability::None;
+	FileWriteOptions woSync = wo;
+	woSync.useIoUring = false;
+	FileWriteOptions woDirect = wo;
+	woDirect.directIo = true;
+	woDirect.preallocate = fileLength;
+
+	writeFile<StdioWriteStream>( suite, "File write, StdioWriteStream", []( StdioWriteStream* s ) { return s->createFile( tempPath ); } );
+	writeFile<LinuxFileWriteStream>( suite, "File write, LinuxFileWriteStream, pwrite", [ & ]( LinuxFileWriteStream* s ) { return s->createFile( tempPath, woSync ); } );
+	writeFile<LinuxFileWriteStream>( suite, "File write, LinuxFileWriteStream, io_uring", [ & ]( LinuxFileWriteStream* s ) { return s->createFile( tempPath, wo ); } );
+	writeFile<LinuxFileWriteStream>( suite, "File write, LinuxFileWriteStream, O_DIRECT", [ & ]( LinuxFileWriteStream* s ) { return s->createFile( tempPath, woDirect ); } );
+
+	FileReadOptions ro;
+	FileReadOptions roSync = ro;
+	roSync.useIoUring = false;
+	FileReadOptions roDirect = ro;
+	roDirect.directIo = true;
+
+	readFile<StdioReadStream>( suite, "File read, StdioReadStream", []( StdioReadStream* s ) { return s->openFile( tempPath ); } );
+	readFile<LinuxFileReadStream>( suite, "File read, LinuxFileReadStream, pread", [ & ]( LinuxFileReadStream* s ) { return s->openFile( tempPath, roSync ); } );
+	readFile<LinuxFileReadStream>( suite, "File read, LinuxFileReadStream, io_uring", [ & ]( LinuxFileReadStream* s ) { return s->openFile( tempPath, ro ); } );
+	readFile<LinuxFileReadStream>( suite, "File read, LinuxFileReadStream, O_DIRECT", [ & ]( LinuxFileReadStream* s ) { return s->openFile( tempPath, roDirect ); } );
+
+	remove( tempPath );
+}
@@ -0,0 +1,95 @@
+#include "benchmarks.h"
+#include <algorithm>
+#include <numeric>
+#include <string.h>
+
+namespace
+{
+	// Nearest-rank percentile of sorted values
+	double percentile( const std::vector<double>& sorted, double p )
+	{
+		if( sorted.empty() )
+			return 0;
+		size_t idx = (size_t)( p * (double)sorted.size() );
+		idx = std::min( idx, sorted.size() - 1 );
+		return sorted[ idx ];
+	}
+
+	void printJsonString( FILE* stream, const std::string& s )
+	{
+		fputc( '"', stream );
+		for( char c : s )
+		{
+			if( c == '"' || c == '\\' )
+				fputc( '\\', stream );
+			fputc( c, stream );
+		}
+		fputc( '"', stream );
+	}
+}
+
+using namespace Benchmarks;
+
+double Benchmarks::clockOverhead()
+{
+	static const double overhead = []()
+	{
+		std::vector<double> values( 100000 );
+		for( double& v : values )
+		{
+			const auto start = Clock::now();
+			const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+			v = elapsed.count();
+		}
+		std::sort( values.begin(), values.end() );
+		return values[ values.size() / 2 ];
+	}();
+	return overhead;
+}
+
+bool Suite::enabled( const char* name ) const
+{
+	if( m_filter.empty() )
+		return true;
+	return nullptr != strstr( name, m_filter.c_str() );
+}
+
+void Suite::add( const char* name, Samples& samples, const char* unit )
+{
+	std::vector<double>& values = samples.values();
+	std::sort( values.begin(), values.end() );
+
+	Result r;
+	r.name = name;
+	r.unit = unit;
+	r.samples = values.size();
+	r.operations = samples.operations();
+	r.batch = samples.batch();
+	r.mean = values.empty() ? 0 : std::accumulate( values.begin(), values.end(), 0.0 ) / (double)values.size();
+	r.p50 = percentile( values, 0.5 );
+	r.p99 = percentile( values, 0.99 );
+	r.p999 = percentile( values, 0.999 );
+	r.min = values.empty() ? 0 : values.front();
+	r.max = values.empty() ? 0 : values.back();
+
+	printf( "%-48s %10.2f %12.2f %12.2f %12.2f %8llu  %s\n", name, r.mean, r.p50, r.p99, r.p999, (unsigned long long)r.batch, unit );
+	fflush( stdout );
+	m_results.emplace_back( std::move( r ) );
+}
+
+void Suite::printJson( FILE* stream ) const
+{
+	fprintf( stream, "{\n\t\"benchmarks\": [\n" );
+	for( size_t i = 0; i < m_results.size(); i++ )
+	{
+		const Result& r = m_results[ i ];
+		fprintf( stream, "\t\t{ \"name\": " );
+		printJsonString( stream, r.name );
+		fprintf( stream, ", \"unit\": " );
+		printJsonString( stream, r.unit );
+		fprintf( stream, ", \"samples\": %llu, \"operations\": %llu, \"batch\": %llu, \"mean\": %g, \"p50\": %g, \"p99\": %g, \"p999\": %g, \"min\": %g, \"max\": %g }%s\n",
+			(unsigned long long)r.samples, (unsigned long long)r.operations, (unsigned long long)r.batch, r.mean, r.p50, r.p99, r.p999, r.min, r.max,
+			( i + 1 < m_results.size() ) ? "," : "" );
+	}
+	fprintf( stream, "\t]\n}\n" );
+}
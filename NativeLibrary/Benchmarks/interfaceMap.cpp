@@ -0,0 +1,186 @@
+#include "benchmarks.h"
+#include "../../ComLightLib/comLightServer.h"
+
+namespace
+{
+	using namespace ComLight;
+
+	// Many distinct interfaces with generated IIDs
+	template<int N>
+	struct DECLSPEC_NOVTABLE iNumbered : public IUnknown
+	{
+		static constexpr GUID iid()
+		{
+			return GUID{ 0x6b2f0000u + N * 0x01000193u, 0x1c3d, 0x4e5f, { 0x80, 0x91, 0xa2, 0xb3, 0xc4, 0xd5, 0xe6, (uint8_t)N } };
+		}
+	};
+
+	// Object implementing 20 interfaces
+	class Many : public ObjectRoot<iNumbered<0>>,
+		public iNumbered<1>, public iNumbered<2>, public iNumbered<3>, public iNumbered<4>, public iNumbered<5>,
+		public iNumbered<6>, public iNumbered<7>, public iNumbered<8>, public iNumbered<9>, public iNumbered<10>,
+		public iNumbered<11>, public iNumbered<12>, public iNumbered<13>, public iNumbered<14>, public iNumbered<15>,
+		public iNumbered<16>, public iNumbered<17>, public iNumbered<18>, public iNumbered<19>
+	{ };
+
+	class WithMacroChain : public Many
+	{
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iNumbered<0> )
+			COM_INTERFACE_ENTRY( iNumbered<1> )
+			COM_INTERFACE_ENTRY( iNumbered<2> )
+			COM_INTERFACE_ENTRY( iNumbered<3> )
+			COM_INTERFACE_ENTRY( iNumbered<4> )
+			COM_INTERFACE_ENTRY( iNumbered<5> )
+			COM_INTERFACE_ENTRY( iNumbered<6> )
+			COM_INTERFACE_ENTRY( iNumbered<7> )
+			COM_INTERFACE_ENTRY( iNumbered<8> )
+			COM_INTERFACE_ENTRY( iNumbered<9> )
+			COM_INTERFACE_ENTRY( iNumbered<10> )
+			COM_INTERFACE_ENTRY( iNumbered<11> )
+			COM_INTERFACE_ENTRY( iNumbered<12> )
+			COM_INTERFACE_ENTRY( iNumbered<13> )
+			COM_INTERFACE_ENTRY( iNumbered<14> )
+			COM_INTERFACE_ENTRY( iNumbered<15> )
+			COM_INTERFACE_ENTRY( iNumbered<16> )
+			COM_INTERFACE_ENTRY( iNumbered<17> )
+			COM_INTERFACE_ENTRY( iNumbered<18> )
+			COM_INTERFACE_ENTRY( iNumbered<19> )
+		END_COM_MAP()
+	};
+
+	class WithTable : public Many
+	{
+		COM_INTERFACE_TABLE( iNumbered<0>, iNumbered<1>, iNumbered<2>, iNumbered<3>, iNumbered<4>,
+			iNumbered<5>, iNumbered<6>, iNumbered<7>, iNumbered<8>, iNumbered<9>,
+			iNumbered<10>, iNumbered<11>, iNumbered<12>, iNumbered<13>, iNumbered<14>,
+			iNumbered<15>, iNumbered<16>, iNumbered<17>, iNumbered<18>, iNumbered<19> )
+	};
+
+	// Same macro chain, with the per-thread cache of QueryInterface results
+	class WithMacroChainCached : public WithMacroChain
+	{
+		DECLARE_QUERY_INTERFACE_CACHE()
+	};
+
+	// Object implementing 5 interfaces with multiple inheritance, each one costs a vtable pointer in every instance
+	class Inherited : public ObjectRoot<iNumbered<0>>,
+		public iNumbered<1>, public iNumbered<2>, public iNumbered<3>, public iNumbered<4>
+	{
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iNumbered<0> )
+			COM_INTERFACE_ENTRY( iNumbered<1> )
+			COM_INTERFACE_ENTRY( iNumbered<2> )
+			COM_INTERFACE_ENTRY( iNumbered<3> )
+			COM_INTERFACE_ENTRY( iNumbered<4> )
+		END_COM_MAP()
+	};
+
+	class WithTearOffs;
+
+	template<int N>
+	class NumberedTearOff : public TearOffRoot<WithTearOffs, iNumbered<N>>
+	{ };
+
+	// Same interfaces, 4 of them are tear-offs
+	class WithTearOffs : public ObjectRoot<iNumbered<0>>
+	{
+		BEGIN_COM_MAP()
+			COM_INTERFACE_ENTRY( iNumbered<0> )
+			COM_INTERFACE_ENTRY_TEAR_OFF( iNumbered<1>, NumberedTearOff<1> )
+			COM_INTERFACE_ENTRY_TEAR_OFF( iNumbered<2>, NumberedTearOff<2> )
+			COM_INTERFACE_ENTRY_TEAR_OFF( iNumbered<3>, NumberedTearOff<3> )
+			COM_INTERFACE_ENTRY_TEAR_OFF( iNumbered<4>, NumberedTearOff<4> )
+		END_COM_MAP()
+	};
+
+	constexpr int callsPerSample = 64;
+	constexpr int samplesCount = 20000;
+
+	void queryInterface( Benchmarks::Suite& suite, const char* name, IUnknown* obj, REFIID iid )
+	{
+		if( !suite.enabled( name ) )
+			return;
+
+		Benchmarks::Samples samples{ samplesCount };
+		for( int s = 0; s < samplesCount; s++ )
+		{
+			const auto start = Benchmarks::Clock::now();
+			for( int i = 0; i < callsPerSample; i++ )
+			{
+				IUnknown* unk = nullptr;
+				if( SUCCEEDED( obj->QueryInterface( iid, (void**)&unk ) ) )
+					unk->Release();
+			}
+			samples.add( start, Benchmarks::Clock::now(), callsPerSample );
+		}
+		suite.add( name, samples );
+	}
+
+	template<class T>
+	void queryAll( Benchmarks::Suite& suite, const char* kind )
+	{
+		CComPtr<iNumbered<0>> obj;
+		if( FAILED( Object<T>::create( &obj ) ) )
+			return;
+
+		char name[ 96 ];
+		snprintf( name, sizeof( name ), "QI of 20 interfaces, %s, first", kind );
+		queryInterface( suite, name, obj, iNumbered<0>::iid() );
+		snprintf( name, sizeof( name ), "QI of 20 interfaces, %s, middle", kind );
+		queryInterface( suite, name, obj, iNumbered<10>::iid() );
+		snprintf( name, sizeof( name ), "QI of 20 interfaces, %s, last", kind );
+		queryInterface( suite, name, obj, iNumbered<19>::iid() );
+		snprintf( name, sizeof( name ), "QI of 20 interfaces, %s, IUnknown", kind );
+		queryInterface( suite, name, obj, IUnknown::iid() );
+		snprintf( name, sizeof( name ), "QI of 20 interfaces, %s, miss", kind );
+		queryInterface( suite, name, obj, iNumbered<20>::iid() );
+	}
+
+	// Time to create a million objects, the samples are nanoseconds per object; prints the memory used by each object
+	template<class T>
+	void createMany( Benchmarks::Suite& suite, const char* name )
+	{
+		if( !suite.enabled( name ) )
+			return;
+		constexpr size_t count = 1024 * 1024;
+		std::vector<CComPtr<Object<T>>> objects;
+		objects.reserve( count );
+		Benchmarks::Samples samples{ 8 };
+		for( int r = 0; r < 8; r++ )
+		{
+			objects.clear();
+			const auto start = Benchmarks::Clock::now();
+			for( size_t i = 0; i < count; i++ )
+			{
+				CComPtr<Object<T>> obj;
+				if( FAILED( Object<T>::create( obj ) ) )
+					return;
+				objects.emplace_back( std::move( obj ) );
+			}
+			samples.add( start, Benchmarks::Clock::now(), count );
+		}
+		suite.add( name, samples );
+		printf( "%s: %zu bytes per object, %zu MB per million objects\n", name, sizeof( Object<T> ), sizeof( Object<T> ) * 1000000 / ( 1024 * 1024 ) );
+	}
+
+	void tearOffs( Benchmarks::Suite& suite )
+	{
+		createMany<Inherited>( suite, "Create 1M objects, 5 inherited interfaces" );
+		createMany<WithTearOffs>( suite, "Create 1M objects, 1 inherited + 4 tear-offs" );
+
+		CComPtr<iNumbered<0>> inherited, withTearOffs;
+		if( FAILED( Object<Inherited>::create( &inherited ) ) || FAILED( Object<WithTearOffs>::create( &withTearOffs ) ) )
+			return;
+		queryInterface( suite, "QI of 5 interfaces, inherited, last", inherited, iNumbered<4>::iid() );
+		queryInterface( suite, "QI of 5 interfaces, tear-off, last", withTearOffs, iNumbered<4>::iid() );
+	}
+}
+
+void Benchmarks::interfaceMap( Suite& suite )
+{
+	queryAll<WithMacroChain>( suite, "macro chain" );
+	queryAll<WithTable>( suite, "table" );
+	queryAll<WithMacroChainCached>( suite, "cached" );
+	tearOffs( suite );
+}
@@ -0,0 +1,49 @@
+#include "benchmarks.h"
+#include <string.h>
+
+static void printUsage()
+{
+	printf( "Usage: comlight-bench [--filter <substring>] [--json <path>]\n" );
+	printf( "Prints mean and percentiles of every benchmark. With --json, also writes the results to the file, for tracking between releases.\n" );
+	printf( "The percentiles are over samples. When the batch column is above 1, each sample is the mean of that many operations, and the tails of individual operations are understated.\n" );
+}
+
+int main( int argc, char** argv )
+{
+	const char* filter = nullptr;
+	const char* jsonPath = nullptr;
+	for( int i = 1; i < argc; i++ )
+	{
+		if( 0 == strcmp( argv[ i ], "--filter" ) && i + 1 < argc )
+			filter = argv[ ++i ];
+		else if( 0 == strcmp( argv[ i ], "--json" ) && i + 1 < argc )
+			jsonPath = argv[ ++i ];
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+
+	Benchmarks::Suite suite{ filter };
+	printf( "%-48s %10s %12s %12s %12s %8s\n", "Benchmark", "mean", "batch p50", "batch p99", "batch p99.9", "batch" );
+	Benchmarks::calls( suite );
+	Benchmarks::interfaceMap( suite );
+	Benchmarks::refCounting( suite );
+	Benchmarks::allocation( suite );
+	Benchmarks::streams( suite );
+	Benchmarks::files( suite );
+
+	if( nullptr != jsonPath )
+	{
+		FILE* f = fopen( jsonPath, "wt" );
+		if( nullptr == f )
+		{
+			fprintf( stderr, "Unable to create %s\n", jsonPath );
+			return 1;
+		}
+		suite.printJson( f );
+		fclose( f );
+	}
+	return 0;
+}
@@ -0,0 +1,176 @@
+#include "benchmarks.h"
+#include "../../ComLightLib/comLightServer.h"
+#include "../../ComLightLib/client/AtomicComPtr.hpp"
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+namespace
+{
+	using namespace ComLight;
+
+	struct DECLSPEC_NOVTABLE iEmpty : public IUnknown
+	{
+		DEFINE_INTERFACE_ID( "{4e9a5d2c-0f0b-4b6e-9d6a-3c1f2b7e8a10}" );
+	};
+
+	template<class TPolicy>
+	class Empty : public ObjectRoot<iEmpty, TPolicy> { };
+
+	constexpr int pairsPerSample = 64;
+	constexpr int samplesCount = 100000;
+
+	void addRefRelease( iEmpty* p, Benchmarks::Samples& samples, int count )
+	{
+		for( int s = 0; s < count; s++ )
+		{
+			const auto start = Benchmarks::Clock::now();
+			for( int i = 0; i < pairsPerSample; i++ )
+			{
+				p->AddRef();
+				p->Release();
+			}
+			samples.add( start, Benchmarks::Clock::now(), pairsPerSample );
+		}
+	}
+
+	// AddRef + Release pairs through the interface pointer, from a single thread
+	template<class TPolicy>
+	void singleThread( Benchmarks::Suite& suite, const char* name )
+	{
+		if( !suite.enabled( name ) )
+			return;
+
+		CComPtr<iEmpty> obj;
+		Object<Empty<TPolicy>>::create( &obj );
+		Benchmarks::Samples samples{ samplesCount };
+		addRefRelease( obj, samples, samplesCount );
+		suite.add( name, samples );
+	}
+
+	// All threads are calling AddRef + Release on the same object
+	template<class TPolicy>
+	void contended( Benchmarks::Suite& suite, const char* name )
+	{
+		if( !suite.enabled( name ) )
+			return;
+
+		CComPtr<iEmpty> obj;
+		Object<Empty<TPolicy>>::create( &obj );
+
+		const int threadsCount = (int)std::max( 2u, std::thread::hardware_concurrency() );
+		const int perThread = samplesCount / threadsCount;
+		std::vector<Benchmarks::Samples> samples;
+		samples.resize( threadsCount );
+		std::vector<std::thread> threads;
+		for( int i = 0; i < threadsCount; i++ )
+		{
+			Benchmarks::Samples& s = samples[ i ];
+			iEmpty* const p = obj;
+			threads.emplace_back( [ p, &s, perThread ]() { addRefRelease( p, s, perThread ); } );
+		}
+		for( auto& t : threads )
+			t.join();
+
+		Benchmarks::Samples merged;
+		for( auto& s : samples )
+			for( double v : s.values() )
+				merged.addValue( v, pairsPerSample );
+		suite.add( name, merged );
+	}
+
+	// Shared object replaced by a writer, guarded by a mutex
+	class LockedComPtr
+	{
+		std::mutex m_lock;
+		CComPtr<iEmpty> m_ptr;
+
+	public:
+
+		CComPtr<iEmpty> load()
+		{
+			std::lock_guard<std::mutex> lock( m_lock );
+			return m_ptr;
+		}
+
+		void store( iEmpty* p )
+		{
+			CComPtr<iEmpty> old;
+			{
+				std::lock_guard<std::mutex> lock( m_lock );
+				old = m_ptr;
+				m_ptr = p;
+			}
+		}
+	};
+
+	constexpr int loadsPerSample = 64;
+
+	// All threads are loading the shared pointer, one of them also replaces the object every 256 samples
+	template<class TShared>
+	void sharedPointer( Benchmarks::Suite& suite, const char* name )
+	{
+		if( !suite.enabled( name ) )
+			return;
+
+		CComPtr<iEmpty> objects[ 2 ];
+		for( auto& p : objects )
+			Object<Empty<AtomicRefCount>>::create( &p );
+		TShared shared;
+		shared.store( objects[ 0 ] );
+
+		const int threadsCount = (int)std::max( 2u, std::thread::hardware_concurrency() );
+		const int perThread = samplesCount / threadsCount;
+		std::vector<Benchmarks::Samples> samples;
+		samples.resize( threadsCount );
+		std::atomic_int failures{ 0 };
+		std::vector<std::thread> threads;
+		for( int i = 0; i < threadsCount; i++ )
+		{
+			Benchmarks::Samples& s = samples[ i ];
+			const bool writer = 0 == i;
+			threads.emplace_back( [ &, writer ]()
+			{
+				for( int j = 0; j < perThread; j++ )
+				{
+					if( writer && 0 == ( j % 256 ) )
+						shared.store( objects[ ( j / 256 ) % 2 ] );
+					const auto start = Benchmarks::Clock::now();
+					for( int k = 0; k < loadsPerSample; k++ )
+					{
+						CComPtr<iEmpty> p = shared.load();
+						if( !p )
+							failures++;
+					}
+					s.add( start, Benchmarks::Clock::now(), loadsPerSample );
+				}
+			} );
+		}
+		for( auto& t : threads )
+			t.join();
+		shared.store( nullptr );
+
+		if( 0 != failures )
+		{
+			printf( "%s: %i loads returned null\n", name, failures.load() );
+			return;
+		}
+		Benchmarks::Samples merged;
+		for( auto& s : samples )
+			for( double v : s.values() )
+				merged.addValue( v, loadsPerSample );
+		suite.add( name, merged );
+	}
+}
+
+void Benchmarks::refCounting( Suite& suite )
+{
+	singleThread<AtomicRefCount>( suite, "AddRef + Release, atomic" );
+	singleThread<SingleThreadRefCount>( suite, "AddRef + Release, single thread" );
+	singleThread<CheckedRefCount>( suite, "AddRef + Release, checked" );
+	contended<AtomicRefCount>( suite, "AddRef + Release, atomic, contended" );
+	contended<CheckedRefCount>( suite, "AddRef + Release, checked, contended" );
+	sharedPointer<LockedComPtr>( suite, "Load shared object, mutex + CComPtr" );
+	sharedPointer<AtomicComPtr<iEmpty>>( suite, "Load shared object, AtomicComPtr" );
+}
@@ -0,0 +1,273 @@
+#include "benchmarks.h"
+#include "../../ComLightLib/io/MemoryStreams.hpp"
+#include "../../ComLightLib/io/BufferedStreams.hpp"
+#include "../../ComLightLib/io/StreamCopy.hpp"
+#include "../../ComLightLib/io/Pipe.hpp"
+#include "../../ComLightLib/io/ChunkedMemoryStream.hpp"
+#include "../../ComLightLib/io/PrefetchReadStream.hpp"
+#include <thread>
+
+namespace
+{
+	using namespace ComLight;
+
+	// Write stream which discards the data
+	class NullWriteStream : public ObjectRoot<iWriteStream>
+	{
+		HRESULT COMLIGHTCALL write( const void* lpBuffer, int nNumberOfBytesToWrite ) override { return S_OK; }
+		HRESULT COMLIGHTCALL flush() override { return S_OK; }
+	};
+
+	constexpr size_t sourceLength = 64 * 1024 * 1024;
+	constexpr int repetitions = 8;
+
+	// Copy the complete source stream with read / write calls of the specified size, the samples are MB/s of each repetition
+	void copyStream( Benchmarks::Suite& suite, iReadStream* source, iWriteStream* dest, int bufferSize )
+	{
+		char name[ 64 ];
+		snprintf( name, sizeof( name ), "Stream copy, %d bytes buffer", bufferSize );
+		if( !suite.enabled( name ) )
+			return;
+
+		std::vector<uint8_t> buffer( (size_t)bufferSize );
+		Benchmarks::Samples samples{ repetitions };
+		for( int r = 0; r < repetitions; r++ )
+		{
+			source->seek( 0, eSeekOrigin::Begin );
+			const auto start = Benchmarks::Clock::now();
+			while( true )
+			{
+				int cb = 0;
+				if( FAILED( source->read( buffer.data(), bufferSize, cb ) ) || 0 == cb )
+					break;
+				dest->write( buffer.data(), cb );
+			}
+			const double seconds = Benchmarks::secondsSince( start );
+			samples.addValue( (double)sourceLength / ( seconds * 1024 * 1024 ) );
+		}
+		suite.add( name, samples, "MB/s" );
+	}
+
+	// Same as copyStream with 1MB buffer, but the reads and writes are overlapped by StreamCopy
+	void copyPipelined( Benchmarks::Suite& suite, iReadStream* source, iWriteStream* dest )
+	{
+		const char* const name = "Stream copy, pipelined, 4 x 1048576 bytes buffers";
+		if( !suite.enabled( name ) )
+			return;
+
+		StreamCopy sc{ 1024 * 1024, 4 };
+		Benchmarks::Samples samples{ repetitions };
+		for( int r = 0; r < repetitions; r++ )
+		{
+			source->seek( 0, eSeekOrigin::Begin );
+			CopyResult res;
+			if( FAILED( sc.copy( source, dest, &res ) ) )
+				return;
+			samples.addValue( (double)res.bytes / ( res.seconds * 1024 * 1024 ) );
+		}
+		suite.add( name, samples, "MB/s" );
+	}
+
+	// Stream sourceLength bytes through a 1MB pipe, from a producer thread to the calling thread, in 64kb chunks
+	void pipeThroughput( Benchmarks::Suite& suite )
+	{
+		const char* const name = "Pipe, 1MB capacity, 65536 bytes chunks";
+		if( !suite.enabled( name ) )
+			return;
+
+		constexpr int chunk = 64 * 1024;
+		Benchmarks::Samples samples{ repetitions };
+		for( int r = 0; r < repetitions; r++ )
+		{
+			CComPtr<iWriteStream> writeEnd;
+			CComPtr<iReadStream> readEnd;
+			if( FAILED( createPipe( 1024 * 1024, ePipeMode::Blocking, &writeEnd, &readEnd ) ) )
+				return;
+
+			const auto start = Benchmarks::Clock::now();
+			std::thread producer( [ &writeEnd ]()
+			{
+				std::vector<uint8_t> buffer( chunk, (uint8_t)0x55 );
+				for( size_t i = 0; i < sourceLength / chunk; i++ )
+					writeEnd->write( buffer.data(), chunk );
+				writeEnd.release();
+			} );
+
+			std::vector<uint8_t> buffer( chunk );
+			int64_t total = 0;
+			while( true )
+			{
+				int cb = 0;
+				if( FAILED( readEnd->read( buffer.data(), chunk, cb ) ) || 0 == cb )
+					break;
+				total += cb;
+			}
+			producer.join();
+			const double seconds = Benchmarks::secondsSince( start );
+			samples.addValue( (double)total / ( seconds * 1024 * 1024 ) );
+		}
+		suite.add( name, samples, "MB/s" );
+	}
+
+	// Write sourceLength bytes in 4kb pieces into a new memory stream, the samples are MB/s
+	template<class TStream>
+	void memoryWrite( Benchmarks::Suite& suite, const char* name )
+	{
+		if( !suite.enabled( name ) )
+			return;
+		constexpr int chunk = 4 * 1024;
+		const std::vector<uint8_t> buffer( chunk, (uint8_t)0x55 );
+		Benchmarks::Samples samples{ repetitions };
+		for( int r = 0; r < repetitions; r++ )
+		{
+			const auto start = Benchmarks::Clock::now();
+			{
+				CComPtr<Object<TStream>> stream;
+				if( FAILED( Object<TStream>::create( stream ) ) )
+					return;
+				iWriteStream* const ws = stream;
+				for( size_t i = 0; i < sourceLength / chunk; i++ )
+					ws->write( buffer.data(), chunk );
+			}
+			const double seconds = Benchmarks::secondsSince( start );
+			samples.addValue( (double)sourceLength / ( seconds * 1024 * 1024 ) );
+		}
+		suite.add( name, samples, "MB/s" );
+	}
+
+	// Read the complete source stream as 16-byte records, the samples are nanoseconds per record
+	void readRecords( Benchmarks::Suite& suite, const char* name, iReadStream* stream )
+	{
+		if( !suite.enabled( name ) )
+			return;
+		constexpr int recordSize = 16;
+		uint8_t record[ recordSize ];
+		Benchmarks::Samples samples{ repetitions };
+		for( int r = 0; r < repetitions; r++ )
+		{
+			stream->seek( 0, eSeekOrigin::Begin );
+			const auto start = Benchmarks::Clock::now();
+			while( true )
+			{
+				int cb = 0;
+				if( FAILED( stream->read( record, recordSize, cb ) ) || 0 == cb )
+					break;
+			}
+			samples.add( start, Benchmarks::Clock::now(), sourceLength / recordSize );
+		}
+		suite.add( name, samples );
+	}
+
+	// Counts read calls, stands for a stream implemented on the other side of the interop
+	class CountingReadStream : public ObjectRoot<iReadStream>
+	{
+	public:
+		CComPtr<iReadStream> source;
+		uint64_t calls = 0;
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			calls++;
+			return source->read( lpBuffer, nNumberOfBytesToRead, lpNumberOfBytesRead );
+		}
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override { return source->seek( offset, origin ); }
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override { return source->getPosition( position ); }
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override { return source->getLength( length ); }
+	};
+
+	void smallRecords( Benchmarks::Suite& suite, iReadStream* source )
+	{
+		CComPtr<Object<CountingReadStream>> counting;
+		CComPtr<Object<BufferedReadStream>> buffered;
+		if( FAILED( Object<CountingReadStream>::create( counting ) ) || FAILED( Object<BufferedReadStream>::create( buffered ) ) )
+			return;
+		counting->source = source;
+		buffered->initialize( counting );
+
+		readRecords( suite, "Small records, direct", counting );
+		const uint64_t direct = counting->calls;
+		counting->calls = 0;
+		readRecords( suite, "Small records, BufferedReadStream", buffered );
+		if( 0 != direct && 0 != counting->calls )
+			printf( "Small records: %llu calls to the source stream direct, %llu buffered\n", (unsigned long long)direct, (unsigned long long)counting->calls );
+	}
+
+	// Sleeps before each read, stands for a source stream which does I/O
+	class LatencyReadStream : public ObjectRoot<iReadStream>
+	{
+	public:
+		CComPtr<iReadStream> source;
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+			return source->read( lpBuffer, nNumberOfBytesToRead, lpNumberOfBytesRead );
+		}
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override { return source->seek( offset, origin ); }
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override { return source->getPosition( position ); }
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override { return source->getLength( length ); }
+	};
+
+	// Read 16MB in 64kb blocks, spending 200 microseconds of CPU time processing each block, the samples are MB/s
+	void slowConsumer( Benchmarks::Suite& suite, const char* name, iReadStream* stream )
+	{
+		if( !suite.enabled( name ) )
+			return;
+		constexpr int chunk = 64 * 1024;
+		constexpr int64_t length = 16 * 1024 * 1024;
+		std::vector<uint8_t> buffer( chunk );
+		Benchmarks::Samples samples{ repetitions };
+		for( int r = 0; r < repetitions; r++ )
+		{
+			stream->seek( 0, eSeekOrigin::Begin );
+			const auto start = Benchmarks::Clock::now();
+			int64_t total = 0;
+			while( total < length )
+			{
+				int cb = 0;
+				if( FAILED( stream->read( buffer.data(), chunk, cb ) ) || 0 == cb )
+					break;
+				total += cb;
+				const auto processed = Benchmarks::Clock::now() + std::chrono::microseconds( 200 );
+				while( Benchmarks::Clock::now() < processed ) { }
+			}
+			const double seconds = Benchmarks::secondsSince( start );
+			samples.addValue( (double)total / ( seconds * 1024 * 1024 ) );
+		}
+		suite.add( name, samples, "MB/s" );
+	}
+
+	void readAhead( Benchmarks::Suite& suite, iReadStream* source )
+	{
+		CComPtr<Object<LatencyReadStream>> latency;
+		CComPtr<Object<PrefetchReadStream>> prefetch;
+		if( FAILED( Object<LatencyReadStream>::create( latency ) ) || FAILED( Object<PrefetchReadStream>::create( prefetch ) ) )
+			return;
+		latency->source = source;
+		source->seek( 0, eSeekOrigin::Begin );
+		if( FAILED( prefetch->initialize( latency ) ) )
+			return;
+
+		slowConsumer( suite, "Read-ahead, direct", latency );
+		slowConsumer( suite, "Read-ahead, PrefetchReadStream", prefetch );
+	}
+}
+
+void Benchmarks::streams( Suite& suite )
+{
+	std::vector<uint8_t> data( sourceLength, (uint8_t)0x55 );
+	CComPtr<Object<MemoryReadStream>> source;
+	CComPtr<Object<NullWriteStream>> dest;
+	if( FAILED( Object<MemoryReadStream>::create( source ) ) || FAILED( Object<NullWriteStream>::create( dest ) ) )
+		return;
+	source->initialize( std::move( data ) );
+
+	for( int bufferSize : { 64, 1024, 16 * 1024, 256 * 1024, 1024 * 1024 } )
+		copyStream( suite, source, dest, bufferSize );
+	copyPipelined( suite, source, dest );
+	smallRecords( suite, source );
+	readAhead( suite, source );
+	pipeThroughput( suite );
+	memoryWrite<MemoryWriteStream>( suite, "Memory stream growth, MemoryWriteStream" );
+	memoryWrite<ChunkedMemoryStream>( suite, "Memory stream growth, ChunkedMemoryStream" );
+}
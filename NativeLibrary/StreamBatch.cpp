@@ -0,0 +1,44 @@
+#include "stdafx.h"
+#include "../ComLightLib/comLightServer.h"
+#include "../ComLightLib/streams.h"
+#include <vector>
+
+// Copy the source stream to the destination with a single batched read and a single batched write: a 4-bytes header, the payload, and a 4-bytes trailer.
+// Used by PortableClient to test iReadStreamBatch and iWriteStreamBatch implemented in .NET. Fails with E_NOINTERFACE when either stream doesn't implement them.
+DLLEXPORT HRESULT COMLIGHTCALL copyStreamBatch( ComLight::iReadStream* source, ComLight::iWriteStream* dest )
+{
+	if( nullptr == source || nullptr == dest )
+		return E_POINTER;
+	using namespace ComLight;
+
+	ReadBatch reader{ source };
+	WriteBatch writer{ dest };
+	if( !reader.isBatched() || !writer.isBatched() )
+		return E_NOINTERFACE;
+
+	int64_t length;
+	CHECK( source->getLength( length ) );
+	if( length < 8 || length > INT_MAX )
+		return E_INVALIDARG;
+
+	uint32_t header, trailer;
+	std::vector<uint8_t> payload;
+	try
+	{
+		payload.resize( (size_t)length - 8 );
+	}
+	catch( const std::bad_alloc& )
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	reader.add( header );
+	reader.add( payload );
+	reader.add( trailer );
+	CHECK( reader.read() );
+
+	writer.add( header );
+	writer.add( payload );
+	writer.add( trailer );
+	return writer.write();
+}
@@ -3,10 +3,12 @@
 #include <vector>
 #include <chrono>
 #include <random>
+#include <string.h>
 #include "WriteStream.h"
 
 HRESULT COMLIGHTCALL Test::add( int a, int b, int& result )
 {
+	INSTRUMENT_METHOD();
 	int64_t res = (int64_t)a + (int64_t)b;
 	if( res < INT_MIN || res > INT_MAX )
 		return DISP_E_OVERFLOW;
@@ -16,30 +18,43 @@ HRESULT COMLIGHTCALL Test::add( int a, int b, int& result )
 
 HRESULT COMLIGHTCALL Test::addManaged( ITest* pManaged, int a, int b, int& result )
 {
+	INSTRUMENT_METHOD();
 	return pManaged->add( a, b, result );
 }
 
-HRESULT COMLIGHTCALL Test::testPerformance( ITest* pManaged, int& result, double& elapsedSeconds )
+namespace
 {
-	std::vector<int> values;
-	values.resize( 1000000 );
+	std::vector<int> makeRandomValues( size_t count )
+	{
+		std::vector<int> values;
+		values.resize( count );
 
-	// https://stackoverflow.com/a/19666713/126995
-	std::random_device rd;
-	std::mt19937 mt( rd() );
-	std::uniform_int_distribution<int> dist( 0, 0x40000000 );
-	for( int& v : values )
-		v = dist( mt );
+		// https://stackoverflow.com/a/19666713/126995
+		std::random_device rd;
+		std::mt19937 mt( rd() );
+		std::uniform_int_distribution<int> dist( 0, 0x40000000 );
+		for( int& v : values )
+			v = dist( mt );
+		return values;
+	}
+}
+
+// Native to managed calls. For the native-only benchmarks, with latency percentiles, see comlight-bench executable built from Benchmarks subdirectory.
+HRESULT COMLIGHTCALL Test::testPerformance( ITest* pManaged, int& result, double& elapsedSeconds )
+{
+	if( nullptr == pManaged )
+		return E_POINTER;
+	const std::vector<int> values = makeRandomValues( 1000000 );
 
 	int x = 0;
-	const auto start = std::chrono::high_resolution_clock::now();
+	const auto start = std::chrono::steady_clock::now();
 	for( int i: values )
 	{
-		int r;
+		int r = 0;
 		pManaged->add( i, i, r );
 		x ^= r;
 	}
-	const auto finish = std::chrono::high_resolution_clock::now();
+	const auto finish = std::chrono::steady_clock::now();
 	std::chrono::duration<double> elapsed = finish - start;
 	result = x;
 	elapsedSeconds = elapsed.count();
@@ -87,4 +102,7 @@ HRESULT COMLIGHTCALL Test::testMarshalBack( LPCTSTR path, ITest *pManaged )
 DLLEXPORT HRESULT COMLIGHTCALL createTest( ITest **pp )
 {
 	return ComLight::Object<Test>::create( pp );
-}
\ No newline at end of file
+}
+
+// Statistics of the methods marked with INSTRUMENT_METHOD(), only collected when built with COMLIGHT_INSTRUMENTATION
+DEFINE_METHOD_STATS_EXPORT( getMethodStats )
\ No newline at end of file
@@ -29,4 +29,6 @@ class Test: public ComLight::ObjectRoot<ITest>, public ITest2
 	END_COM_MAP() */
 };
 
-DLLEXPORT HRESULT COMLIGHTCALL createTest( ITest **pp );
\ No newline at end of file
+DLLEXPORT HRESULT COMLIGHTCALL createTest( ITest **pp );
+
+DLLEXPORT HRESULT COMLIGHTCALL getMethodStats( ComLight::pfnMethodStats callback, void* context );
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "tests.h"
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../../ComLightLib/comLightServer.h"
+#include "../../ComLightLib/client/AtomicComPtr.hpp"
+
+namespace
+{
+	using namespace ComLight;
+
+	struct DECLSPEC_NOVTABLE iCounted : public ComLight::IUnknown
+	{
+		DEFINE_INTERFACE_ID( "{6f0b2c8e-93d4-4a71-b5e2-0c8d7f1a2e64}" );
+	};
+
+	std::atomic<int> liveObjects{ 0 };
+
+	class Counted : public ObjectRoot<iCounted>
+	{
+	public:
+		Counted() { liveObjects++; }
+		~Counted() { liveObjects--; }
+	};
+
+	// Reference counter of the object, excluding the temporary reference of this function
+	uint32_t refCount( iCounted* p )
+	{
+		p->AddRef();
+		return p->Release();
+	}
+
+	bool same( iCounted* a, iCounted* b )
+	{
+		return a == b;
+	}
+
+	constexpr int objectsCount = 4;
+	constexpr int threadsCount = 8;
+	constexpr int iterations = 200000;
+
+	// Threads doing random loads, exchanges and compare-exchanges. When switchHalfway is true, one of the threads switches the pointer to the locked mode in the middle.
+	// Verifies the pointers loaded are always valid, and the reference counters are exact after the threads are done.
+	bool stress( bool lockedFromStart, bool switchHalfway )
+	{
+		std::vector<CComPtr<iCounted>> objects( objectsCount );
+		for( auto& obj : objects )
+			if( FAILED( Object<Counted>::create( &obj ) ) )
+				return false;
+
+		std::atomic<int> errors{ 0 };
+		{
+			AtomicComPtr<iCounted> shared{ objects[ 0 ] };
+			if( lockedFromStart )
+				shared.switchToLockedMode();
+
+			std::vector<std::thread> threads;
+			for( int t = 0; t < threadsCount; t++ )
+			{
+				threads.emplace_back( [ &, t ]()
+				{
+					std::mt19937 rng{ (uint32_t)t };
+					for( int i = 0; i < iterations; i++ )
+					{
+						if( switchHalfway && 0 == t && iterations / 2 == i )
+							shared.switchToLockedMode();
+						iCounted* const desired = ( rng() % 8 == 0 ) ? nullptr : objects[ rng() % objectsCount ];
+						switch( rng() % 4 )
+						{
+						case 0:
+						case 1:
+						{
+							CComPtr<iCounted> p = shared.load();
+							// Every reachable object is alive, and has our reference plus the one of the vector
+							if( p && refCount( p ) < 2 )
+								errors++;
+							break;
+						}
+						case 2:
+							shared.exchange( desired );
+							break;
+						case 3:
+						{
+							CComPtr<iCounted> expected = shared.load();
+							if( !shared.compare_exchange( expected, desired ) )
+							{
+								// On failure, expected was updated with the current object, retry once with it
+								shared.compare_exchange( expected, desired );
+							}
+							break;
+						}
+						}
+					}
+				} );
+			}
+			for( auto& th : threads )
+				th.join();
+
+			// The vector holds one reference, the shared pointer one more to the object it contains
+			CComPtr<iCounted> current = shared.load();
+			for( auto& obj : objects )
+			{
+				const uint32_t expected = ( same( obj, current ) ) ? 3 : 1;
+				if( refCount( obj ) != expected )
+					errors++;
+			}
+		}
+
+		// The destructor of the shared pointer released its reference
+		for( auto& obj : objects )
+			if( refCount( obj ) != 1 )
+				errors++;
+		objects.clear();
+		return 0 == errors && 0 == liveObjects;
+	}
+
+	bool singleThread( bool locked )
+	{
+		CComPtr<iCounted> a, b;
+		if( FAILED( Object<Counted>::create( &a ) ) || FAILED( Object<Counted>::create( &b ) ) )
+			return false;
+		bool ok = true;
+		{
+			AtomicComPtr<iCounted> shared;
+			if( locked )
+				shared.switchToLockedMode();
+			ok = ok && !shared.load();
+
+			shared.store( a );
+			// The temporary references returned by load() are released at the end of the statements
+			ok = ok && same( shared.load(), a );
+			ok = ok && 2 == refCount( a );
+
+			CComPtr<iCounted> old = shared.exchange( b );
+			ok = ok && same( old, a ) && 2 == refCount( a ) && 2 == refCount( b );
+			old.release();
+
+			// Mismatch: expected is replaced with the current object, nothing changes
+			CComPtr<iCounted> expected = a;
+			ok = ok && !shared.compare_exchange( expected, a );
+			ok = ok && same( expected, b );
+			ok = ok && same( shared.load(), b );
+
+			// Match
+			ok = ok && shared.compare_exchange( expected, nullptr );
+			ok = ok && !shared.load();
+			expected.release();
+			ok = ok && 1 == refCount( a ) && 1 == refCount( b );
+
+			shared.store( a );
+		}
+		return ok && 1 == refCount( a );
+	}
+}
+
+void Tests::atomicComPtr()
+{
+	check( singleThread( false ), "AtomicComPtr, single thread" );
+	check( singleThread( true ), "AtomicComPtr, single thread, locked mode" );
+	check( stress( false, false ), "AtomicComPtr, 8 threads" );
+	check( stress( true, false ), "AtomicComPtr, 8 threads, locked mode" );
+	check( stress( false, true ), "AtomicComPtr, 8 threads, switch to the locked mode in the middle" );
+}
@@ -0,0 +1,127 @@
+#include "tests.h"
+#include <thread>
+#include <vector>
+#include "../../ComLightLib/comLightServer.h"
+#include "../../ComLightLib/io/ChunkedMemoryStream.hpp"
+#include "../../ComLightLib/io/MemoryStreams.hpp"
+
+namespace
+{
+	using namespace ComLight;
+
+	constexpr size_t chunkSize = 4096;
+
+	bool readAll( iReadStream* stream, std::vector<uint8_t>& result )
+	{
+		int64_t length = 0;
+		int cb = 0;
+		if( FAILED( stream->getLength( length ) ) || FAILED( stream->seek( 0, eSeekOrigin::Begin ) ) )
+			return false;
+		result.resize( (size_t)length );
+		return SUCCEEDED( stream->read( result.data(), (int)length, cb ) ) && cb == (int)length;
+	}
+
+	// The snapshot keeps the content it was created with, while the stream is modified
+	bool snapshotIsolation()
+	{
+		CComPtr<Object<ChunkedMemoryStream>> stream;
+		if( FAILED( Object<ChunkedMemoryStream>::create( stream ) ) || FAILED( stream->initialize( chunkSize ) ) )
+			return false;
+		std::vector<uint8_t> a( chunkSize * 3 + 100, 'a' );
+		CComPtr<iReadStream> snapshot;
+		bool ok = SUCCEEDED( stream->write( a.data(), (int)a.size() ) ) && SUCCEEDED( stream->createSnapshot( &snapshot ) );
+
+		// Overwrite the middle of the first 2 chunks, and append
+		const std::vector<uint8_t> b( chunkSize, 'b' );
+		ok = ok && SUCCEEDED( stream->seek( chunkSize / 2, eSeekOrigin::Begin ) ) && SUCCEEDED( stream->write( b.data(), (int)b.size() ) );
+		ok = ok && SUCCEEDED( stream->seek( 0, eSeekOrigin::End ) ) && SUCCEEDED( stream->write( b.data(), (int)b.size() ) );
+
+		std::vector<uint8_t> data;
+		ok = ok && readAll( snapshot, data ) && data == a;
+
+		std::vector<uint8_t> expected = a;
+		std::fill( expected.begin() + chunkSize / 2, expected.begin() + chunkSize / 2 + chunkSize, 'b' );
+		expected.insert( expected.end(), b.begin(), b.end() );
+		return ok && readAll( stream, data ) && data == expected;
+	}
+
+	// Another thread reads a snapshot, and releases it, while this thread keeps overwriting the stream
+	bool concurrentSnapshot()
+	{
+		CComPtr<Object<ChunkedMemoryStream>> stream;
+		if( FAILED( Object<ChunkedMemoryStream>::create( stream ) ) || FAILED( stream->initialize( chunkSize ) ) )
+			return false;
+		std::vector<uint8_t> data( chunkSize * 16, 1 );
+		bool ok = SUCCEEDED( stream->write( data.data(), (int)data.size() ) );
+
+		for( int i = 0; i < 100 && ok; i++ )
+		{
+			CComPtr<iReadStream> snapshot;
+			ok = SUCCEEDED( stream->createSnapshot( &snapshot ) );
+			const uint8_t value = (uint8_t)( i + 1 );
+			bool snapshotOk = false;
+			std::thread reader( [ &snapshotOk, &snapshot, value ]()
+			{
+				std::vector<uint8_t> content;
+				snapshotOk = readAll( snapshot, content ) && content.end() == std::find_if( content.begin(), content.end(), [ value ]( uint8_t b ) { return b != value; } );
+				snapshot.release();
+			} );
+			std::fill( data.begin(), data.end(), (uint8_t)( value + 1 ) );
+			for( int j = 0; j < 4 && ok; j++ )
+				ok = SUCCEEDED( stream->seek( 0, eSeekOrigin::Begin ) ) && SUCCEEDED( stream->write( data.data(), (int)data.size() ) );
+			reader.join();
+			ok = ok && snapshotOk;
+		}
+		return ok;
+	}
+
+	// Seeking far past the end and writing a byte doesn't allocate the gap, which reads as zeros
+	bool sparse()
+	{
+		CComPtr<Object<ChunkedMemoryStream>> stream;
+		if( FAILED( Object<ChunkedMemoryStream>::create( stream ) ) )
+			return false;
+		const int64_t offset = (int64_t)1 << 36;
+		const uint8_t one = 1;
+		bool ok = SUCCEEDED( stream->write( &one, 1 ) );
+		ok = ok && SUCCEEDED( stream->seek( offset, eSeekOrigin::Begin ) ) && SUCCEEDED( stream->write( &one, 1 ) );
+		int64_t length = 0;
+		ok = ok && SUCCEEDED( stream->getLength( length ) ) && offset + 1 == length;
+
+		uint8_t buffer[ 16 ];
+		int cb = 0;
+		ok = ok && SUCCEEDED( stream->seek( offset - 15, eSeekOrigin::Begin ) ) && SUCCEEDED( stream->read( buffer, 16, cb ) ) && 16 == cb;
+		for( int i = 0; i < 15; i++ )
+			ok = ok && 0 == buffer[ i ];
+		ok = ok && 1 == buffer[ 15 ];
+
+		std::vector<WriteBuffer> buffers;
+		stream->getBuffers( buffers );
+		int64_t total = 0;
+		for( const WriteBuffer& wb : buffers )
+			total += wb.length;
+		return ok && total == length;
+	}
+
+	// writeTo produces the same bytes as reading, including the gaps
+	bool writeGaps()
+	{
+		CComPtr<Object<ChunkedMemoryStream>> stream;
+		CComPtr<Object<MemoryWriteStream>> dest;
+		if( FAILED( Object<ChunkedMemoryStream>::create( stream ) ) || FAILED( Object<MemoryWriteStream>::create( dest ) ) )
+			return false;
+		const uint8_t x = 0x55;
+		bool ok = SUCCEEDED( stream->seek( 1024 * 1024 + 3, eSeekOrigin::Begin ) ) && SUCCEEDED( stream->write( &x, 1 ) );
+		std::vector<uint8_t> data;
+		ok = ok && readAll( stream, data ) && SUCCEEDED( stream->writeTo( dest ) );
+		return ok && dest->size() == data.size() && 0 == memcmp( dest->data(), data.data(), data.size() ) && x == data.back();
+	}
+}
+
+void Tests::chunkedMemoryStream()
+{
+	check( snapshotIsolation(), "ChunkedMemoryStream, snapshot isolation" );
+	check( concurrentSnapshot(), "ChunkedMemoryStream, snapshot read and released by another thread" );
+	check( sparse(), "ChunkedMemoryStream, seek far past the end" );
+	check( writeGaps(), "ChunkedMemoryStream, writeTo with a gap" );
+}
@@ -0,0 +1,99 @@
+#include "tests.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "../../ComLightLib/comLightServer.h"
+
+namespace
+{
+	using namespace ComLight;
+
+	struct DECLSPEC_NOVTABLE iDeferred : public ComLight::IUnknown
+	{
+		DEFINE_INTERFACE_ID( "{d27a5c94-1e6b-4f03-8a9d-b4c71e0f3d52}" );
+	};
+
+	std::atomic<int> liveObjects{ 0 };
+	std::atomic<int> finalReleased{ 0 };
+	// Count of objects destroyed by the threads which released them
+	std::atomic<int> destroyedByReleasingThread{ 0 };
+	std::atomic<int> flushInDestructor{ 0 };
+
+	thread_local bool releasingThread = false;
+
+	class Deferred : public ObjectRoot<iDeferred>
+	{
+		DECLARE_DEFERRED_DESTRUCTION()
+		bool m_flushFromDestructor = false;
+
+	public:
+
+		Deferred() { liveObjects++; }
+
+		~Deferred()
+		{
+			if( releasingThread )
+				destroyedByReleasingThread++;
+			if( m_flushFromDestructor )
+				flushInDestructor = (int)flushDeferredDestruction();
+			liveObjects--;
+		}
+
+		void FinalRelease() { finalReleased++; }
+
+		void flushFromDestructor() { m_flushFromDestructor = true; }
+	};
+
+	constexpr int threadsCount = 4;
+	constexpr int objectsPerThread = 50000;
+
+	// Several threads create and release objects. After flushDeferredDestruction returns, all of them were destroyed on the background thread.
+	bool flushAfterRelease()
+	{
+		liveObjects = 0;
+		finalReleased = 0;
+		destroyedByReleasingThread = 0;
+		std::atomic<int> errors{ 0 };
+		std::vector<std::thread> threads;
+		for( int t = 0; t < threadsCount; t++ )
+		{
+			threads.emplace_back( [ &errors ]()
+			{
+				releasingThread = true;
+				for( int i = 0; i < objectsPerThread; i++ )
+				{
+					CComPtr<iDeferred> obj;
+					if( FAILED( Object<Deferred>::create( &obj ) ) )
+						errors++;
+				}
+				releasingThread = false;
+			} );
+		}
+		for( auto& t : threads )
+			t.join();
+
+		const HRESULT hr = flushDeferredDestruction();
+		const int total = threadsCount * objectsPerThread;
+		// When the queue is full, the releasing thread destroys the object. With 4 threads releasing as fast as they can, that happens to many of them.
+		return S_OK == hr && 0 == errors && 0 == liveObjects && total == finalReleased && destroyedByReleasingThread < total;
+	}
+
+	// Flushing from a destructor running on the background thread would wait for itself, it fails instead
+	bool flushFromDestructor()
+	{
+		flushInDestructor = 0;
+		{
+			CComPtr<Object<Deferred>> obj;
+			if( FAILED( Object<Deferred>::create( obj ) ) )
+				return false;
+			obj->flushFromDestructor();
+		}
+		return S_OK == flushDeferredDestruction() && E_UNEXPECTED == flushInDestructor && 0 == liveObjects;
+	}
+}
+
+void Tests::deferredDestruction()
+{
+	check( flushAfterRelease(), "Deferred destruction, flush after releasing from 4 threads" );
+	check( flushFromDestructor(), "Deferred destruction, flush from a destructor" );
+}
@@ -0,0 +1,25 @@
+#include "tests.h"
+
+static int failures = 0;
+
+void Tests::check( bool passed, const char* what )
+{
+	printf( "%s: %s\n", passed ? "PASS" : "FAIL", what );
+	fflush( stdout );
+	if( !passed )
+		failures++;
+}
+
+// Exits with 0 when all tests pass, 1 otherwise
+int main()
+{
+	Tests::atomicComPtr();
+	Tests::pipe();
+	Tests::chunkedMemoryStream();
+	Tests::prefetchReadStream();
+	Tests::deferredDestruction();
+	Tests::streamBatch();
+
+	printf( "%i tests failed\n", failures );
+	return ( 0 == failures ) ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+#include "tests.h"
+#include <thread>
+#include <vector>
+#include "../../ComLightLib/comLightServer.h"
+#include "../../ComLightLib/io/Pipe.hpp"
+
+namespace
+{
+	using namespace ComLight;
+
+	uint8_t pattern( size_t i )
+	{
+		return (uint8_t)( i * 7 + ( i >> 11 ) );
+	}
+
+	bool capacityLimits()
+	{
+		CComPtr<iWriteStream> w;
+		CComPtr<iReadStream> r;
+		bool ok = E_INVALIDARG == createPipe( 0, ePipeMode::Blocking, &w, &r );
+		ok = ok && E_INVALIDARG == createPipe( SIZE_MAX, ePipeMode::Blocking, &w, &r );
+		if( sizeof( size_t ) == 8 )
+			ok = ok && E_INVALIDARG == createPipe( (size_t)( ( (uint64_t)1 << 40 ) + 1 ), ePipeMode::Blocking, &w, &r );
+		return ok && !w && !r;
+	}
+
+	// Producer thread writes 8MB in chunks of varying sizes through a 4kb pipe, the consumer reads with other sizes and verifies the bytes
+	bool blocking()
+	{
+		constexpr size_t total = 8 * 1024 * 1024;
+		CComPtr<iWriteStream> w;
+		CComPtr<iReadStream> r;
+		if( FAILED( createPipe( 4096, ePipeMode::Blocking, &w, &r ) ) )
+			return false;
+
+		HRESULT writeStatus = S_OK;
+		std::thread producer( [ &writeStatus, &w ]()
+		{
+			std::vector<uint8_t> buffer( 10000 );
+			size_t written = 0;
+			for( size_t i = 0; written < total && SUCCEEDED( writeStatus ); i++ )
+			{
+				const size_t cb = (std::min)( total - written, (size_t)( 1 + ( i * 997 ) % buffer.size() ) );
+				for( size_t j = 0; j < cb; j++ )
+					buffer[ j ] = pattern( written + j );
+				writeStatus = w->write( buffer.data(), (int)cb );
+				written += cb;
+			}
+			// Releasing the write end is the end of stream for the reader
+			w.release();
+		} );
+
+		bool ok = true;
+		std::vector<uint8_t> buffer( 7000 );
+		size_t received = 0;
+		while( ok )
+		{
+			int cb = 0;
+			ok = SUCCEEDED( r->read( buffer.data(), (int)buffer.size(), cb ) );
+			if( !ok || 0 == cb )
+				break;
+			for( int j = 0; j < cb; j++ )
+				ok = ok && buffer[ j ] == pattern( received + j );
+			received += cb;
+		}
+		producer.join();
+
+		int64_t position = 0;
+		ok = ok && SUCCEEDED( writeStatus ) && total == received;
+		return ok && SUCCEEDED( r->getPosition( position ) ) && (int64_t)total == position;
+	}
+
+	bool nonBlocking()
+	{
+		CComPtr<iWriteStream> w;
+		CComPtr<iReadStream> r;
+		if( FAILED( createPipe( 100, ePipeMode::NonBlocking, &w, &r ) ) )
+			return false;
+		uint8_t buffer[ 256 ] = {};
+		int cb = -1;
+		// Capacity is rounded up to 128 bytes
+		bool ok = E_PENDING == r->read( buffer, 10, cb );
+		ok = ok && E_BOUNDS == w->write( buffer, 129 );
+		ok = ok && S_OK == w->write( buffer, 100 );
+		ok = ok && E_PENDING == w->write( buffer, 29 );
+		ok = ok && S_OK == w->write( buffer, 28 );
+		ok = ok && S_OK == r->read( buffer, 256, cb ) && 128 == cb;
+		ok = ok && E_NOTIMPL == r->seek( 0, eSeekOrigin::Begin );
+
+		// End of stream after the write end is released, broken pipe after the read end is
+		w.release();
+		ok = ok && S_OK == r->read( buffer, 10, cb ) && 0 == cb;
+		CComPtr<iWriteStream> w2;
+		CComPtr<iReadStream> r2;
+		ok = ok && SUCCEEDED( createPipe( 100, ePipeMode::NonBlocking, &w2, &r2 ) );
+		r2.release();
+		return ok && E_BROKEN_PIPE == w2->write( buffer, 1 );
+	}
+}
+
+void Tests::pipe()
+{
+	check( capacityLimits(), "Pipe, capacity limits" );
+	check( blocking(), "Pipe, blocking, two threads" );
+	check( nonBlocking(), "Pipe, non-blocking" );
+}
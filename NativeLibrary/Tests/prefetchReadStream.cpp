@@ -0,0 +1,97 @@
+#include "tests.h"
+#include <thread>
+#include <vector>
+#include "../../ComLightLib/comLightServer.h"
+#include "../../ComLightLib/io/PrefetchReadStream.hpp"
+#include "../../ComLightLib/io/MemoryStreams.hpp"
+#include "../../ComLightLib/io/Pipe.hpp"
+
+namespace
+{
+	using namespace ComLight;
+
+	constexpr size_t totalBytes = 1024 * 1024;
+
+	uint8_t pattern( size_t i )
+	{
+		return (uint8_t)( i * 13 + ( i >> 9 ) );
+	}
+
+	// Read the specified count of bytes, verify they continue the pattern from the position
+	bool readAndVerify( iReadStream* stream, size_t& position, size_t count )
+	{
+		std::vector<uint8_t> buffer( count );
+		int cb = 0;
+		if( FAILED( stream->read( buffer.data(), (int)count, cb ) ) || cb != (int)count )
+			return false;
+		for( size_t i = 0; i < count; i++ )
+			if( buffer[ i ] != pattern( position + i ) )
+				return false;
+		position += count;
+		return true;
+	}
+
+	// The source can't seek: the seek fails, and the prefetched data is not lost
+	bool pipeSource()
+	{
+		CComPtr<iWriteStream> w;
+		CComPtr<iReadStream> r;
+		if( FAILED( createPipe( 64 * 1024, ePipeMode::Blocking, &w, &r ) ) )
+			return false;
+
+		std::thread producer( [ &w ]()
+		{
+			std::vector<uint8_t> data( totalBytes );
+			for( size_t i = 0; i < totalBytes; i++ )
+				data[ i ] = pattern( i );
+			w->write( data.data(), (int)data.size() );
+			w.release();
+		} );
+
+		CComPtr<Object<PrefetchReadStream>> prefetch;
+		bool ok = SUCCEEDED( Object<PrefetchReadStream>::create( prefetch ) ) && SUCCEEDED( prefetch->initialize( r, 4096, 8 ) );
+		r.release();
+		size_t position = 0;
+		ok = ok && readAndVerify( prefetch, position, 10000 );
+		ok = ok && E_NOTIMPL == prefetch->seek( 0, eSeekOrigin::Begin );
+		ok = ok && E_NOTIMPL == prefetch->seek( 100, eSeekOrigin::Current );
+		ok = ok && readAndVerify( prefetch, position, totalBytes - position );
+		int cb = -1;
+		uint8_t extra;
+		ok = ok && SUCCEEDED( prefetch->read( &extra, 1, cb ) ) && 0 == cb;
+		producer.join();
+		return ok;
+	}
+
+	// Seeking a memory source, relative to the position of the consumer which is behind the source
+	bool memorySource()
+	{
+		std::vector<uint8_t> data( totalBytes );
+		for( size_t i = 0; i < totalBytes; i++ )
+			data[ i ] = pattern( i );
+		CComPtr<Object<MemoryReadStream>> source;
+		CComPtr<Object<PrefetchReadStream>> prefetch;
+		bool ok = SUCCEEDED( Object<MemoryReadStream>::create( source ) ) && SUCCEEDED( source->initialize( data.data(), (int64_t)data.size() ) );
+		ok = ok && SUCCEEDED( Object<PrefetchReadStream>::create( prefetch ) ) && SUCCEEDED( prefetch->initialize( source, 4096, 8 ) );
+
+		size_t position = 0;
+		int64_t reported = 0;
+		ok = ok && readAndVerify( prefetch, position, 5000 );
+		ok = ok && SUCCEEDED( prefetch->seek( 3000, eSeekOrigin::Current ) );
+		position += 3000;
+		ok = ok && SUCCEEDED( prefetch->getPosition( reported ) ) && (int64_t)position == reported;
+		ok = ok && readAndVerify( prefetch, position, 20000 );
+		ok = ok && SUCCEEDED( prefetch->seek( 100, eSeekOrigin::Begin ) );
+		position = 100;
+		ok = ok && readAndVerify( prefetch, position, 100 );
+		ok = ok && SUCCEEDED( prefetch->seek( -1000, eSeekOrigin::End ) );
+		position = totalBytes - 1000;
+		return ok && readAndVerify( prefetch, position, 1000 );
+	}
+}
+
+void Tests::prefetchReadStream()
+{
+	check( pipeSource(), "PrefetchReadStream, seek fails on a pipe without losing data" );
+	check( memorySource(), "PrefetchReadStream, seek" );
+}
@@ -0,0 +1,221 @@
+#include "tests.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "../../ComLightLib/comLightServer.h"
+#include "../../ComLightLib/io/ChunkedMemoryStream.hpp"
+#include "../../ComLightLib/io/MemoryStreams.hpp"
+#include "../../ComLightLib/io/StdioStreams.hpp"
+#include "../../ComLightLib/io/LinuxFileStreams.hpp"
+
+namespace
+{
+	using namespace ComLight;
+
+	const char* const tempPath = "comlight-tests.tmp";
+
+	// Forwards the calls to the batch interface of another stream, and counts them
+	class CountingWriteStream : public ObjectRoot<iWriteStreamBatch>
+	{
+		CComPtr<iWriteStreamBatch> m_dest;
+
+	public:
+
+		int writes = 0, batches = 0;
+
+		HRESULT initialize( iWriteStream* dest )
+		{
+			return dest->QueryInterface( iWriteStreamBatch::iid(), (void**)&m_dest );
+		}
+
+		HRESULT COMLIGHTCALL write( const void* lpBuffer, int nNumberOfBytesToWrite ) override
+		{
+			writes++;
+			return m_dest->write( lpBuffer, nNumberOfBytesToWrite );
+		}
+
+		HRESULT COMLIGHTCALL flush() override
+		{
+			return m_dest->flush();
+		}
+
+		HRESULT COMLIGHTCALL writeBatch( const WriteBuffer* buffers, int count ) override
+		{
+			batches++;
+			return m_dest->writeBatch( buffers, count );
+		}
+	};
+
+	class CountingReadStream : public ObjectRoot<iReadStreamBatch>
+	{
+		CComPtr<iReadStreamBatch> m_source;
+
+	public:
+
+		int reads = 0, batches = 0;
+
+		HRESULT initialize( iReadStream* source )
+		{
+			return source->QueryInterface( iReadStreamBatch::iid(), (void**)&m_source );
+		}
+
+		HRESULT COMLIGHTCALL read( void* lpBuffer, int nNumberOfBytesToRead, int &lpNumberOfBytesRead ) override
+		{
+			reads++;
+			return m_source->read( lpBuffer, nNumberOfBytesToRead, lpNumberOfBytesRead );
+		}
+
+		HRESULT COMLIGHTCALL seek( int64_t offset, eSeekOrigin origin ) override
+		{
+			return m_source->seek( offset, origin );
+		}
+
+		HRESULT COMLIGHTCALL getPosition( int64_t& position ) override
+		{
+			return m_source->getPosition( position );
+		}
+
+		HRESULT COMLIGHTCALL getLength( int64_t& length ) override
+		{
+			return m_source->getLength( length );
+		}
+
+		HRESULT COMLIGHTCALL readBatch( const ReadBuffer* buffers, int count, int64_t& bytesRead ) override
+		{
+			batches++;
+			return m_source->readBatch( buffers, count, bytesRead );
+		}
+	};
+
+	// The content of the batches: a small header, a payload larger than the stdio buffer, and a small trailer
+	struct Content
+	{
+		uint32_t header = 0x12345678;
+		std::vector<uint8_t> payload;
+		char trailer[ 13 ];
+
+		Content()
+		{
+			payload.resize( 100 * 1024 );
+			for( size_t i = 0; i < payload.size(); i++ )
+				payload[ i ] = (uint8_t)( i * 7 );
+			memcpy( trailer, "Hello, world.", 13 );
+		}
+	};
+
+	// Write the content with a single writeBatch call of the stream
+	bool writeContent( iWriteStream* dest, const Content& content )
+	{
+		CComPtr<Object<CountingWriteStream>> counter;
+		if( FAILED( Object<CountingWriteStream>::create( counter ) ) || FAILED( counter->initialize( dest ) ) )
+			return false;
+		WriteBatch batch{ counter };
+		batch.add( content.header );
+		batch.add( content.payload );
+		batch.add( content.trailer );
+		return batch.isBatched() && SUCCEEDED( batch.write() ) && SUCCEEDED( dest->flush() ) && 1 == counter->batches && 0 == counter->writes;
+	}
+
+	// Read the content back with a single readBatch call, then another one which fails at the end of the stream
+	bool readContent( iReadStream* source, const Content& expected )
+	{
+		CComPtr<Object<CountingReadStream>> counter;
+		if( FAILED( Object<CountingReadStream>::create( counter ) ) || FAILED( counter->initialize( source ) ) )
+			return false;
+		Content content;
+		content.header = 0;
+		std::fill( content.payload.begin(), content.payload.end(), (uint8_t)0 );
+		memset( content.trailer, 0, sizeof( content.trailer ) );
+
+		ReadBatch batch{ counter };
+		batch.add( content.header );
+		batch.add( content.payload );
+		batch.add( content.trailer );
+		bool ok = batch.isBatched() && SUCCEEDED( batch.read() ) && 1 == counter->batches;
+		ok = ok && content.header == expected.header && content.payload == expected.payload && 0 == memcmp( content.trailer, expected.trailer, sizeof( content.trailer ) );
+
+		uint32_t extra = 0;
+		batch.add( extra );
+		return ok && E_EOF == batch.read() && 2 == counter->batches && 0 == counter->reads;
+	}
+
+	bool memoryBatches()
+	{
+		const Content content;
+		CComPtr<Object<MemoryWriteStream>> writer;
+		if( FAILED( Object<MemoryWriteStream>::create( writer ) ) || !writeContent( writer, content ) )
+			return false;
+		std::vector<uint8_t> data;
+		writer->detach( data );
+		CComPtr<Object<MemoryReadStream>> reader;
+		return SUCCEEDED( Object<MemoryReadStream>::create( reader ) ) && SUCCEEDED( reader->initialize( std::move( data ) ) ) && readContent( reader, content );
+	}
+
+	bool chunkedBatches()
+	{
+		const Content content;
+		CComPtr<Object<ChunkedMemoryStream>> stream;
+		if( FAILED( Object<ChunkedMemoryStream>::create( stream ) ) || FAILED( stream->initialize( 4096 ) ) )
+			return false;
+		return writeContent( stream, content ) && SUCCEEDED( stream->seek( 0, eSeekOrigin::Begin ) ) && readContent( stream, content );
+	}
+
+	bool stdioBatches()
+	{
+		const Content content;
+		{
+			CComPtr<Object<StdioWriteStream>> writer;
+			if( FAILED( Object<StdioWriteStream>::create( writer ) ) || FAILED( writer->createFile( tempPath ) ) || !writeContent( writer, content ) )
+				return false;
+		}
+		CComPtr<Object<StdioReadStream>> reader;
+		const bool ok = SUCCEEDED( Object<StdioReadStream>::create( reader ) ) && SUCCEEDED( reader->openFile( tempPath ) ) && readContent( reader, content );
+		reader.release();
+		remove( tempPath );
+		return ok;
+	}
+
+#ifndef _MSC_VER
+	bool linuxFileBatches()
+	{
+		const Content content;
+		{
+			FileWriteOptions wo;
+			wo.bufferSize = 4096;
+			CComPtr<Object<LinuxFileWriteStream>> writer;
+			if( FAILED( Object<LinuxFileWriteStream>::create( writer ) ) || FAILED( writer->createFile( tempPath, wo ) ) || !writeContent( writer, content ) )
+				return false;
+		}
+		FileReadOptions ro;
+		ro.bufferSize = 4096;
+		CComPtr<Object<LinuxFileReadStream>> reader;
+		const bool ok = SUCCEEDED( Object<LinuxFileReadStream>::create( reader ) ) && SUCCEEDED( reader->openFile( tempPath, ro ) ) && readContent( reader, content );
+		reader.release();
+		remove( tempPath );
+		return ok;
+	}
+#endif
+
+	// Invalid buffers are rejected before anything is written
+	bool invalidBuffers()
+	{
+		CComPtr<Object<ChunkedMemoryStream>> stream;
+		if( FAILED( Object<ChunkedMemoryStream>::create( stream ) ) )
+			return false;
+		const uint32_t value = 1;
+		const WriteBuffer buffers[ 2 ] = { { &value, sizeof( value ) }, { nullptr, 4 } };
+		int64_t length = -1;
+		return E_POINTER == stream->writeBatch( buffers, 2 ) && E_INVALIDARG == stream->writeBatch( buffers, -1 ) && SUCCEEDED( stream->getLength( length ) ) && 0 == length;
+	}
+}
+
+void Tests::streamBatch()
+{
+	check( memoryBatches(), "Batched streams: memory, one call per batch" );
+	check( chunkedBatches(), "Batched streams: chunked memory, one call per batch" );
+	check( stdioBatches(), "Batched streams: stdio files, one call per batch" );
+#ifndef _MSC_VER
+	check( linuxFileBatches(), "Batched streams: Linux files, one call per batch" );
+#endif
+	check( invalidBuffers(), "Batched streams: invalid buffers" );
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <stdio.h>
+
+// Behavioural tests of ComLightLib, built by cmake into comlight-tests executable, and ran by ctest.
+namespace Tests
+{
+	// Print the outcome of a test, count the failures
+	void check( bool passed, const char* what );
+
+	void atomicComPtr();
+	void pipe();
+	void chunkedMemoryStream();
+	void prefetchReadStream();
+	void deferredDestruction();
+	void streamBatch();
+}
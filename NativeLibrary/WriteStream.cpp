@@ -14,6 +14,20 @@ HRESULT WriteStream::write( const void* lpBuffer, int nNumberOfBytesToWrite )
 	return CTL_E_DEVICEIOERROR;
 }
 
+HRESULT WriteStream::writeBatch( const ComLight::WriteBuffer* buffers, int count )
+{
+	if( nullptr == m_file )
+		return OLE_E_BLANK;
+	CHECK( ComLight::details::validateBuffers( buffers, count ) );
+	for( int i = 0; i < count; i++ )
+	{
+		const size_t cb = (size_t)buffers[ i ].length;
+		if( cb != fwrite( buffers[ i ].data, 1, cb, m_file ) )
+			return CTL_E_DEVICEIOERROR;
+	}
+	return S_OK;
+}
+
 HRESULT WriteStream::flush()
 {
 	if( nullptr == m_file )
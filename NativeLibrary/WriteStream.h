@@ -4,12 +4,20 @@
 #include <stdio.h>
 
 // iWriteStream implementation over <stdio.h> file handle.
-class WriteStream : public ComLight::ObjectRoot<ComLight::iWriteStream>
+// Also implements iWriteStreamBatch, this allows the .NET clients to write multiple buffers with a single call across the interop.
+class WriteStream : public ComLight::ObjectRoot<ComLight::iWriteStreamBatch>
 {
 	HRESULT write( const void* lpBuffer, int nNumberOfBytesToWrite ) override;
 
 	HRESULT flush() override;
 
+	HRESULT writeBatch( const ComLight::WriteBuffer* buffers, int count ) override;
+
+	BEGIN_COM_MAP()
+		COM_INTERFACE_ENTRY( ComLight::iWriteStream )
+		COM_INTERFACE_ENTRY( ComLight::iWriteStreamBatch )
+	END_COM_MAP()
+
 	FILE* m_file = nullptr;
 
 public:
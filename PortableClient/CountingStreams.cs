@@ -0,0 +1,78 @@
+﻿using ComLight.IO;
+using System;
+using System.IO;
+using System.Runtime.InteropServices;
+
+/// <summary>Readonly stream over an array, counts the calls made by native code</summary>
+class CountingReadStream: iReadStreamBatch
+{
+	readonly byte[] data;
+	int position = 0;
+	public int reads { get; private set; } = 0;
+	public int batches { get; private set; } = 0;
+
+	public CountingReadStream( byte[] data )
+	{
+		this.data = data;
+	}
+
+	int readImpl( Span<byte> dest )
+	{
+		int cb = Math.Min( dest.Length, data.Length - position );
+		data.AsSpan( position, cb ).CopyTo( dest );
+		position += cb;
+		return cb;
+	}
+
+	public void read( ref byte lpBuffer, int nNumberOfBytesToRead, out int lpNumberOfBytesRead )
+	{
+		reads++;
+		lpNumberOfBytesRead = readImpl( MemoryMarshal.CreateSpan( ref lpBuffer, nNumberOfBytesToRead ) );
+	}
+
+	public unsafe void readBatch( ReadBuffer[] buffers, int count, out long bytesRead )
+	{
+		batches++;
+		bytesRead = 0;
+		for( int i = 0; i < count; i++ )
+			bytesRead += readImpl( new Span<byte>( (void*)buffers[ i ].data, checked((int)buffers[ i ].length) ) );
+	}
+
+	public void seek( long offset, eSeekOrigin origin )
+	{
+		throw new NotSupportedException();
+	}
+
+	public void getPosition( out long length )
+	{
+		length = position;
+	}
+
+	public void getLength( out long length )
+	{
+		length = data.Length;
+	}
+}
+
+/// <summary>Write stream into a MemoryStream, counts the calls made by native code</summary>
+class CountingWriteStream: iWriteStreamBatch
+{
+	public readonly MemoryStream stream = new MemoryStream();
+	public int writes { get; private set; } = 0;
+	public int batches { get; private set; } = 0;
+
+	public void write( ref byte lpBuffer, int nNumberOfBytesToWrite )
+	{
+		writes++;
+		stream.Write( MemoryMarshal.CreateReadOnlySpan( ref lpBuffer, nNumberOfBytesToWrite ) );
+	}
+
+	public unsafe void writeBatch( WriteBuffer[] buffers, int count )
+	{
+		batches++;
+		for( int i = 0; i < count; i++ )
+			stream.Write( new ReadOnlySpan<byte>( (void*)buffers[ i ].data, checked((int)buffers[ i ].length) ) );
+	}
+
+	public void flush() { }
+}
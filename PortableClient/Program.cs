@@ -17,6 +17,8 @@ namespace PortableClient
 			Console.WriteLine( "64 bit process: {0}", Environment.Is64BitProcess );
 
 			Tests.testMarshalBack();
+			Tests.testArrayDescriptors();
+			Tests.testStreamBatch();
 		}
 	}
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 ﻿using ComLight;
+using ComLight.IO;
 using System;
 using System.Diagnostics;
 using System.IO;
@@ -12,6 +13,10 @@ static class Tests
 	[DllImport( dll, PreserveSig = false )]
 	static extern void createTest( [MarshalAs( UnmanagedType.CustomMarshaler, MarshalTypeRef = typeof( Marshaler<ITest> ) )] out ITest obj );
 
+	[DllImport( dll, PreserveSig = false )]
+	static extern void copyStreamBatch( [MarshalAs( UnmanagedType.CustomMarshaler, MarshalTypeRef = typeof( Marshaler<iReadStreamBatch> ) )] iReadStreamBatch source,
+		[MarshalAs( UnmanagedType.CustomMarshaler, MarshalTypeRef = typeof( Marshaler<iWriteStreamBatch> ) )] iWriteStreamBatch dest );
+
 	const int DISP_E_OVERFLOW = unchecked((int)0x8002000A);
 
 	public static void test0()
@@ -127,4 +132,70 @@ static class Tests
 		string path = Path.Combine( Path.GetTempPath(), "test.txt" );
 		test.testMarshalBack( path, managed );
 	}
-}
\ No newline at end of file
+
+	public static void testArrayDescriptors()
+	{
+		// The layout must match arrays.h
+		Debug.Assert( Marshal.SizeOf<ArrayDescriptor>() == 40 );
+		Debug.Assert( Marshal.OffsetOf<ArrayDescriptor>( "elementSize" ) == (IntPtr)32 );
+		Debug.Assert( Marshal.SizeOf<NdArrayDescriptor>() == 88 );
+		Debug.Assert( Marshal.OffsetOf<NdArrayDescriptor>( "shape" ) == (IntPtr)24 );
+		Debug.Assert( Marshal.OffsetOf<NdArrayDescriptor>( "strides" ) == (IntPtr)56 );
+
+		float[] values = new float[ 6 ] { 1, 2, 3, 4, 5, 6 };
+		using( PinnedArray pinned = ArrayMarshal.pin( values ) )
+		{
+			ArrayDescriptor ad = pinned.descriptor;
+			Debug.Assert( ad.length == 6 && ad.stride == 4 && ad.elementSize == 4 );
+			Debug.Assert( ad.elementType == eElementType.Float32 && ad.ownership == eArrayOwnership.Borrowed );
+			Span<float> span = ArrayMarshal.span<float>( ad );
+			Debug.Assert( span.SequenceEqual( values ) );
+			// Wrong element type
+			try
+			{
+				ArrayMarshal.span<int>( ad );
+				Debug.Assert( false );
+			}
+			catch( ArgumentException ) { }
+		}
+
+		Span<int> matrix = stackalloc int[ 6 ] { 1, 2, 3, 4, 5, 6 };
+		NdArrayDescriptor nd = ArrayMarshal.borrow( matrix, 2, 3 );
+		Debug.Assert( nd.dimensions == 2 && nd.elementType == eElementType.Int32 );
+		unsafe
+		{
+			Debug.Assert( nd.shape[ 0 ] == 2 && nd.shape[ 1 ] == 3 && nd.shape[ 2 ] == 1 && nd.shape[ 3 ] == 1 );
+			Debug.Assert( nd.strides[ 0 ] == 12 && nd.strides[ 1 ] == 4 && nd.strides[ 2 ] == 0 && nd.strides[ 3 ] == 0 );
+		}
+		Span<int> flat = ArrayMarshal.span<int>( nd );
+		Debug.Assert( flat.SequenceEqual( matrix ) );
+		Console.WriteLine( "Array descriptors: OK" );
+	}
+
+	public static void testStreamBatch()
+	{
+		byte[] data = new byte[ 4 + 100000 + 4 ];
+		new Random( 0 ).NextBytes( data );
+
+		// C++ calling the streams implemented in .NET, one call for the complete batch
+		var source = new CountingReadStream( data );
+		var dest = new CountingWriteStream();
+		copyStreamBatch( source, dest );
+		Debug.Assert( source.batches == 1 && source.reads == 0 );
+		Debug.Assert( dest.batches == 1 && dest.writes == 0 );
+		Debug.Assert( dest.stream.ToArray().AsSpan().SequenceEqual( data ) );
+
+		// .NET calling the stream implemented in C++
+		ITest test;
+		createTest( out test );
+		string path = Path.Combine( Path.GetTempPath(), "test-batch.bin" );
+		test.createFile( path, out Stream stm );
+		Debug.Assert( StreamBatch.isWriteBatched( stm ) );
+		StreamBatch.write( stm, data.AsMemory( 0, 4 ), data.AsMemory( 4, 100000 ), data.AsMemory( 100004 ) );
+		stm.Flush();
+		stm.Dispose();
+		Debug.Assert( File.ReadAllBytes( path ).AsSpan().SequenceEqual( data ) );
+		File.Delete( path );
+		Console.WriteLine( "Stream batches: OK" );
+	}
+}